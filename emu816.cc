@@ -19,15 +19,98 @@
 // http://creativecommons.org/licenses/by-nc-sa/4.0/
 //------------------------------------------------------------------------------
 #include <emu816.h>
+#include <emu816_opcodes.h>
 #include <stdio.h>
+#include <string.h>
+
+#if defined(__GNUC__)
+#define EMU816_FLATTEN      __attribute__((flatten))
+#else
+#define EMU816_FLATTEN
+#endif
+
+// Hooks for the instruction trace, which compile to nothing without it. The
+// engines call EMU816_TRACE_INSN as each instruction starts, with the PC
+// past its opcode, and operand loads and stores pass their address to
+// EMU816_TRACE_EA.
+#if defined(EMU816_TRACE)
+#define EMU816_TRACE_INSN(opcode)   if (m_trace) trace(opcode)
+#define EMU816_TRACE_EA(ea)         m_trace_record->ea = (ea)
+#else
+#define EMU816_TRACE_INSN(opcode)
+#define EMU816_TRACE_EA(ea)
+#endif
+
+// Edge coverage, which likewise compiles to nothing without it. Control
+// transfers call EMU816_COVER once the PC and bank hold the destination.
+#if defined(EMU816_COVERAGE)
+#define EMU816_COVER()              if (m_coverage) cover(join(pbr, pc))
+#else
+#define EMU816_COVER()
+#endif
+
+// The processor in run_for() on this thread, if any
+static thread_local emu816 *s_running = NULL;
 
 emu816::emu816()
 : m_cycles(0)
+, m_horizon(0)
+, m_host_stop(false)
+, m_stop_reason(EMU816_STOP_NONE)
+, m_idle(EMU816_STOP_NONE)
+, m_irq(0)
+, m_signals(0)
+, m_interrupt(0)
+, m_scheduled(0)
+, m_has_baseline(false)
+, m_max_checkpoints(0)
+, m_interval(0)
+, m_history(EMU816_NO_EVENT)
+, m_travelling(false)
+, m_engine(EMU816_DEFAULT_ENGINE)
+, m_blocks(NULL)
+, m_jit(NULL)
+, m_insn(NULL)
+, m_exit_block(false)
+, m_cross(false)
+, m_input(NULL)
+, m_inputs(INPUT_NONE)
+, m_diverged(false)
+, m_in_engine(false)
+, m_profile(NULL)
+, m_break_at(EMU816_INVALID_PC)
+, m_break_kind(0)
+, m_resume(EMU816_INVALID_PC)
+, m_copies_used(0)
 { 
+    memset(m_watch, 0, sizeof(m_watch));
+    memset(m_code_gen, 0, sizeof(m_code_gen));
+    memset(m_read, 0, sizeof(m_read));
+    memset(m_write, 0, sizeof(m_write));
+    memset(m_shared, 0, sizeof(m_shared));
+    memset(&m_jit_stats, 0, sizeof(m_jit_stats));
+    memset(m_events, 0, sizeof(m_events));
+    for (int n = 0; n < EMU816_EVENTS; ++n)
+        m_events[n].heap = -1;
+#if defined(EMU816_TRACE)
+    m_trace = NULL;
+    m_trace_record = &m_trace_scratch;
+#endif
+#if defined(EMU816_COVERAGE)
+    m_coverage = NULL;
+    m_coverage_mask = 0;
+    m_coverage_last = 0;
+#endif
 }
 
 emu816::~emu816()
 { 
+    end_input();
+    enable_block_cache(false);
+    for (size_t n = 0; n < m_copies.size(); ++n)
+        delete [] m_copies[n];
+    for (size_t n = 0; n < m_originals.size(); ++n)
+        delete [] m_originals[n];
 }
 
 // Return the low byte of a word
@@ -66,6 +149,78 @@ uint16_t emu816::swap(uint16_t value)
     return ((value >> 8) | (value << 8));
 }
 
+// Access a register at the given width
+template <> inline uint8_t &emu816::reg<uint8_t>(REGS &r)
+{
+    return (r.b);
+}
+
+template <> inline uint16_t &emu816::reg<uint16_t>(REGS &r)
+{
+    return (r.w);
+}
+
+// Load or store a value of the given width
+template <> inline uint8_t emu816::load<uint8_t>(emu816_addr_t ea)
+{
+    EMU816_TRACE_EA(ea);
+    watch_load(ea, 1);
+    return (read8(ea));
+}
+
+template <> inline uint16_t emu816::load<uint16_t>(emu816_addr_t ea)
+{
+    EMU816_TRACE_EA(ea);
+    watch_load(ea, 2);
+    return (read16(ea));
+}
+
+template <> inline void emu816::store<uint8_t>(emu816_addr_t ea, uint8_t data)
+{
+    EMU816_TRACE_EA(ea);
+    watch_store(ea, 1);
+    write8(ea, data);
+}
+
+template <> inline void emu816::store<uint16_t>(emu816_addr_t ea, uint16_t data)
+{
+    EMU816_TRACE_EA(ea);
+    watch_store(ea, 2);
+    write16(ea, data);
+}
+
+// Push or pull a value of the given width
+template <> inline void emu816::push<uint8_t>(uint8_t value)
+{
+    pushByte(value);
+}
+
+template <> inline void emu816::push<uint16_t>(uint16_t value)
+{
+    pushWord(value);
+}
+
+template <> inline uint8_t emu816::pull<uint8_t>()
+{
+    return (pullByte());
+}
+
+template <> inline uint16_t emu816::pull<uint16_t>()
+{
+    return (pullWord());
+}
+
+// Set the Negative and Zero flags from a value of the given width
+template <> inline void emu816::setnz<uint8_t>(uint8_t value)
+{
+    setnz_b(value);
+}
+
+template <> inline void emu816::setnz<uint16_t>(uint16_t value)
+{
+    setnz_w(value);
+}
+
 // Reset the state of emulator
 void emu816::reset(uint32_t entry_point)
 {
@@ -77,31 +232,403 @@ void emu816::reset(uint32_t entry_point)
     if ( entry_point != EMU816_INVALID_PC )
         pc = entry_point;
     else
-	    pc = load16(0xfffc);
-	p.b = 0x34;
+	    pc = read16(0xfffc);
+    m_signals = 0;
+	set_p(0x34);
 	m_stopped = false;
+    m_stop_reason = EMU816_STOP_NONE;
+    m_idle = EMU816_STOP_NONE;
+
+    // A stop requested before the reset does not carry over to the next run
+    m_host_stop.store(false);
+    m_horizon.store(0);
+
+    // Pending events keep their distance from the current cycle
+    for (int n = 0; n < m_scheduled; ++n) {
+        EVENT &event = m_events[m_heap[n]];
+        event.deadline -= (event.deadline < m_cycles) ? event.deadline : m_cycles;
+    }
     m_cycles = 0;
+    flush_blocks();
 }
 
+// Run until the cycle counter reaches the given value (or forever if zero).
+// Retained for compatibility, run_for() is preferred.
 void emu816::run(uint32_t cycles)
 {
-    while (!stopped ())
-    {
-		step();
-        if ( cycles > 0 )
-        {
-            if ( m_cycles >= cycles)
-                m_stopped=true;
+    if (cycles == 0)
+        run_for(0);
+    else
+        run_for(cycles > m_cycles ? cycles - m_cycles : 1);
+}
+
+// Execute instructions for at least the given number of cycles (or without
+// limit if zero) and return the reason for stopping. The budget is checked
+// at instruction boundaries, so the last instruction may overrun it.
+emu816_stop_t emu816::run_for(uint64_t cycles)
+{
+    uint64_t horizon = (cycles && cycles <= UINT64_MAX - m_cycles) ? m_cycles + cycles : UINT64_MAX;
+    emu816 *running = s_running;
+
+    s_running = this;
+    m_stopped = false;
+    m_stop_reason = EMU816_STOP_NONE;
+    if (m_resume != join(pbr, pc)) m_resume = EMU816_INVALID_PC;
+
+    // Run to the earlier of the end of the budget and the next event, fire
+    // the events that are due and carry on
+    while (!m_host_stop.load()) {
+        fire_events();
+        if (m_stopped || m_cycles >= horizon) break;
+
+        uint64_t limit = horizon;
+        if (m_scheduled && m_events[m_heap[0]].deadline < limit)
+            limit = m_events[m_heap[0]].deadline;
+
+        // A waiting processor skips straight to the next event or the end
+        // of the budget, while one stopped by STP has no clock at all
+        if (m_idle) {
+            if (m_idle == EMU816_STOP_STP || limit == UINT64_MAX) break;
+            m_cycles = limit;
+            continue;
         }
-    }    
+
+        m_horizon.store(limit);
+        if (m_host_stop.load()) break;
+        m_in_engine = true;
+        run_engine();
+        m_in_engine = false;
+#if defined(EMU816_TRACE)
+        if (m_trace) trace_commit();
+#endif
+        if (m_inputs == INPUT_RECORD) input_boundary();
+
+        if (m_idle == EMU816_STOP_WAI) {
+            m_stopped = false;
+            m_stop_reason = EMU816_STOP_NONE;
+        }
+    }
+    if (m_idle && m_stop_reason == EMU816_STOP_NONE) m_stop_reason = m_idle;
+    if (m_profile) m_profile->charge(m_cycles);
+
+    m_stopped = true;
+    m_host_stop.store(false);
+    s_running = running;
+    if (m_stop_reason == EMU816_STOP_NONE)
+        m_stop_reason = (m_cycles >= horizon) ? EMU816_STOP_BUDGET : EMU816_STOP_HOST;
+    return (m_stop_reason);
+}
+
+// Execute instructions with the selected engine until stopped or the
+// horizon is reached
+void emu816::run_engine()
+{
+#if defined(EMU816_THREADED)
+    if (m_engine == EMU816_ENGINE_THREADED) {
+        if (m_blocks)
+            run_threaded<true>();
+        else
+            run_threaded<false>();
+        return;
+    }
+#endif
+    if (m_blocks)
+        run_cached();
+    else {
+        while (!m_stopped && m_cycles < m_horizon.load(std::memory_order_relaxed))
+            step();
+    }
+}
+
+// Make the current call to run_for() return as soon as possible. A request
+// made between runs stops the next one at once, unless reset() is called
+// first. May be called from another thread.
+void emu816::request_stop()
+{
+    m_host_stop.store(true);
+    m_horizon.store(0);
 }
 
+// Stop the processor from within a load or store handler, at the end of the
+// current instruction. Called from any other thread it only makes the same
+// request as request_stop(), leaving the engine's own state alone.
 void emu816::stop()
 {
+    if (s_running == this) m_stopped = true;
+    request_stop();
+}
+
+// Stop the processor at the end of the current instruction
+void emu816::halt(emu816_stop_t reason)
+{
+    m_stop_reason = reason;
     m_stopped = true;
 }
 
-uint32_t emu816::cycles() 
+// Start profiling, or stop with NULL. Only the cycles run while a profile
+// is attached are charged to it. Translations made with or without calls
+// and returns in them are thrown away.
+void emu816::set_profile(emu816_profile *profile)
+{
+    if (m_jit && !m_profile != !profile) jit_flush();
+    if (m_profile) m_profile->charge(m_cycles);
+    m_profile = profile;
+    if (m_profile) m_profile->start(m_cycles);
+}
+
+#if defined(EMU816_TRACE)
+// Start tracing to a ring, or stop with NULL
+void emu816::set_trace(emu816_trace *trace)
+{
+    if (m_trace) trace_commit();
+    m_trace = trace;
+}
+
+// Commit the record of the last instruction traced, if it was kept
+void emu816::trace_commit()
+{
+    if (m_trace_record != &m_trace_scratch) m_trace->commit();
+    m_trace_record = &m_trace_scratch;
+}
+
+// Start the record of an instruction, committing the one before. The
+// operand bytes come from the decoded block or from mapped memory, so that
+// tracing never calls the load functions.
+void emu816::trace(uint8_t opcode)
+{
+    trace_commit();
+
+    emu816_trace_t *record = m_trace->reserve();
+
+    if (record) m_trace_record = record;
+    record = m_trace_record;
+
+    record->cycles = m_cycles;
+    record->pc = join(pbr, (uint16_t)(pc - 1));
+    record->ea = EMU816_INVALID_PC;
+    record->a = a.w;
+    record->x = x.w;
+    record->y = y.w;
+    record->sp = sp.w;
+    record->dp = dp.w;
+    record->dbr = dbr;
+    record->p = get_p();
+    record->e = e;
+    record->opcode = opcode;
+    for (int n = 0; n < 3; ++n) {
+        emu816_addr_t ea = join(pbr, (uint16_t)(pc + n));
+        const uint8_t *host = m_read[page(ea)];
+
+        if (m_insn)
+            record->operand[n] = (uint8_t)(m_insn->operand >> (8 * n));
+        else
+            record->operand[n] = host ? host[offset(ea)] : 0;
+    }
+}
+#endif
+
+// Assert the IRQ line on behalf of a source. May only be called from the
+// thread running the processor, such as from a load or store handler.
+void emu816::assert_irq(uint32_t source)
+{
+    if (m_inputs && !input_irq(LOG_ASSERT, source)) return;
+    m_irq |= 1u << (source & 31);
+    update_interrupts();
+}
+
+// Release the IRQ line held by a source
+void emu816::release_irq(uint32_t source)
+{
+    if (m_inputs && !input_irq(LOG_RELEASE, source)) return;
+    m_irq &= ~(1u << (source & 31));
+    update_interrupts();
+}
+
+// Raise a non-maskable interrupt
+void emu816::raise_nmi()
+{
+    if (m_inputs && !input_irq(LOG_NMI, 0)) return;
+    m_signals |= INT_NMI;
+    update_interrupts();
+}
+
+// Abort the current instruction stream. The interrupt is taken at the
+// next instruction boundary; the aborted instruction is not reissued.
+void emu816::raise_abort()
+{
+    if (m_inputs && !input_irq(LOG_ABORT, 0)) return;
+    m_signals |= INT_ABORT;
+    update_interrupts();
+}
+
+// Recompute the pending interrupt word after a change to the lines or to
+// the I flag. The engines test only this word between instructions.
+void emu816::update_interrupts()
+{
+    m_interrupt = m_signals | ((m_irq && !p.f_i) ? INT_IRQ : 0);
+    if (m_interrupt) m_exit_block = true;
+
+    // An IRQ wakes the processor from WAI even when masked
+    if (m_idle == EMU816_STOP_WAI && (m_irq || m_signals))
+        m_idle = EMU816_STOP_NONE;
+}
+
+// Take the highest priority pending interrupt
+void emu816::take_interrupt()
+{
+    uint8_t status = get_p() & (e ? ~0x10 : 0xff);
+
+    m_cycles += e ? 7 : 8;
+    if (m_signals & INT_ABORT) {
+        m_signals &= ~INT_ABORT;
+        enter_vector(status, 0xfff8, 0xffe8);
+    }
+    else if (m_signals & INT_NMI) {
+        m_signals &= ~INT_NMI;
+        enter_vector(status, 0xfffa, 0xffea);
+    }
+    else
+        enter_vector(status, 0xfffe, 0xffee);
+}
+
+// Push the return state and jump through an interrupt vector
+void emu816::enter_vector(uint8_t status, uint16_t emulation, uint16_t native)
+{
+    if (e) {
+        pushWord(pc);
+        pushByte(status);
+    }
+    else {
+        pushByte(pbr);
+        pushWord(pc);
+        pushByte(status);
+    }
+    setd(0);
+    pbr = 0;
+    pc = read16(e ? emulation : native);
+    seti(1);
+    EMU816_COVER();
+    if (m_profile) m_profile->call(pc, sp.w, m_cycles);
+}
+
+// Register a device event. Returns EMU816_NO_EVENT if all the event slots
+// are in use.
+emu816_event_t emu816::add_event(emu816_event_fn fn, void *context)
+{
+    for (int n = 0; n < EMU816_EVENTS; ++n) {
+        if (!m_events[n].fn) {
+            m_events[n].fn = fn;
+            m_events[n].context = context;
+            m_events[n].heap = -1;
+            return (n);
+        }
+    }
+    return (EMU816_NO_EVENT);
+}
+
+// Cancel and release a device event
+void emu816::remove_event(emu816_event_t event)
+{
+    cancel(event);
+    m_events[event].fn = NULL;
+}
+
+// Schedule an event for an absolute cycle count, moving it if it is
+// already scheduled. A deadline that has passed fires at the end of the
+// current instruction.
+void emu816::schedule(emu816_event_t event, uint64_t deadline)
+{
+    int pos = m_events[event].heap;
+
+    m_events[event].deadline = deadline;
+    if (pos < 0) {
+        pos = m_scheduled++;
+        place(pos, event);
+    }
+    sift_up(pos);
+    sift_down(m_events[event].heap);
+    lower_horizon(deadline);
+}
+
+// Remove an event from the schedule
+void emu816::cancel(emu816_event_t event)
+{
+    int pos = m_events[event].heap;
+
+    if (pos < 0) return;
+    m_events[event].heap = -1;
+    if (pos != --m_scheduled) {
+        int moved = m_heap[m_scheduled];
+
+        place(pos, moved);
+        sift_up(pos);
+        sift_down(m_events[moved].heap);
+    }
+}
+
+// Return true if the event is scheduled
+bool emu816::scheduled(emu816_event_t event)
+{
+    return (m_events[event].heap >= 0);
+}
+
+// Bring the horizon of a running engine forward to an earlier deadline
+void emu816::lower_horizon(uint64_t horizon)
+{
+    uint64_t current = m_horizon.load(std::memory_order_relaxed);
+
+    while (horizon < current) {
+        if (m_horizon.compare_exchange_weak(current, horizon)) {
+            m_exit_block = true;
+            break;
+        }
+    }
+}
+
+// Fire every event whose deadline has been reached, earliest first
+void emu816::fire_events()
+{
+    while (m_scheduled && m_events[m_heap[0]].deadline <= m_cycles) {
+        EVENT &event = m_events[m_heap[0]];
+
+        cancel(m_heap[0]);
+        event.fn(event.context, event.deadline);
+    }
+}
+
+// Move the heap entry at pos towards the root while it is earlier than
+// its parent
+void emu816::sift_up(int pos)
+{
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        int event = m_heap[pos];
+
+        if (!before(pos, parent)) break;
+        place(pos, m_heap[parent]);
+        place(parent, event);
+        pos = parent;
+    }
+}
+
+// Move the heap entry at pos towards the leaves while it is later than
+// either child
+void emu816::sift_down(int pos)
+{
+    for (;;) {
+        int child = 2 * pos + 1;
+        int event = m_heap[pos];
+
+        if (child >= m_scheduled) break;
+        if (child + 1 < m_scheduled && before(child + 1, child)) ++child;
+        if (!before(child, pos)) break;
+        place(pos, m_heap[child]);
+        place(child, event);
+        pos = child;
+    }
+}
+
+uint64_t emu816::cycles() 
 { 
     return m_cycles; 
 }
@@ -111,12 +638,101 @@ bool emu816::stopped()
     return m_stopped; 
 }
 
-// Execute a single instruction or invoke an interrupt
+// Select the engine used by run(). Returns false if the engine was not
+// compiled into this build.
+bool emu816::set_engine(emu816_engine_t engine)
+{
+    switch (engine) {
+    case EMU816_ENGINE_SWITCH:
+        break;
+#if defined(EMU816_THREADED)
+    case EMU816_ENGINE_THREADED:
+        break;
+#endif
+    default:
+        return (false);
+    }
+    m_engine = engine;
+    flush_blocks();
+    return (true);
+}
+
+// Execute a single instruction or invoke an interrupt. Does nothing while
+// the processor is idle after WAI or STP.
 void emu816::step()
 {
-	// Check for NMI/IRQ
+    if (m_idle) return;
+
+    if (m_interrupt) {
+        take_interrupt();
+        return;
+    }
+    if ((m_watch[page(join(pbr, pc))] & WATCH_EXEC) && breakpoint()) return;
+
+    uint8_t opcode = read8(join(pbr, pc++));
+
+    EMU816_TRACE_INSN(opcode);
+    execute(opcode);
+}
+
+// Instruction timing packed for the interpreter: the cycles in bits 0-4,
+// TIME_DL if a non-zero low byte of D adds a cycle and TIME_CROSS if an
+// index crossing a page does.
+enum { TIME_CYCLES = 0x1f, TIME_DL = 0x20, TIME_CROSS = 0x40 };
+
+static constexpr uint8_t pack_timing(uint8_t opcode, uint32_t key)
+{
+    return ((uint8_t)(emu816_cycles(opcode, key & 4, key & 1, key & 2)
+        | ((emu816_timing[opcode] & EMU816_TIME_DL) ? TIME_DL : 0)
+        | ((emu816_timing[opcode] & EMU816_TIME_IX) && (key & 2) ? TIME_CROSS : 0)));
+}
+
+#define EMU816_TIMING_0(code, op, am, w, f) pack_timing(code, 0),
+#define EMU816_TIMING_1(code, op, am, w, f) pack_timing(code, 1),
+#define EMU816_TIMING_2(code, op, am, w, f) pack_timing(code, 2),
+#define EMU816_TIMING_3(code, op, am, w, f) pack_timing(code, 3),
+#define EMU816_TIMING_4(code, op, am, w, f) pack_timing(code, 4),
+#define EMU816_TIMING_5(code, op, am, w, f) pack_timing(code, 5),
+#define EMU816_TIMING_6(code, op, am, w, f) pack_timing(code, 6),
+#define EMU816_TIMING_7(code, op, am, w, f) pack_timing(code, 7),
+
+// Packed timing for each opcode, indexed like the block cache by mode() with
+// E in bit 2
+static constexpr uint8_t s_timing[8][256] = {
+    { EMU816_OPCODES(EMU816_TIMING_0) },
+    { EMU816_OPCODES(EMU816_TIMING_1) },
+    { EMU816_OPCODES(EMU816_TIMING_2) },
+    { EMU816_OPCODES(EMU816_TIMING_3) },
+    { EMU816_OPCODES(EMU816_TIMING_4) },
+    { EMU816_OPCODES(EMU816_TIMING_5) },
+    { EMU816_OPCODES(EMU816_TIMING_6) },
+    { EMU816_OPCODES(EMU816_TIMING_7) }
+};
 
-	switch (load8 (join(pbr, pc++))) {
+#undef EMU816_TIMING_7
+#undef EMU816_TIMING_6
+#undef EMU816_TIMING_5
+#undef EMU816_TIMING_4
+#undef EMU816_TIMING_3
+#undef EMU816_TIMING_2
+#undef EMU816_TIMING_1
+#undef EMU816_TIMING_0
+
+// Charge an instruction's cycles up front. The addressing modes that can
+// cross a page add that penalty themselves when m_cross is set, and taken
+// branches add theirs.
+void emu816::charge(uint8_t timing)
+{
+    m_cycles += (timing & TIME_CYCLES) + ((timing & TIME_DL) && dp.b);
+    m_cross = (timing & TIME_CROSS) != 0;
+}
+
+// Execute the instruction with the given opcode
+void emu816::execute(uint8_t opcode)
+{
+    charge(s_timing[mode() | (e << 2)][opcode]);
+
+	switch (opcode) {
 	case 0x00:	op_brk(am_immb());	break;
 	case 0x01:	op_ora(am_dpix());	break;
 	case 0x02:	op_cop(am_immb());	break;
@@ -391,10 +1007,500 @@ void emu816::step()
 	}
 }
 
+//------------------------------------------------------------------------------
+// Decoded block cache
+
+#define EMU816_BYTES_16_16(code, op, am, w, f)  EMU816_BYTES_##am(0, 0),
+#define EMU816_BYTES_8_16(code, op, am, w, f)   EMU816_BYTES_##am(1, 0),
+#define EMU816_BYTES_16_8(code, op, am, w, f)   EMU816_BYTES_##am(0, 1),
+#define EMU816_BYTES_8_8(code, op, am, w, f)    EMU816_BYTES_##am(1, 1),
+
+// Operand bytes for each opcode, indexed by mode() and opcode
+static const uint8_t s_bytes[4][256] = {
+    { EMU816_OPCODES(EMU816_BYTES_16_16) },
+    { EMU816_OPCODES(EMU816_BYTES_8_16) },
+    { EMU816_OPCODES(EMU816_BYTES_16_8) },
+    { EMU816_OPCODES(EMU816_BYTES_8_8) }
+};
+
+#undef EMU816_BYTES_8_8
+#undef EMU816_BYTES_16_8
+#undef EMU816_BYTES_8_16
+#undef EMU816_BYTES_16_16
+
+#define EMU816_ENDS_N   0
+#define EMU816_ENDS_M   0
+#define EMU816_ENDS_X   0
+#define EMU816_ENDS_P   1
+#define EMU816_ENDS_S   0
+#define EMU816_ENDS_B   1
+#define EMU816_ENDS_J   1
+#define EMU816_ENDS_R   1
+#define EMU816_ENDS(code, op, am, w, f)     (EMU816_ENDS_##w | EMU816_ENDS_##f),
+
+// Opcodes that transfer control or change the mode and so end a block
+static const uint8_t s_ends[256] = { EMU816_OPCODES(EMU816_ENDS) };
+
+#undef EMU816_ENDS
+#undef EMU816_ENDS_R
+#undef EMU816_ENDS_J
+#undef EMU816_ENDS_B
+#undef EMU816_ENDS_S
+#undef EMU816_ENDS_P
+#undef EMU816_ENDS_X
+#undef EMU816_ENDS_M
+#undef EMU816_ENDS_N
+
+// Turn the decoded block cache used by run() on or off
+void emu816::enable_block_cache(bool enable)
+{
+    if (enable && !m_blocks) {
+        m_blocks = new BLOCK[EMU816_BLOCK_CACHE];
+        flush_blocks();
+    }
+    else if (!enable && m_blocks) {
+        enable_jit(false);
+        delete [] m_blocks;
+        m_blocks = NULL;
+    }
+}
+
+// Map a page aligned range of the address space onto host memory. Loads and
+// stores permitted by the flags access the host memory directly, bypassing
+// the virtual load and store functions. EMU816_MAP_MMIO restores the use of
+// the virtual functions for the range.
+void emu816::map_memory(emu816_addr_t base, uint32_t size, uint8_t *host, uint32_t flags)
+{
+    for (uint32_t n = 0; n < size / EMU816_PAGE_SIZE; ++n) {
+        uint32_t pg = page(base + n * EMU816_PAGE_SIZE);
+        uint8_t *mem = host ? host + n * EMU816_PAGE_SIZE : NULL;
+
+        m_read[pg] = (flags & EMU816_MAP_READ) ? mem : NULL;
+        m_write[pg] = (flags & EMU816_MAP_WRITE) ? mem : NULL;
+        m_shared[pg] = NULL;
+    }
+    invalidate_code(base, size);
+}
+
+// Give a fork its own copy of a page it shares with its parent and return
+// the copy. Pages are allocated once and reused by later forks.
+uint8_t *emu816::copy_page(uint32_t page)
+{
+    if (m_copies_used == m_copies.size())
+        m_copies.push_back(new uint8_t[EMU816_PAGE_SIZE]);
+
+    uint8_t *copy = m_copies[m_copies_used++];
+
+    memcpy(copy, m_shared[page], EMU816_PAGE_SIZE);
+    if (m_read[page] == m_shared[page]) m_read[page] = copy;
+    m_write[page] = copy;
+    m_shared[page] = NULL;
+    return (copy);
+}
+
+// Discard any decoded blocks for the given address range. Must be called by
+// the host after changing code memory other than through store8/store16 or
+// mapped memory from the processor, e.g. when loading a new program image.
+void emu816::invalidate_code(emu816_addr_t ea, uint32_t size)
+{
+    if (size == 0) return;
+
+    for (uint32_t n = page(ea), last = page(ea + size - 1);; n = (n + 1) % EMU816_PAGES) {
+        if (m_watch[n] & WATCH_CODE) invalidate_page(n);
+        if (n == last) break;
+    }
+}
+
+// Invalidate all the blocks decoded from a page
+void emu816::invalidate_page(uint32_t page)
+{
+    m_watch[page] &= ~WATCH_CODE;
+    ++m_code_gen[page];
+    m_exit_block = true;
+}
+
+// Discard all decoded blocks
+void emu816::flush_blocks()
+{
+    if (m_blocks) {
+        for (uint32_t n = 0; n < EMU816_BLOCK_CACHE; ++n)
+            m_blocks[n].count = 0;
+    }
+    for (uint32_t n = 0; n < EMU816_PAGES; ++n)
+        m_watch[n] &= ~WATCH_CODE;
+}
+
+// Find or decode the block starting at the current PC in the current mode.
+// Returns NULL if the first instruction cannot be cached, in which case it
+// is executed normally.
+emu816::BLOCK *emu816::find_block(void * const *handlers)
+{
+    emu816_addr_t start = join(pbr, pc);
+    uint32_t pg = page(start);
+    uint8_t key = mode() | (e << 2);
+    // A multiplicative hash, as handlers and entry points at the start of
+    // a page would otherwise share slots with code just into other pages
+    BLOCK &b = m_blocks[((start * 0x9e3779b1u) >> 16) & (EMU816_BLOCK_CACHE - 1)];
+
+    // Code in an unmapped page is fetched through load8() by step(), one
+    // instruction at a time, so reading ahead has no side effects
+    if (!m_read[pg]) return (NULL);
+
+    if (b.count && b.start == start && b.mode == key) {
+        if (b.gen == m_code_gen[pg])
+            return (&b);
+        if (b.native)
+            ++m_jit_stats.invalidated;
+    }
+
+    b.start = start;
+    b.gen = m_code_gen[pg];
+    b.mode = key;
+    b.count = 0;
+    b.hits = 0;
+    b.native = NULL;
+
+    for (uint32_t addr = pc; b.count < EMU816_BLOCK_LENGTH && addr <= 0xffff;) {
+        // Breakpoints are only checked at the start of a block
+        if (b.count && (m_watch[pg] & WATCH_EXEC) && (break_kinds(bank(pbr) | addr) & EMU816_BREAK_EXEC))
+            break;
+
+        uint8_t opcode = read8(bank(pbr) | addr);
+        uint32_t bytes = s_bytes[mode()][opcode];
+
+        if (addr + bytes > 0xffff || page(bank(pbr) | (addr + bytes)) != pg) break;
+
+        INSN &insn = b.insn[b.count++];
+
+        insn.handler = handlers ? handlers[opcode] : NULL;
+        insn.opcode = opcode;
+        insn.length = 1 + bytes;
+        insn.operand = 0;
+        for (uint32_t n = 0; n < bytes; ++n)
+            insn.operand |= read8(bank(pbr) | (addr + 1 + n)) << (8 * n);
+
+        addr += insn.length;
+        if (s_ends[opcode]) break;
+    }
+
+    if (b.count == 0) return (NULL);
+
+    b.max_cycles = 0;
+    for (uint32_t n = 0; n < b.count; ++n)
+        b.max_cycles += emu816_max_cycles(b.insn[n].opcode, e, key & 1, key & 2);
+    m_watch[pg] |= WATCH_CODE;
+    return (&b);
+}
+
+// Execute instructions from decoded blocks until stopped. The budget is
+// only checked per instruction for a block that might overrun it.
+void emu816::run_cached()
+{
+    while (!m_stopped) {
+        uint64_t horizon = m_horizon.load(std::memory_order_relaxed);
+
+        if (m_cycles >= horizon) break;
+        if (m_interrupt) {
+            take_interrupt();
+            continue;
+        }
+
+        BLOCK *block = find_block(NULL);
+
+        if (!block) {
+            step();
+            continue;
+        }
+        if ((m_watch[page(block->start)] & WATCH_EXEC) && breakpoint()) break;
+
+        m_exit_block = false;
+        if (m_jit && run_native(block, horizon))
+            continue;
+
+        if (m_cycles + block->max_cycles < horizon) horizon = UINT64_MAX;
+        for (uint32_t n = 0; n < block->count;) {
+            m_insn = &block->insn[n++];
+            ++pc;
+            EMU816_TRACE_INSN(m_insn->opcode);
+            execute(m_insn->opcode);
+
+            if (m_stopped || m_exit_block || m_cycles >= horizon) break;
+        }
+        m_insn = NULL;
+    }
+}
+
+// Memory and stack accesses made by translated code use the same paths as
+// the interpreter.
+uint32_t emu816::jit_load8(emu816 *cpu, emu816_addr_t ea)
+{
+    return (cpu->load<uint8_t>(ea));
+}
+
+uint32_t emu816::jit_load16(emu816 *cpu, emu816_addr_t ea)
+{
+    return (cpu->load<uint16_t>(ea));
+}
+
+void emu816::jit_store8(emu816 *cpu, emu816_addr_t ea, uint32_t data)
+{
+    cpu->store<uint8_t>(ea, data);
+}
+
+void emu816::jit_store16(emu816 *cpu, emu816_addr_t ea, uint32_t data)
+{
+    cpu->store<uint16_t>(ea, data);
+}
+
+void emu816::jit_push8(emu816 *cpu, uint32_t value)
+{
+    cpu->pushByte(value);
+}
+
+void emu816::jit_push16(emu816 *cpu, uint32_t value)
+{
+    cpu->pushWord(value);
+}
+
+uint32_t emu816::jit_pull8(emu816 *cpu)
+{
+    return (cpu->pullByte());
+}
+
+uint32_t emu816::jit_pull16(emu816 *cpu)
+{
+    return (cpu->pullWord());
+}
+
+#if defined(EMU816_COVERAGE)
+// Count the edge to the PC a translated transfer has just set
+void emu816::jit_cover(emu816 *cpu)
+{
+    cpu->cover(cpu->join(cpu->pbr, cpu->pc));
+}
+#endif
+
+#if defined(EMU816_THREADED)
+// Operand width specific forms of the addressing modes used by the threaded
+// engine. Only the immediate modes depend on the width.
+#define EMU816_AM_absl(T)   am_absl()
+#define EMU816_AM_absx(T)   am_absx()
+#define EMU816_AM_absy(T)   am_absy()
+#define EMU816_AM_absi(T)   am_absi()
+#define EMU816_AM_abxi(T)   am_abxi()
+#define EMU816_AM_alng(T)   am_alng()
+#define EMU816_AM_alnx(T)   am_alnx()
+#define EMU816_AM_abil(T)   am_abil()
+#define EMU816_AM_dpag(T)   am_dpag()
+#define EMU816_AM_dpgx(T)   am_dpgx()
+#define EMU816_AM_dpgy(T)   am_dpgy()
+#define EMU816_AM_dpgi(T)   am_dpgi()
+#define EMU816_AM_dpix(T)   am_dpix()
+#define EMU816_AM_dpiy(T)   am_dpiy()
+#define EMU816_AM_dpil(T)   am_dpil()
+#define EMU816_AM_dily(T)   am_dily()
+#define EMU816_AM_impl(T)   am_impl()
+#define EMU816_AM_acc(T)    am_acc()
+#define EMU816_AM_immb(T)   am_immb()
+#define EMU816_AM_immw(T)   am_immw()
+#define EMU816_AM_immm(T)   am_immm<T>()
+#define EMU816_AM_immx(T)   am_immx<T>()
+#define EMU816_AM_lrel(T)   am_lrel()
+#define EMU816_AM_rela(T)   am_rela()
+#define EMU816_AM_srel(T)   am_srel()
+#define EMU816_AM_sriy(T)   am_sriy()
+
+// Execute instructions until stopped using threaded code. Each handler ends
+// with its own indirect jump to the next one so the branch predictor sees a
+// separate history per opcode, and flattening pulls the addressing mode and
+// operation bodies into the handler.
+//
+// Operations whose width depends on M or X have an 8-bit and a 16-bit
+// handler, and there is one handler table for each combination of widths.
+// The active table, and the row of instruction timings that goes with it,
+// is only reselected after an operation that can change E, M or X so no
+// width test is made on the common path.
+//
+// When CACHED is set instructions are taken from the decoded block cache,
+// which holds the handler address for each instruction.
+//
+// Note that step() is not called, so an override of it in a subclass is
+// bypassed by this engine.
+template <bool CACHED> EMU816_FLATTEN void emu816::run_threaded()
+{
+#define EMU816_LABEL_N(code, m, x)      &&L_##code,
+#define EMU816_LABEL_P(code, m, x)      &&L_##code,
+#define EMU816_LABEL_M(code, m, x)      &&L_##code##_##m,
+#define EMU816_LABEL_X(code, m, x)      &&L_##code##_##x,
+#define EMU816_LABEL_16_16(code, op, am, w, f)  EMU816_LABEL_##w(code, 16, 16)
+#define EMU816_LABEL_8_16(code, op, am, w, f)   EMU816_LABEL_##w(code, 8, 16)
+#define EMU816_LABEL_16_8(code, op, am, w, f)   EMU816_LABEL_##w(code, 16, 8)
+#define EMU816_LABEL_8_8(code, op, am, w, f)    EMU816_LABEL_##w(code, 8, 8)
+
+#define EMU816_HANDLER_N(code, op, am) \
+    L_##code: charge(timing[code]); op_##op(am_##am()); EMU816_NEXT
+#define EMU816_HANDLER_P(code, op, am) \
+    L_##code: charge(timing[code]); op_##op(am_##am()); EMU816_RESELECT EMU816_NEXT
+#define EMU816_HANDLER_M(code, op, am) \
+    L_##code##_8: charge(timing[code]); op_##op<uint8_t>(EMU816_AM_##am(uint8_t)); EMU816_NEXT \
+    L_##code##_16: charge(timing[code]); op_##op<uint16_t>(EMU816_AM_##am(uint16_t)); EMU816_NEXT
+#define EMU816_HANDLER_X(code, op, am)  EMU816_HANDLER_M(code, op, am)
+#define EMU816_HANDLER(code, op, am, w, f)  EMU816_HANDLER_##w(code, op, am)
+
+#define EMU816_RESELECT \
+    table = tables[mode()]; \
+    timing = s_timing[mode() | (e << 2)];
+#define EMU816_BLOCK_NEXT \
+    m_insn = insn++; \
+    --left; \
+    ++pc; \
+    EMU816_TRACE_INSN(m_insn->opcode); \
+    goto *m_insn->handler;
+#define EMU816_FETCH \
+    { \
+        if ((m_watch[page(join(pbr, pc))] & WATCH_EXEC) && breakpoint()) goto done; \
+        uint8_t opcode = read8(join(pbr, pc++)); \
+        EMU816_TRACE_INSN(opcode); \
+        goto *table[opcode]; \
+    }
+#define EMU816_DISPATCH \
+    if (m_stopped) goto done; \
+    if (CACHED) { \
+        if (left && !m_exit_block) { EMU816_BLOCK_NEXT } \
+        goto lookup; \
+    } \
+    if (m_interrupt) goto pending; \
+    EMU816_FETCH
+#define EMU816_NEXT \
+    if (m_cycles >= (CACHED ? limit : m_horizon.load(std::memory_order_relaxed))) goto done; \
+    EMU816_DISPATCH
+
+    static void * const tables[4][256] = {
+        { EMU816_OPCODES(EMU816_LABEL_16_16) },
+        { EMU816_OPCODES(EMU816_LABEL_8_16) },
+        { EMU816_OPCODES(EMU816_LABEL_16_8) },
+        { EMU816_OPCODES(EMU816_LABEL_8_8) }
+    };
+    void * const *table = tables[mode()];
+    const uint8_t *timing = s_timing[mode() | (e << 2)];
+    const INSN *insn = NULL;
+    BLOCK *block;
+    uint32_t left = 0;
+    uint64_t limit = 0;
+
+    EMU816_DISPATCH
+    EMU816_OPCODES(EMU816_HANDLER)
+
+    // The budget is only checked per instruction for a block that might
+    // overrun it
+lookup:
+    m_insn = NULL;
+    m_exit_block = false;
+    left = 0;
+    limit = m_horizon.load(std::memory_order_relaxed);
+    if (m_cycles >= limit) goto done;
+    if (m_interrupt) goto pending;
+    if ((block = find_block(table)) != NULL) {
+        if ((m_watch[page(block->start)] & WATCH_EXEC) && breakpoint()) goto done;
+        if (m_jit && run_native(block, limit)) {
+            EMU816_NEXT
+        }
+        if (m_cycles + block->max_cycles < limit) limit = UINT64_MAX;
+        insn = block->insn;
+        left = block->count;
+        EMU816_BLOCK_NEXT
+    }
+    EMU816_FETCH
+
+pending:
+    m_insn = NULL;
+    take_interrupt();
+    EMU816_RESELECT
+    EMU816_NEXT
+
+done:
+    m_insn = NULL;
+
+#undef EMU816_NEXT
+#undef EMU816_DISPATCH
+#undef EMU816_FETCH
+#undef EMU816_BLOCK_NEXT
+#undef EMU816_RESELECT
+#undef EMU816_HANDLER
+#undef EMU816_HANDLER_X
+#undef EMU816_HANDLER_M
+#undef EMU816_HANDLER_P
+#undef EMU816_HANDLER_N
+#undef EMU816_LABEL_8_8
+#undef EMU816_LABEL_16_8
+#undef EMU816_LABEL_8_16
+#undef EMU816_LABEL_16_16
+#undef EMU816_LABEL_X
+#undef EMU816_LABEL_M
+#undef EMU816_LABEL_P
+#undef EMU816_LABEL_N
+}
+#endif
+
+// Continue a MVN (step 1) or MVP (step -1) with host copies for as long as
+// the source and destination are mapped memory and the cycle budget lasts.
+// The registers and cycle count end up exactly as if each byte had been
+// moved by a separate instruction. Anything else, including moves onto the
+// page holding the instruction, is left to be done a byte at a time.
+void emu816::move_block(uint8_t src, uint8_t dst, int step)
+{
+    uint64_t horizon = m_horizon.load(std::memory_order_relaxed);
+
+    while (a.w != 0xffff && m_cycles < horizon) {
+        emu816_addr_t from = join(src, x.w);
+        emu816_addr_t to = join(dst, y.w);
+        uint8_t *wr = m_write[page(to)];
+
+        if (!wr && m_shared[page(to)]) wr = copy_page(page(to));
+
+        const uint8_t *rd = m_read[page(from)];
+
+        if (!rd || !wr) break;
+        if ((m_watch[page(from)] & WATCH_LOAD) || (m_watch[page(to)] & WATCH_STORE)) break;
+        if (page(to) == page(join(pbr, pc)) || page(to) == page(join(pbr, (uint16_t)(pc + 2)))) break;
+
+        // Stay within both pages and the budget
+        uint32_t count = (uint32_t)a.w + 1;
+        uint32_t left = (step > 0) ? EMU816_PAGE_SIZE - offset(from) : offset(from) + 1;
+
+        if (count > left) count = left;
+        left = (step > 0) ? EMU816_PAGE_SIZE - offset(to) : offset(to) + 1;
+        if (count > left) count = left;
+        if (count > (horizon - m_cycles + 6) / 7) count = (uint32_t)((horizon - m_cycles + 6) / 7);
+
+        if (m_watch[page(to)]) written(page(to));
+
+        // Overlapping moves repeat a pattern, which memmove would not
+        const uint8_t *s = rd + offset(from);
+        uint8_t *d = wr + offset(to);
+        intptr_t gap = (step > 0) ? (intptr_t)d - (intptr_t)s : (intptr_t)s - (intptr_t)d;
+
+        if (gap > 0 && gap < (intptr_t)count) {
+            for (intptr_t n = 0; n < (intptr_t)count; ++n)
+                d[n * step] = s[n * step];
+        }
+        else if (step > 0)
+            memmove(d, s, count);
+        else
+            memmove(d - (count - 1), s - (count - 1), count);
+
+        x.w += count * step;
+        y.w += count * step;
+        a.w -= count;
+        m_cycles += 7 * count;
+    }
+    if (a.w == 0xffff) pc += 3;
+}
+
 // Push a byte on the stack
 void emu816::pushByte(uint8_t value)
 {
-    store8(sp.w, value);
+    write8(sp.w, value);
 
     if (e)
         --sp.b;
@@ -417,7 +1523,7 @@ uint8_t emu816::pullByte()
     else
         ++sp.w;
 
-    return (load8(sp.w));
+    return (read8(sp.w));
 }
 
 // Pull a word from the stack
@@ -432,161 +1538,152 @@ uint16_t emu816::pullWord()
 // Absolute - a
 emu816_addr_t emu816::am_absl()
 {
-    emu816_addr_t	ea = join (dbr, load16(bank(pbr) | pc));
+    emu816_addr_t	ea = join (dbr, operand16());
 
     addPC(2);
-    m_cycles += 2;
     return (ea);
 }
 
 // Absolute Indexed X - a,X
 emu816_addr_t emu816::am_absx()
 {
-    emu816_addr_t	ea = join(dbr, load16(bank(pbr) | pc)) + x.w;
+    emu816_addr_t	base = join(dbr, operand16());
+    emu816_addr_t	ea = base + x.w;
 
     addPC(2);
-    m_cycles += 2;
+    if (m_cross && ((base ^ ea) & 0xffff00)) ++m_cycles;
     return (ea);
 }
 
 // Absolute Indexed Y - a,Y
 emu816_addr_t emu816::am_absy()
 {
-    emu816_addr_t	ea = join(dbr, load16(bank(pbr) | pc)) + y.w;
+    emu816_addr_t	base = join(dbr, operand16());
+    emu816_addr_t	ea = base + y.w;
 
     addPC(2);
-    m_cycles += 2;
+    if (m_cross && ((base ^ ea) & 0xffff00)) ++m_cycles;
     return (ea);
 }
 
 // Absolute Indirect - (a)
 emu816_addr_t emu816::am_absi()
 {
-    emu816_addr_t ia = join(0, load16(bank(pbr) | pc));
+    emu816_addr_t ia = join(0, operand16());
 
     addPC(2);
-    m_cycles += 4;
-    return (join(0, load16(ia)));
+    return (join(0, read16(ia)));
 }
 
 // Absolute Indexed Indirect - (a,X)
 emu816_addr_t emu816::am_abxi()
 {
-    emu816_addr_t ia = join(pbr, load16(join(pbr, pc))) + x.w;
+    emu816_addr_t ia = join(pbr, operand16()) + x.w;
 
     addPC(2);
-    m_cycles += 4;
-    return (join(pbr, load16(ia)));
+    return (join(pbr, read16(ia)));
 }
 
 // Absolute Long - >a
 emu816_addr_t emu816::am_alng()
 {
-    emu816_addr_t ea = load24(join(pbr, pc));
+    emu816_addr_t ea = operand24();
 
     addPC(3);
-    m_cycles += 3;
     return (ea);
 }
 
 // Absolute Long Indexed - >a,X
 emu816_addr_t emu816::am_alnx()
 {
-    emu816_addr_t ea = load24(join(pbr, pc)) + x.w;
+    emu816_addr_t ea = operand24() + x.w;
 
     addPC(3);
-    m_cycles += 3;
     return (ea);
 }
 
 // Absolute Indirect Long - [a]
 emu816_addr_t emu816::am_abil()
 {
-    emu816_addr_t ia = bank(0) | load16(join(pbr, pc));
+    emu816_addr_t ia = bank(0) | operand16();
 
     addPC(2);
-    m_cycles += 5;
-    return (load24(ia));
+    return (read24(ia));
 }
 
 // Direct Page - d
 emu816_addr_t emu816::am_dpag()
 {
-    uint8_t offset = load8(bank(pbr) | pc);
+    uint8_t offset = operand8();
 
     addPC(1);
-    m_cycles += 1;
     return (bank(0) | (uint16_t)(dp.w + offset));
 }
 
 // Direct Page Indexed X - d,X
 emu816_addr_t emu816::am_dpgx()
 {
-    uint8_t offset = load8(bank(pbr) | pc) + x.b;
+    uint8_t offset = operand8() + x.b;
 
     addPC(1);
-    m_cycles += 1;
     return (bank(0) | (uint16_t)(dp.w + offset));
 }
 
 // Direct Page Indexed Y - d,Y
 emu816_addr_t emu816::am_dpgy()
 {
-    uint8_t offset = load8(bank(pbr) | pc) + y.b;
+    uint8_t offset = operand8() + y.b;
 
     addPC(1);
-    m_cycles += 1;
     return (bank(0) | (uint16_t)(dp.w + offset));
 }
 
 // Direct Page Indirect - (d)
 emu816_addr_t emu816::am_dpgi()
 {
-    uint8_t disp = load8(bank(pbr) | pc);
+    uint8_t disp = operand8();
 
     addPC(1);
-    m_cycles += 3;
-    return (bank(dbr) | load16(bank(0) | (uint16_t)(dp.w + disp)));
+    return (bank(dbr) | read16(bank(0) | (uint16_t)(dp.w + disp)));
 }
 
 // Direct Page Indexed Indirect - (d,x)
 emu816_addr_t emu816::am_dpix()
 {
-    uint8_t disp = load8(join(pbr, pc));
+    uint8_t disp = operand8();
 
     addPC(1);
-    m_cycles += 3;
-    return (bank(dbr) | load16(bank(0) | (uint16_t)(dp.w + disp + x.w)));
+    return (bank(dbr) | read16(bank(0) | (uint16_t)(dp.w + disp + x.w)));
 }
 
 // Direct Page Indirect Indexed - (d),Y
 emu816_addr_t emu816::am_dpiy()
 {
-    uint8_t disp = load8(join(pbr, pc));
+    uint8_t disp = operand8();
+    uint16_t ia;
 
     addPC(1);
-    m_cycles += 3;
-    return (bank(dbr) | load16(bank(0) | (dp.w + disp)) + y.w);
+    ia = read16(bank(0) | (dp.w + disp));
+    if (m_cross && lo(ia) + y.w > 0xff) ++m_cycles;
+    return (bank(dbr) | ia + y.w);
 }
 
 // Direct Page Indirect Long - [d]
 emu816_addr_t emu816::am_dpil()
 {
-    uint8_t disp = load8(join(pbr, pc));
+    uint8_t disp = operand8();
 
     addPC(1);
-    m_cycles += 4;
-    return (load24(bank(0) | (uint16_t)(dp.w + disp)));
+    return (read24(bank(0) | (uint16_t)(dp.w + disp)));
 }
 
 // Direct Page Indirect Long Indexed - [d],Y
 emu816_addr_t emu816::am_dily()
 {
-    uint8_t disp = load8(join(pbr, pc));
+    uint8_t disp = operand8();
 
     addPC(1);
-    m_cycles += 4;
-    return (load24(bank(0) | (uint16_t)(dp.w + disp)) + y.w);
+    return (read24(bank(0) | (uint16_t)(dp.w + disp)) + y.w);
 }
 
 // Implied/Stack
@@ -609,7 +1706,6 @@ emu816_addr_t emu816::am_immb()
     emu816_addr_t ea = bank(pbr) | pc;
 
     addPC(1);
-    m_cycles += 0;
     return (ea);
 }
 
@@ -619,59 +1715,59 @@ emu816_addr_t emu816::am_immw()
     emu816_addr_t ea = bank(pbr) | pc;
 
     addPC(2);
-    m_cycles += 1;
     return (ea);
 }
 
 // Immediate based on size of A/M
 emu816_addr_t emu816::am_immm()
 {
-    emu816_addr_t ea = join (pbr, pc);
-    uint32_t size = (e || p.f_m) ? 1 : 2;
-
-    addPC(size);
-    m_cycles += size - 1;
-    return (ea);
+    return ((e || p.f_m) ? am_immm<uint8_t>() : am_immm<uint16_t>());
 }
 
 // Immediate based on size of X/Y
 emu816_addr_t emu816::am_immx()
+{
+    return ((e || p.f_x) ? am_immx<uint8_t>() : am_immx<uint16_t>());
+}
+
+// Immediate of a known size
+template <typename T> emu816_addr_t emu816::am_immm()
 {
     emu816_addr_t ea = join(pbr, pc);
-    uint32_t size = (e || p.f_x) ? 1 : 2;
 
-    addPC(size);
-    m_cycles += size - 1;
+    addPC(sizeof(T));
     return (ea);
 }
 
+template <typename T> emu816_addr_t emu816::am_immx()
+{
+    return (am_immm<T>());
+}
+
 // Long Relative - d
 emu816_addr_t emu816::am_lrel()
 {
-    uint16_t disp = load16(join(pbr, pc));
+    uint16_t disp = operand16();
 
     addPC(2);
-    m_cycles += 2;
     return (bank(pbr) | (uint16_t)(pc + (signed short)disp));
 }
 
 // Relative - d
 emu816_addr_t emu816::am_rela()
 {
-    uint8_t disp = load8(join(pbr, pc));
+    uint8_t disp = operand8();
 
     addPC(1);
-    m_cycles += 1;
     return (bank(pbr) | (uint16_t)(pc + (signed char)disp));
 }
 
 // Stack Relative - d,S
 emu816_addr_t emu816::am_srel()
 {
-    uint8_t disp = load8(join(pbr, pc));
+    uint8_t disp = operand8();
 
     addPC(1);
-    m_cycles += 1;
 
     if (e)
         return((bank(0) | join(sp.b + disp, hi(sp.w))));
@@ -682,16 +1778,15 @@ emu816_addr_t emu816::am_srel()
 // Stack Relative Indirect Indexed Y - (d,S),Y
 emu816_addr_t emu816::am_sriy()
 {
-    uint8_t disp = load8(join(pbr, pc));
+    uint8_t disp = operand8();
     uint16_t ia;
 
     addPC(1);
-    m_cycles += 3;
 
     if (e)
-        ia = load16(join(sp.b + disp, hi(sp.w)));
+        ia = read16(join(sp.b + disp, hi(sp.w)));
     else
-        ia = load16(bank(0) | (sp.w + disp));
+        ia = read16(bank(0) | (sp.w + disp));
 
     return (bank(dbr) | (uint16_t)(ia + y.w));
 }
@@ -699,13 +1794,13 @@ emu816_addr_t emu816::am_sriy()
 // Set the Negative flag
 void emu816::setn(uint32_t flag)
 {
-    p.f_n = flag ? 1 : 0;
+    m_n = flag ? 0x80 : 0x00;
 }
 
 // Set the Overflow flag
 void emu816::setv(uint32_t flag)
 {
-    p.f_v = flag ? 1 : 0;
+    m_v = flag ? 1 : 0;
 }
 
 // Set the decimal flag
@@ -718,226 +1813,151 @@ void emu816::setd(uint32_t flag)
 void emu816::seti(uint32_t flag)
 {
     p.f_i = flag ? 1 : 0;
+    update_interrupts();
 }
 
 // Set the Zero flag
 void emu816::setz(uint32_t flag)
 {
-    p.f_z = flag ? 1 : 0;
+    m_z = flag ? 0 : 1;
 }
 
 // Set the Carry flag
 void emu816::setc(uint32_t flag)
 {
-    p.f_c = flag ? 1 : 0;
+    m_c = flag ? 1 : 0;
 }
 
-// Set the Negative and Zero flags from a byte value
+// Set the Negative and Zero flags from a byte value. The flags are only
+// worked out from the value when read.
 void emu816::setnz_b(uint8_t value)
 {
-    setn(value & 0x80);
-    setz(value == 0);
+    m_n = value;
+    m_z = value;
 }
 
 // Set the Negative and Zero flags from a word value
 void emu816::setnz_w(uint16_t value)
 {
-    setn(value & 0x8000);
-    setz(value == 0);
+    m_n = hi(value);
+    m_z = value;
 }
 
-void emu816::op_adc(emu816_addr_t ea)
+template <typename T> void emu816::op_adc(emu816_addr_t ea)
 {
-    if (e || p.f_m) {
-        uint8_t	data = load8(ea);
-        uint16_t	temp = a.b + data + p.f_c;
-        
-        if (p.f_d) {
-            if ((temp & 0x0f) > 0x09) temp += 0x06;
-            if ((temp & 0xf0) > 0x90) temp += 0x60;
-        }
+    T       data = load<T>(ea);
+    uint32_t temp = reg<T>(a) + data + m_c;
 
-        setc(temp & 0x100);
-        setv((~(a.b ^ data)) & (a.b ^ temp) & 0x80);
-        setnz_b(a.b = lo(temp));
-        m_cycles += 2;
-    }
-    else {
-        uint16_t	data = load16(ea);
-        int		temp = a.w + data + p.f_c;
-
-        if (p.f_d) {
-            if ((temp & 0x000f) > 0x0009) temp += 0x0006;
-            if ((temp & 0x00f0) > 0x0090) temp += 0x0060;
-            if ((temp & 0x0f00) > 0x0900) temp += 0x0600;
-            if ((temp & 0xf000) > 0x9000) temp += 0x6000;
-        }
-        
-        setc(temp & 0x10000);
-        setv((~(a.w ^ data)) & (a.w ^ temp) & 0x8000);
-        setnz_w(a.w = (uint16_t)temp);
-        m_cycles += 2;
+    if (p.f_d) {
+        for (uint32_t shift = 0; shift < 8 * sizeof(T); shift += 4)
+            if ((temp & (0x0f << shift)) > (0x09u << shift)) temp += 0x06 << shift;
     }
+
+    setc(temp & (msb<T>() << 1));
+    setv((~(reg<T>(a) ^ data)) & (reg<T>(a) ^ temp) & msb<T>());
+    setnz<T>(reg<T>(a) = (T)temp);
 }
 
-void emu816::op_and(emu816_addr_t ea)
+template <typename T> void emu816::op_and(emu816_addr_t ea)
 {
-
-    if (e || p.f_m) {
-        setnz_b(a.b &= load8(ea));
-        m_cycles += 2;
-    }
-    else {
-        setnz_w(a.w &= load16(ea));
-        m_cycles += 3;
-    }
+    setnz<T>(reg<T>(a) &= load<T>(ea));
 }
 
-void emu816::op_asl(emu816_addr_t ea)
+template <typename T> void emu816::op_asl(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
 
-    if (e || p.f_m) {
-        uint8_t data = load8(ea);
-
-        setc(data & 0x80);
-        setnz_b(data <<= 1);
-        store8(ea, data);
-        m_cycles += 4;
-    }
-    else {
-        uint16_t data = load16(ea);
-
-        setc(data & 0x8000);
-        setnz_w(data <<= 1);
-        store16(ea, data);
-        m_cycles += 5;
-    }
+    setc(data & msb<T>());
+    setnz<T>(data <<= 1);
+    store<T>(ea, data);
 }
 
-void emu816::op_asla(emu816_addr_t ea)
+template <typename T> void emu816::op_asla(emu816_addr_t ea)
 {
-
-    if (e || p.f_m) {
-        setc(a.b & 0x80);
-        setnz_b(a.b <<= 1);
-        store8(ea, a.b);
-    }
-    else {
-        setc(a.w & 0x8000);
-        setnz_w(a.w <<= 1);
-        store16(ea, a.w);
-    }
-    m_cycles += 2;
+    setc(reg<T>(a) & msb<T>());
+    setnz<T>(reg<T>(a) <<= 1);
 }
 
 void emu816::op_bcc(emu816_addr_t ea)
 {
 
-    if (p.f_c == 0) {
+    if (!m_c) {
         if (e && ((pc ^ ea) & 0xff00)) ++m_cycles;
         pc = (uint16_t)ea;
-        m_cycles += 3;
+        ++m_cycles;
+        EMU816_COVER();
     }
-    else
-        m_cycles += 2;
 }
 
 void emu816::op_bcs(emu816_addr_t ea)
 {
 
-    if (p.f_c == 1) {
+    if (m_c) {
         if (e && ((pc ^ ea) & 0xff00)) ++m_cycles;
         pc = (uint16_t)ea;
-        m_cycles += 3;
+        ++m_cycles;
+        EMU816_COVER();
     }
-    else
-        m_cycles += 2;
 }
 
 void emu816::op_beq(emu816_addr_t ea)
 {
 
-    if (p.f_z == 1) {
+    if (m_z == 0) {
         if (e && ((pc ^ ea) & 0xff00)) ++m_cycles;
         pc = (uint16_t)ea;
-        m_cycles += 3;
+        ++m_cycles;
+        EMU816_COVER();
     }
-    else
-        m_cycles += 2;
 }
 
-void emu816::op_bit(emu816_addr_t ea)
+template <typename T> void emu816::op_bit(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
 
-    if (e || p.f_m) {
-        uint8_t data = load8(ea);
-
-        setz((a.b & data) == 0);
-        setn(data & 0x80);
-        setv(data & 0x40);
-        m_cycles += 2;
-    }
-    else {
-        uint16_t data = load16(ea);
-
-        setz((a.w & data) == 0);
-        setn(data & 0x8000);
-        setv(data & 0x4000);
-
-        m_cycles += 3;
-    }
+    setz((reg<T>(a) & data) == 0);
+    setn(data & msb<T>());
+    setv(data & (msb<T>() >> 1));
 }
 
-void emu816::op_biti(emu816_addr_t ea)
+template <typename T> void emu816::op_biti(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
 
-    if (e || p.f_m) {
-        uint8_t data = load8(ea);
-
-        setz((a.b & data) == 0);
-    }
-    else {
-        uint16_t data = load16(ea);
-
-        setz((a.w & data) == 0);
-    }
-    m_cycles += 2;
+    setz((reg<T>(a) & data) == 0);
 }
 
 void emu816::op_bmi(emu816_addr_t ea)
 {
 
-    if (p.f_n == 1) {
+    if (m_n & 0x80) {
         if (e && ((pc ^ ea) & 0xff00)) ++m_cycles;
         pc = (uint16_t)ea;
-        m_cycles += 3;
+        ++m_cycles;
+        EMU816_COVER();
     }
-    else
-        m_cycles += 2;
 }
 
 void emu816::op_bne(emu816_addr_t ea)
 {
 
-    if (p.f_z == 0) {
+    if (m_z != 0) {
         if (e && ((pc ^ ea) & 0xff00)) ++m_cycles;
         pc = (uint16_t)ea;
-        m_cycles += 3;
+        ++m_cycles;
+        EMU816_COVER();
     }
-    else
-        m_cycles += 2;
 }
 
 void emu816::op_bpl(emu816_addr_t ea)
 {
 
-    if (p.f_n == 0) {
+    if (!(m_n & 0x80)) {
         if (e && ((pc ^ ea) & 0xff00)) ++m_cycles;
         pc = (uint16_t)ea;
-        m_cycles += 3;
+        ++m_cycles;
+        EMU816_COVER();
     }
-    else
-        m_cycles += 2;
 }
 
 void emu816::op_bra(emu816_addr_t ea)
@@ -945,306 +1965,151 @@ void emu816::op_bra(emu816_addr_t ea)
 
     if (e && ((pc ^ ea) & 0xff00)) ++m_cycles;
     pc = (uint16_t)ea;
-    m_cycles += 3;
+    ++m_cycles;
+    EMU816_COVER();
 }
 
 void emu816::op_brk(emu816_addr_t ea)
 {
 
-    if (e) {
-        pushWord(pc);
-        pushByte(p.b | 0x10);
-
-        p.f_i = 1;
-        p.f_d = 0;
-        pbr = 0;
-
-        pc = load16(0xfffe);
-        m_cycles += 7;
-    }
-    else {
-        pushByte(pbr);
-        pushWord(pc);
-        pushByte(p.b);
-
-        p.f_i = 1;
-        p.f_d = 0;
-        pbr = 0;
-
-        pc = load16(0xffe6);
-        m_cycles += 8;
-    }
+    enter_vector(e ? get_p() | 0x10 : get_p(), 0xfffe, 0xffe6);
 }
 
 void emu816::op_brl(emu816_addr_t ea)
 {
 
     pc = (uint16_t)ea;
-    m_cycles += 3;
+    EMU816_COVER();
 }
 
 void emu816::op_bvc(emu816_addr_t ea)
 {
 
-    if (p.f_v == 0) {
+    if (!m_v) {
         if (e && ((pc ^ ea) & 0xff00)) ++m_cycles;
         pc = (uint16_t)ea;
-        m_cycles += 3;
+        ++m_cycles;
+        EMU816_COVER();
     }
-    else
-        m_cycles += 2;
 }
 
 void emu816::op_bvs(emu816_addr_t ea)
 {
 
-    if (p.f_v == 1) {
+    if (m_v) {
         if (e && ((pc ^ ea) & 0xff00)) ++m_cycles;
         pc = (uint16_t)ea;
-        m_cycles += 3;
+        ++m_cycles;
+        EMU816_COVER();
     }
-    else
-        m_cycles += 2;
 }
 
 void emu816::op_clc(emu816_addr_t ea)
 {
 
     setc(0);
-    m_cycles += 2;
 }
 
 void emu816::op_cld(emu816_addr_t ea)
 {
 
     setd(0);
-    m_cycles += 2;
 }
 
 void emu816::op_cli(emu816_addr_t ea)
 {
 
     seti(0);
-    m_cycles += 2;
 }
 
 void emu816::op_clv(emu816_addr_t ea)
 {
 
     setv(0);
-    m_cycles += 2;
 }
 
-void emu816::op_cmp(emu816_addr_t ea)
+template <typename T> void emu816::op_cmp(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
+    uint32_t temp = reg<T>(a) - data;
 
-    if (e || p.f_m) {
-        uint8_t	data = load8(ea);
-        uint16_t	temp = a.b - data;
-
-        setc(temp & 0x100);
-        setnz_b(lo(temp));
-        m_cycles += 2;
-    }
-    else {
-        uint16_t	data = load16(ea);
-        emu816_addr_t	temp = a.w - data;
-
-        setc(temp & 0x10000L);
-        setnz_w((uint16_t)temp);
-        m_cycles += 3;
-    }
+    setc(temp & (msb<T>() << 1));
+    setnz<T>((T)temp);
 }
 
 void emu816::op_cop(emu816_addr_t ea)
 {
 
-    if (e) {
-        pushWord(pc);
-        pushByte(p.b);
-
-        p.f_i = 1;
-        p.f_d = 0;
-        pbr = 0;
-
-        pc = load16(0xfff4);
-        // fprintf(stderr,"0xfff4=%04X\n",pc);
-
-        m_cycles += 7;
-    }
-    else {
-        pushByte(pbr);
-        pushWord(pc);
-        pushByte(p.b);
-
-        p.f_i = 1;
-        p.f_d = 0;
-        pbr = 0;
-
-        pc = load16(0xffe4);
-        // fprintf(stderr,"0xffe4=%04X\n",pc);
-
-        m_cycles += 8;
-    }
+    enter_vector(get_p(), 0xfff4, 0xffe4);
 }
 
-void emu816::op_cpx(emu816_addr_t ea)
+template <typename T> void emu816::op_cpx(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
+    uint32_t temp = reg<T>(x) - data;
 
-    if (e || p.f_x) {
-        uint8_t	data = load8(ea);
-        uint16_t	temp = x.b - data;
-
-        setc(temp & 0x100);
-        setnz_b(lo(temp));
-        m_cycles += 2;
-    }
-    else {
-        uint16_t	data = load16(ea);
-        emu816_addr_t	temp = x.w - data;
-
-        setc(temp & 0x10000);
-        setnz_w((uint16_t) temp);
-        m_cycles += 3;
-    }
+    setc(temp & (msb<T>() << 1));
+    setnz<T>((T)temp);
 }
 
-void emu816::op_cpy(emu816_addr_t ea)
+template <typename T> void emu816::op_cpy(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
+    uint32_t temp = reg<T>(y) - data;
 
-    if (e || p.f_x) {
-        uint8_t	data = load8(ea);
-        uint16_t	temp = y.b - data;
-
-        setc(temp & 0x100);
-        setnz_b(lo(temp));
-        m_cycles += 2;
-    }
-    else {
-        uint16_t	data = load16(ea);
-        emu816_addr_t	temp = y.w - data;
-
-        setc(temp & 0x10000);
-        setnz_w((uint16_t) temp);
-        m_cycles += 3;
-    }
+    setc(temp & (msb<T>() << 1));
+    setnz<T>((T)temp);
 }
 
-void emu816::op_dec(emu816_addr_t ea)
+template <typename T> void emu816::op_dec(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
 
-    if (e || p.f_m) {
-        uint8_t data = load8(ea);
-
-        store8(ea, --data);
-        setnz_b(data);
-        m_cycles += 4;
-    }
-    else {
-        uint16_t data = load16(ea);
-
-        store16(ea, --data);
-        setnz_w(data);
-        m_cycles += 5;
-    }
+    store<T>(ea, --data);
+    setnz<T>(data);
 }
 
-void emu816::op_deca(emu816_addr_t ea)
+template <typename T> void emu816::op_deca(emu816_addr_t ea)
 {
-
-    if (e || p.f_m)
-        setnz_b(--a.b);
-    else
-        setnz_w(--a.w);
-
-    m_cycles += 2;
+    setnz<T>(--reg<T>(a));
 }
 
-void emu816::op_dex(emu816_addr_t ea)
+template <typename T> void emu816::op_dex(emu816_addr_t ea)
 {
-
-    if (e || p.f_x)
-        setnz_b(x.b -= 1);
-    else
-        setnz_w(x.w -= 1);
-
-    m_cycles += 2;
+    setnz<T>(--reg<T>(x));
 }
 
-void emu816::op_dey(emu816_addr_t ea)
+template <typename T> void emu816::op_dey(emu816_addr_t ea)
 {
-
-    if (e || p.f_x)
-        setnz_b(y.b -= 1);
-    else
-        setnz_w(y.w -= 1);
-
-    m_cycles += 2;
+    setnz<T>(--reg<T>(y));
 }
 
-void emu816::op_eor(emu816_addr_t ea)
+template <typename T> void emu816::op_eor(emu816_addr_t ea)
 {
-
-    if (e || p.f_m) {
-        setnz_b(a.b ^= load8(ea));
-        m_cycles += 2;
-    }
-    else {
-        setnz_w(a.w ^= load16(ea));
-        m_cycles += 3;
-    }
+    setnz<T>(reg<T>(a) ^= load<T>(ea));
 }
 
-void emu816::op_inc(emu816_addr_t ea)
+template <typename T> void emu816::op_inc(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
 
-    if (e || p.f_m) {
-        uint8_t data = load8(ea);
-
-        store8(ea, ++data);
-        setnz_b(data);
-        m_cycles += 4;
-    }
-    else {
-        uint16_t data = load16(ea);
-
-        store16(ea, ++data);
-        setnz_w(data);
-        m_cycles += 5;
-    }
+    store<T>(ea, ++data);
+    setnz<T>(data);
 }
 
-void emu816::op_inca(emu816_addr_t ea)
+template <typename T> void emu816::op_inca(emu816_addr_t ea)
 {
-
-    if (e || p.f_m)
-        setnz_b(++a.b);
-    else
-        setnz_w(++a.w);
-
-    m_cycles += 2;
+    setnz<T>(++reg<T>(a));
 }
 
-void emu816::op_inx(emu816_addr_t ea)
+template <typename T> void emu816::op_inx(emu816_addr_t ea)
 {
-
-    if (e || p.f_x)
-        setnz_b(++x.b);
-    else
-        setnz_w(++x.w);
-
-    m_cycles += 2;
+    setnz<T>(++reg<T>(x));
 }
 
-void emu816::op_iny(emu816_addr_t ea)
+template <typename T> void emu816::op_iny(emu816_addr_t ea)
 {
-
-    if (e || p.f_x)
-        setnz_b(++y.b);
-    else
-        setnz_w(++y.w);
-
-    m_cycles += 2;
+    setnz<T>(++reg<T>(y));
 }
 
 void emu816::op_jmp(emu816_addr_t ea)
@@ -1252,7 +2117,7 @@ void emu816::op_jmp(emu816_addr_t ea)
 
     pbr = lo(ea >> 16);
     pc = (uint16_t)ea;
-    m_cycles += 1;
+    EMU816_COVER();
 }
 
 void emu816::op_jsl(emu816_addr_t ea)
@@ -1263,7 +2128,8 @@ void emu816::op_jsl(emu816_addr_t ea)
 
     pbr = lo(ea >> 16);
     pc = (uint16_t)ea;
-    m_cycles += 5;
+    EMU816_COVER();
+    if (m_profile) m_profile->call(join(pbr, pc), sp.w, m_cycles);
 }
 
 void emu816::op_jsr(emu816_addr_t ea)
@@ -1272,395 +2138,243 @@ void emu816::op_jsr(emu816_addr_t ea)
     pushWord(pc - 1);
 
     pc = (uint16_t)ea;
-    m_cycles += 4;
+    EMU816_COVER();
+    if (m_profile) m_profile->call(join(pbr, pc), sp.w, m_cycles);
 }
 
-void emu816::op_lda(emu816_addr_t ea)
+template <typename T> void emu816::op_lda(emu816_addr_t ea)
 {
-
-    if (e || p.f_m) {
-        setnz_b(a.b = load8(ea));
-        m_cycles += 2;
-    }
-    else {
-        setnz_w(a.w = load16(ea));
-        m_cycles += 3;
-    }
+    setnz<T>(reg<T>(a) = load<T>(ea));
 }
 
-void emu816::op_ldx(emu816_addr_t ea)
+template <typename T> void emu816::op_ldx(emu816_addr_t ea)
 {
-
-    if (e || p.f_x) {
-        setnz_b(lo(x.w = load8(ea)));
-        m_cycles += 2;
-    }
-    else {
-        setnz_w(x.w = load16(ea));
-        m_cycles += 3;
-    }
+    x.w = load<T>(ea);
+    setnz<T>((T)x.w);
 }
 
-void emu816::op_ldy(emu816_addr_t ea)
+template <typename T> void emu816::op_ldy(emu816_addr_t ea)
 {
-
-    if (e || p.f_x) {
-        setnz_b(lo(y.w = load8(ea)));
-        m_cycles += 2;
-    }
-    else {
-        setnz_w(y.w = load16(ea));
-        m_cycles += 3;
-    }
+    y.w = load<T>(ea);
+    setnz<T>((T)y.w);
 }
 
-void emu816::op_lsr(emu816_addr_t ea)
+template <typename T> void emu816::op_lsr(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
 
-    if (e || p.f_m) {
-        uint8_t data = load8(ea);
-
-        setc(data & 0x01);
-        setnz_b(data >>= 1);
-        store8(ea, data);
-        m_cycles += 4;
-    }
-    else {
-        uint16_t data = load16(ea);
-
-        setc(data & 0x0001);
-        setnz_w(data >>= 1);
-        store16(ea, data);
-        m_cycles += 5;
-    }
+    setc(data & 0x01);
+    setnz<T>(data >>= 1);
+    store<T>(ea, data);
 }
 
-void emu816::op_lsra(emu816_addr_t ea)
+template <typename T> void emu816::op_lsra(emu816_addr_t ea)
 {
-
-    if (e || p.f_m) {
-        setc(a.b & 0x01);
-        setnz_b(a.b >>= 1);
-        store8(ea, a.b);
-    }
-    else {
-        setc(a.w & 0x0001);
-        setnz_w(a.w >>= 1);
-        store16(ea, a.w);
-    }
-    m_cycles += 2;
+    setc(reg<T>(a) & 0x01);
+    setnz<T>(reg<T>(a) >>= 1);
 }
 
 void emu816::op_mvn(emu816_addr_t ea)
 {
 
-    uint8_t src = load8(ea + 1);
-    uint8_t dst = load8(ea + 0);
+    uint8_t src = read8(ea + 1);
+    uint8_t dst = read8(ea + 0);
+    emu816_addr_t from = join(src, x.w++);
+    emu816_addr_t to = join(dbr = dst, y.w++);
 
-    store8(join(dbr = dst, y.w++), load8(join(src, x.w++)));
-    if (--a.w != 0xffff) pc -= 3;
-    m_cycles += 7;
+    watch_load(from, 1);
+    watch_store(to, 1);
+    write8(to, read8(from));
+    if (--a.w != 0xffff) {
+        pc -= 3;
+        move_block(src, dst, 1);
+    }
 }
 
 void emu816::op_mvp(emu816_addr_t ea)
 {
 
-    uint8_t src = load8(ea + 1);
-    uint8_t dst = load8(ea + 0);
+    uint8_t src = read8(ea + 1);
+    uint8_t dst = read8(ea + 0);
+    emu816_addr_t from = join(src, x.w--);
+    emu816_addr_t to = join(dbr = dst, y.w--);
 
-    store8(join(dbr = dst, y.w--), load8(join(src, x.w--)));
-    if (--a.w != 0xffff) pc -= 3;
-    m_cycles += 7;
+    watch_load(from, 1);
+    watch_store(to, 1);
+    write8(to, read8(from));
+    if (--a.w != 0xffff) {
+        pc -= 3;
+        move_block(src, dst, -1);
+    }
 }
 
 void emu816::op_nop(emu816_addr_t ea)
 {
-
-    m_cycles += 2;
 }
 
-void emu816::op_ora(emu816_addr_t ea)
+template <typename T> void emu816::op_ora(emu816_addr_t ea)
 {
-
-    if (e || p.f_m) {
-        setnz_b(a.b |= load8(ea));
-        m_cycles += 2;
-    }
-    else {
-        setnz_w(a.w |= load16(ea));
-        m_cycles += 3;
-    }
+    setnz<T>(reg<T>(a) |= load<T>(ea));
 }
 
 void emu816::op_pea(emu816_addr_t ea)
 {
 
-    pushWord(load16(ea));
-    m_cycles += 5;
+    pushWord(read16(ea));
 }
 
 void emu816::op_pei(emu816_addr_t ea)
 {
 
-    pushWord(load16(ea));
-    m_cycles += 6;
+    pushWord(read16(ea));
 }
 
 void emu816::op_per(emu816_addr_t ea)
 {
 
     pushWord((uint16_t) ea);
-    m_cycles += 6;
 }
 
-void emu816::op_pha(emu816_addr_t ea)
+template <typename T> void emu816::op_pha(emu816_addr_t ea)
 {
-
-    if (e || p.f_m) {
-        pushByte(a.b);
-        m_cycles += 3;
-    }
-    else {
-        pushWord(a.w);
-        m_cycles += 4;
-    }
+    push<T>(reg<T>(a));
 }
 
 void emu816::op_phb(emu816_addr_t ea)
 {
 
     pushByte(dbr);
-    m_cycles += 3;
 }
 
 void emu816::op_phd(emu816_addr_t ea)
 {
 
     pushWord(dp.w);
-    m_cycles += 4;
 }
 
 void emu816::op_phk(emu816_addr_t ea)
 {
 
     pushByte(pbr);
-    m_cycles += 3;
 }
 
 void emu816::op_php(emu816_addr_t ea)
 {
 
-    pushByte(p.b);
-    m_cycles += 3;
+    pushByte(get_p());
 }
 
-void emu816::op_phx(emu816_addr_t ea)
+template <typename T> void emu816::op_phx(emu816_addr_t ea)
 {
-
-    if (e || p.f_x) {
-        pushByte(x.b);
-        m_cycles += 3;
-    }
-    else {
-        pushWord(x.w);
-        m_cycles += 4;
-    }
+    push<T>(reg<T>(x));
 }
 
-void emu816::op_phy(emu816_addr_t ea)
+template <typename T> void emu816::op_phy(emu816_addr_t ea)
 {
-
-    if (e || p.f_x) {
-        pushByte(y.b);
-        m_cycles += 3;
-    }
-    else {
-        pushWord(y.w);
-        m_cycles += 4;
-    }
+    push<T>(reg<T>(y));
 }
 
-void emu816::op_pla(emu816_addr_t ea)
+template <typename T> void emu816::op_pla(emu816_addr_t ea)
 {
-
-    if (e || p.f_m) {
-        setnz_b(a.b = pullByte());
-        m_cycles += 4;
-    }
-    else {
-        setnz_w(a.w = pullWord());
-        m_cycles += 5;
-    }
+    setnz<T>(reg<T>(a) = pull<T>());
 }
 
 void emu816::op_plb(emu816_addr_t ea)
 {
 
     setnz_b(dbr = pullByte());
-    m_cycles += 4;
 }
 
 void emu816::op_pld(emu816_addr_t ea)
 {
 
     setnz_w(dp.w = pullWord());
-    m_cycles += 5;
 }
 
 void emu816::op_plk(emu816_addr_t ea)
 {
 
     setnz_b(dbr = pullByte());
-    m_cycles += 4;
 }
 
 void emu816::op_plp(emu816_addr_t ea)
 {
 
     if (e)
-        p.b = pullByte() | 0x30;
+        set_p(pullByte() | 0x30);
     else {
-        p.b = pullByte();
+        set_p(pullByte());
 
         if (p.f_x) {
             x.w = x.b;
             y.w = y.b;
         }
     }
-    m_cycles += 4;
 }
 
-void emu816::op_plx(emu816_addr_t ea)
+template <typename T> void emu816::op_plx(emu816_addr_t ea)
 {
-
-    if (e || p.f_x) {
-        setnz_b(lo(x.w = pullByte()));
-        m_cycles += 4;
-    }
-    else {
-        setnz_w(x.w = pullWord());
-        m_cycles += 5;
-    }
+    x.w = pull<T>();
+    setnz<T>((T)x.w);
 }
 
-void emu816::op_ply(emu816_addr_t ea)
+template <typename T> void emu816::op_ply(emu816_addr_t ea)
 {
-
-    if (e || p.f_x) {
-        setnz_b(lo(y.w = pullByte()));
-        m_cycles += 4;
-    }
-    else {
-        setnz_w(y.w = pullWord());
-        m_cycles += 5;
-    }
+    y.w = pull<T>();
+    setnz<T>((T)y.w);
 }
 
 void emu816::op_rep(emu816_addr_t ea)
 {
 
-    p.b &= ~load8(ea);
+    set_p(get_p() & ~read8(ea));
     if (e) p.f_m = p.f_x = 1;
-    m_cycles += 3;
 }
 
-void emu816::op_rol(emu816_addr_t ea)
+template <typename T> void emu816::op_rol(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
+    T       carry = m_c ? 0x01 : 0x00;
 
-    if (e || p.f_m) {
-        uint8_t data = load8(ea);
-        uint8_t carry = p.f_c ? 0x01 : 0x00;
-
-        setc(data & 0x80);
-        setnz_b(data = (data << 1) | carry);
-        store8(ea, data);
-        m_cycles += 4;
-    }
-    else {
-        uint16_t data = load16(ea);
-        uint16_t carry = p.f_c ? 0x0001 : 0x0000;
-
-        setc(data & 0x8000);
-        setnz_w(data = (data << 1) | carry);
-        store16(ea, data);
-        m_cycles += 5;
-    }
+    setc(data & msb<T>());
+    setnz<T>(data = (data << 1) | carry);
+    store<T>(ea, data);
 }
 
-void emu816::op_rola(emu816_addr_t ea)
+template <typename T> void emu816::op_rola(emu816_addr_t ea)
 {
+    T       carry = m_c ? 0x01 : 0x00;
 
-    if (e || p.f_m) {
-        uint8_t carry = p.f_c ? 0x01 : 0x00;
-
-        setc(a.b & 0x80);
-        setnz_b(a.b = (a.b << 1) | carry);
-    }
-    else {
-        uint16_t carry = p.f_c ? 0x0001 : 0x0000;
-
-        setc(a.w & 0x8000);
-        setnz_w(a.w = (a.w << 1) | carry);
-    }
-    m_cycles += 2;
+    setc(reg<T>(a) & msb<T>());
+    setnz<T>(reg<T>(a) = (reg<T>(a) << 1) | carry);
 }
 
-void emu816::op_ror(emu816_addr_t ea)
+template <typename T> void emu816::op_ror(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
+    T       carry = m_c ? msb<T>() : 0x00;
 
-    if (e || p.f_m) {
-        uint8_t data = load8(ea);
-        uint8_t carry = p.f_c ? 0x80 : 0x00;
-
-        setc(data & 0x01);
-        setnz_b(data = (data >> 1) | carry);
-        store8(ea, data);
-        m_cycles += 4;
-    }
-    else {
-        uint16_t data = load16(ea);
-        uint16_t carry = p.f_c ? 0x8000 : 0x0000;
-
-        setc(data & 0x0001);
-        setnz_w(data = (data >> 1) | carry);
-        store16(ea, data);
-        m_cycles += 5;
-    }
+    setc(data & 0x01);
+    setnz<T>(data = (data >> 1) | carry);
+    store<T>(ea, data);
 }
 
-void emu816::op_rora(emu816_addr_t ea)
+template <typename T> void emu816::op_rora(emu816_addr_t ea)
 {
+    T       carry = m_c ? msb<T>() : 0x00;
 
-    if (e || p.f_m) {
-        uint8_t carry = p.f_c ? 0x80 : 0x00;
-
-        setc(a.b & 0x01);
-        setnz_b(a.b = (a.b >> 1) | carry);
-    }
-    else {
-        uint16_t carry = p.f_c ? 0x8000 : 0x0000;
-
-        setc(a.w & 0x0001);
-        setnz_w(a.w = (a.w >> 1) | carry);
-    }
-    m_cycles += 2;
+    setc(reg<T>(a) & 0x01);
+    setnz<T>(reg<T>(a) = (reg<T>(a) >> 1) | carry);
 }
 
 void emu816::op_rti(emu816_addr_t ea)
 {
 
-    if (e) {
-        p.b = pullByte();
-        pc = pullWord();
-        m_cycles += 6;
-    }
-    else {
-        p.b = pullByte();
-        pc = pullWord();
-        pbr = pullByte();
-        m_cycles += 7;
-    }
-    p.f_i = 0;
+    set_p(pullByte());
+    pc = pullWord();
+    if (!e) pbr = pullByte();
+    EMU816_COVER();
+    if (m_profile) m_profile->leave(sp.w, m_cycles);
 }
 
 void emu816::op_rtl(emu816_addr_t ea)
@@ -1668,238 +2382,139 @@ void emu816::op_rtl(emu816_addr_t ea)
 
     pc = pullWord() + 1;
     pbr = pullByte();
-    m_cycles += 6;
+    EMU816_COVER();
+    if (m_profile) m_profile->leave(sp.w, m_cycles);
 }
 
 void emu816::op_rts(emu816_addr_t ea)
 {
 
     pc = pullWord() + 1;
-    m_cycles += 6;
+    EMU816_COVER();
+    if (m_profile) m_profile->leave(sp.w, m_cycles);
 }
 
-void emu816::op_sbc(emu816_addr_t ea)
+template <typename T> void emu816::op_sbc(emu816_addr_t ea)
 {
+    T       data = ~load<T>(ea);
+    uint32_t temp = reg<T>(a) + data + m_c;
 
-    if (e || p.f_m) {
-        uint8_t	data = ~load8(ea);
-        uint16_t	temp = a.b + data + p.f_c;
-        
-        if (p.f_d) {
-            if ((temp & 0x0f) > 0x09) temp += 0x06;
-            if ((temp & 0xf0) > 0x90) temp += 0x60;
-        }
-
-        setc(temp & 0x100);
-        setv((~(a.b ^ data)) & (a.b ^ temp) & 0x80);
-        setnz_b(a.b = lo(temp));
-        m_cycles += 2;
+    if (p.f_d) {
+        for (uint32_t shift = 0; shift < 8 * sizeof(T); shift += 4)
+            if ((temp & (0x0f << shift)) > (0x09u << shift)) temp += 0x06 << shift;
     }
-    else {
-        uint16_t	data = ~load16(ea);
-        int		temp = a.w + data + p.f_c;
-
-        if (p.f_d) {
-            if ((temp & 0x000f) > 0x0009) temp += 0x0006;
-            if ((temp & 0x00f0) > 0x0090) temp += 0x0060;
-            if ((temp & 0x0f00) > 0x0900) temp += 0x0600;
-            if ((temp & 0xf000) > 0x9000) temp += 0x6000;
-        }
 
-        setc(temp & 0x10000);
-        setv((~(a.w ^ data)) & (a.w ^ temp) & 0x8000);
-        setnz_w(a.w = (uint16_t)temp);
-        m_cycles += 3;
-    }
+    setc(temp & (msb<T>() << 1));
+    setv((~(reg<T>(a) ^ data)) & (reg<T>(a) ^ temp) & msb<T>());
+    setnz<T>(reg<T>(a) = (T)temp);
 }
 
 void emu816::op_sec(emu816_addr_t ea)
 {
 
     setc(1);
-    m_cycles += 2;
 }
 
 void emu816::op_sed(emu816_addr_t ea)
 {
 
     setd(1);
-    m_cycles += 2;
 }
 
 void emu816::op_sei(emu816_addr_t ea)
 {
 
     seti(1);
-    m_cycles += 2;
 }
 
 void emu816::op_sep(emu816_addr_t ea)
 {
 
-    p.b |= load8(ea);
+    set_p(get_p() | read8(ea));
     if (e) p.f_m = p.f_x = 1;
 
     if (p.f_x) {
         x.w = x.b;
         y.w = y.b;
     }
-    m_cycles += 3;
 }
 
-void emu816::op_sta(emu816_addr_t ea)
+template <typename T> void emu816::op_sta(emu816_addr_t ea)
 {
-
-    if (e || p.f_m) {
-        store8(ea, a.b);
-        m_cycles += 2;
-    }
-    else {
-        store16(ea, a.w);
-        m_cycles += 3;
-    }
+    store<T>(ea, reg<T>(a));
 }
 
 void emu816::op_stp(emu816_addr_t ea)
 {
-
-    pc -= 1;
-    m_cycles += 3;
+    m_idle = EMU816_STOP_STP;
+    halt(EMU816_STOP_STP);
 }
 
-void emu816::op_stx(emu816_addr_t ea)
+template <typename T> void emu816::op_stx(emu816_addr_t ea)
 {
-
-    if (e || p.f_x) {
-        store8(ea, x.b);
-        m_cycles += 2;
-    }
-    else {
-        store16(ea, x.w);
-        m_cycles += 3;
-    }
+    store<T>(ea, reg<T>(x));
 }
 
-void emu816::op_sty(emu816_addr_t ea)
+template <typename T> void emu816::op_sty(emu816_addr_t ea)
 {
-
-    if (e || p.f_x) {
-        store8(ea, y.b);
-        m_cycles += 2;
-    }
-    else {
-        store16(ea, y.w);
-        m_cycles += 3;
-    }
+    store<T>(ea, reg<T>(y));
 }
 
-void emu816::op_stz(emu816_addr_t ea)
+template <typename T> void emu816::op_stz(emu816_addr_t ea)
 {
-
-    if (e || p.f_m) {
-        store8(ea, 0);
-        m_cycles += 2;
-    }
-    else {
-        store16(ea, 0);
-        m_cycles += 3;
-    }
+    store<T>(ea, 0);
 }
 
-void emu816::op_tax(emu816_addr_t ea)
+template <typename T> void emu816::op_tax(emu816_addr_t ea)
 {
-
-    if (e || p.f_x)
-        setnz_b(lo(x.w = a.b));
-    else
-        setnz_w(x.w = a.w);
-
-    m_cycles += 2;
+    x.w = reg<T>(a);
+    setnz<T>((T)x.w);
 }
 
-void emu816::op_tay(emu816_addr_t ea)
+template <typename T> void emu816::op_tay(emu816_addr_t ea)
 {
-
-    if (e || p.f_x)
-        setnz_b(lo(y.w = a.b));
-    else
-        setnz_w(y.w = a.w);
-
-    m_cycles += 2;
+    y.w = reg<T>(a);
+    setnz<T>((T)y.w);
 }
 
 void emu816::op_tcd(emu816_addr_t ea)
 {
 
     dp.w = a.w;
-    m_cycles += 2;
 }
 
-void emu816::op_tdc(emu816_addr_t ea)
+template <typename T> void emu816::op_tdc(emu816_addr_t ea)
 {
-
-    if (e || p.f_m)
-        setnz_b(lo(a.w = dp.w));
-    else
-        setnz_w(a.w = dp.w);
-
-    m_cycles += 2;
+    a.w = dp.w;
+    setnz<T>((T)a.w);
 }
 
 void emu816::op_tcs(emu816_addr_t ea)
 {
 
     sp.w = e ? (0x0100 | a.b) : a.w;
-    m_cycles += 2;
 }
 
-void emu816::op_trb(emu816_addr_t ea)
+template <typename T> void emu816::op_trb(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
 
-    if (e || p.f_m) {
-        uint8_t data = load8(ea);
-
-        store8(ea, data & ~a.b);
-        setz((a.b & data) == 0);
-        m_cycles += 4;
-    }
-    else {
-        uint16_t data = load16(ea);
-
-        store16(ea, data & ~a.w);
-        setz((a.w & data) == 0);
-        m_cycles += 5;
-    }
+    store<T>(ea, data & ~reg<T>(a));
+    setz((reg<T>(a) & data) == 0);
 }
 
-void emu816::op_tsb(emu816_addr_t ea)
+template <typename T> void emu816::op_tsb(emu816_addr_t ea)
 {
+    T       data = load<T>(ea);
 
-    if (e || p.f_m) {
-        uint8_t data = load8(ea);
-
-        store8(ea, data | a.b);
-        setz((a.b & data) == 0);
-        m_cycles += 4;
-    }
-    else {
-        uint16_t data = load16(ea);
-
-        store16(ea, data | a.w);
-        setz((a.w & data) == 0);
-        m_cycles += 5;
-    }
+    store<T>(ea, data | reg<T>(a));
+    setz((reg<T>(a) & data) == 0);
 }
 
-void emu816::op_tsc(emu816_addr_t ea)
+template <typename T> void emu816::op_tsc(emu816_addr_t ea)
 {
-
-    if (e || p.f_m)
-        setnz_b(lo(a.w = sp.w));
-    else
-        setnz_w(a.w = sp.w);
-
-    m_cycles += 2;
+    a.w = sp.w;
+    setnz<T>((T)a.w);
 }
 
 void emu816::op_tsx(emu816_addr_t ea)
@@ -1909,19 +2524,11 @@ void emu816::op_tsx(emu816_addr_t ea)
         setnz_b(x.b = sp.b);
     else
         setnz_w(x.w = sp.w);
-
-    m_cycles += 2;
 }
 
-void emu816::op_txa(emu816_addr_t ea)
+template <typename T> void emu816::op_txa(emu816_addr_t ea)
 {
-
-    if (e || p.f_m)
-        setnz_b(a.b = x.b);
-    else
-        setnz_w(a.w = x.w);
-
-    m_cycles += 2;
+    setnz<T>(reg<T>(a) = reg<T>(x));
 }
 
 void emu816::op_txs(emu816_addr_t ea)
@@ -1931,59 +2538,42 @@ void emu816::op_txs(emu816_addr_t ea)
         sp.w = 0x0100 | x.b;
     else
         sp.w = x.w;
-
-    m_cycles += 2;
 }
 
-void emu816::op_txy(emu816_addr_t ea)
+template <typename T> void emu816::op_txy(emu816_addr_t ea)
 {
-
-    if (e || p.f_x)
-        setnz_b(lo(y.w = x.w));
-    else
-        setnz_w(y.w = x.w);
-
-    m_cycles += 2;
+    y.w = x.w;
+    setnz<T>((T)y.w);
 }
 
-void emu816::op_tya(emu816_addr_t ea)
+template <typename T> void emu816::op_tya(emu816_addr_t ea)
 {
-
-    if (e || p.f_m)
-        setnz_b(a.b = y.b);
-    else
-        setnz_w(a.w = y.w);
-
-    m_cycles += 2;
+    setnz<T>(reg<T>(a) = reg<T>(y));
 }
 
-void emu816::op_tyx(emu816_addr_t ea)
+template <typename T> void emu816::op_tyx(emu816_addr_t ea)
 {
-
-    if (e || p.f_x)
-        setnz_b(lo(x.w = y.w));
-    else
-        setnz_w(x.w = y.w);
-
-    m_cycles += 2;
+    x.w = y.w;
+    setnz<T>((T)x.w);
 }
 
 void emu816::op_wai(emu816_addr_t ea)
 {
-
-    pc -= 1;
-    m_cycles += 3;
+    // Continue at once if an interrupt line is already active
+    if (!m_irq && !m_signals) {
+        m_idle = EMU816_STOP_WAI;
+        halt(EMU816_STOP_WAI);
+    }
 }
 
 void emu816::op_wdm(emu816_addr_t ea)
 {
 
-    switch (load8(ea)) {
+    switch (read8(ea)) {
     // case 0x01:	cout << (char) a.b; break;
     // case 0x02:  cin >> a.b;         break;
-    case 0xff:	m_stopped = true;   break;
+    case 0xff:	halt(EMU816_STOP_WDM);  break;
     }
-    m_cycles += 3;
 }
 
 void emu816::op_xba(emu816_addr_t ea)
@@ -1991,7 +2581,6 @@ void emu816::op_xba(emu816_addr_t ea)
 
     a.w = swap(a.w);
     setnz_b(a.b);
-    m_cycles += 3;
 }
 
 void emu816::op_xce(emu816_addr_t ea)
@@ -1999,12 +2588,37 @@ void emu816::op_xce(emu816_addr_t ea)
 
     uint8_t	oe = e;
 
-    e = p.f_c;
-    p.f_c = oe;
+    e = m_c;
+    m_c = oe;
 
     if (e) {
         p.b |= 0x30;
         sp.w = 0x0100 | sp.b;
     }
-    m_cycles += 2;
-}
\ No newline at end of file
+}
+
+// Select the operand width at run time for the reference switch in step().
+// The threaded engine calls the specialised versions directly.
+#define EMU816_SIZED_M(op) \
+void emu816::op_##op(emu816_addr_t ea) \
+{ \
+    if (e || p.f_m) op_##op<uint8_t>(ea); else op_##op<uint16_t>(ea); \
+}
+#define EMU816_SIZED_X(op) \
+void emu816::op_##op(emu816_addr_t ea) \
+{ \
+    if (e || p.f_x) op_##op<uint8_t>(ea); else op_##op<uint16_t>(ea); \
+}
+
+EMU816_SIZED_M(adc) EMU816_SIZED_M(and) EMU816_SIZED_M(asl) EMU816_SIZED_M(asla) EMU816_SIZED_M(bit) EMU816_SIZED_M(biti)
+EMU816_SIZED_M(cmp) EMU816_SIZED_M(dec) EMU816_SIZED_M(deca) EMU816_SIZED_M(eor) EMU816_SIZED_M(inc) EMU816_SIZED_M(inca)
+EMU816_SIZED_M(lda) EMU816_SIZED_M(lsr) EMU816_SIZED_M(lsra) EMU816_SIZED_M(ora) EMU816_SIZED_M(pha) EMU816_SIZED_M(pla)
+EMU816_SIZED_M(rol) EMU816_SIZED_M(rola) EMU816_SIZED_M(ror) EMU816_SIZED_M(rora) EMU816_SIZED_M(sbc) EMU816_SIZED_M(sta)
+EMU816_SIZED_M(stz) EMU816_SIZED_M(tdc) EMU816_SIZED_M(trb) EMU816_SIZED_M(tsb) EMU816_SIZED_M(tsc) EMU816_SIZED_M(txa)
+EMU816_SIZED_M(tya)
+EMU816_SIZED_X(cpx) EMU816_SIZED_X(cpy) EMU816_SIZED_X(dex) EMU816_SIZED_X(dey) EMU816_SIZED_X(inx) EMU816_SIZED_X(iny)
+EMU816_SIZED_X(ldx) EMU816_SIZED_X(ldy) EMU816_SIZED_X(phx) EMU816_SIZED_X(phy) EMU816_SIZED_X(plx) EMU816_SIZED_X(ply)
+EMU816_SIZED_X(stx) EMU816_SIZED_X(sty) EMU816_SIZED_X(tax) EMU816_SIZED_X(tay) EMU816_SIZED_X(txy) EMU816_SIZED_X(tyx)
+
+#undef EMU816_SIZED_X
+#undef EMU816_SIZED_M
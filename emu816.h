@@ -24,15 +24,128 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <emu816_config.h>
+#include <emu816_profile.h>
+
+// Instruction tracing is compiled in when emu816_config.h defines
+// EMU816_TRACE (see the TRACE option in the Makefile), and changes the
+// layout of the class.
+#if defined(EMU816_TRACE)
+#include <emu816_trace.h>
+#endif
+
+// Edge coverage is likewise compiled in when EMU816_COVERAGE is defined
+// there (see the COVERAGE option). Maps are this many bytes unless given a size.
+#define EMU816_COVERAGE_SIZE    (1 << 16)
 
 #define EMU816_INVALID_PC   0xFFFFFFFF
 
+// The 16M address space is tracked in pages of this many bits
+#define EMU816_PAGE_BITS    12
+#define EMU816_PAGE_SIZE    (1 << EMU816_PAGE_BITS)
+#define EMU816_PAGES        (1 << (24 - EMU816_PAGE_BITS))
+
+// Access permitted by map_memory(). Accesses that a page does not permit,
+// and all accesses to MMIO pages, use the virtual load and store functions.
+#define EMU816_MAP_READ     0x01
+#define EMU816_MAP_WRITE    0x02
+#define EMU816_MAP_RAM      (EMU816_MAP_READ | EMU816_MAP_WRITE)
+#define EMU816_MAP_ROM      EMU816_MAP_READ
+#define EMU816_MAP_MMIO     0x00
+
+// Kinds of breakpoint: executing the instruction at an address, or loading
+// or storing the byte there
+#define EMU816_BREAK_EXEC   0x01
+#define EMU816_BREAK_LOAD   0x02
+#define EMU816_BREAK_STORE  0x04
+
+// No instruction takes more than this many cycles
+#define EMU816_MAX_CYCLES   16
+
+// Size of the decoded block cache (in blocks) and the longest block
+#define EMU816_BLOCK_CACHE  1024
+#define EMU816_BLOCK_LENGTH 32
+
+// The dynamic recompiler is available on x86-64 hosts. A block is compiled
+// after it has been executed this many times.
+#if defined(__x86_64__) && !defined(EMU816_NO_JIT)
+#define EMU816_JIT
+#endif
+#define EMU816_JIT_THRESHOLD    16
+#define EMU816_JIT_ARENA        (1024 * 1024)
+
+// The most device events that can be registered at once
+#define EMU816_EVENTS       64
+#define EMU816_NO_EVENT     (-1)
+
+// Version of the snapshot format written by save_state()
+#define EMU816_STATE_VERSION    1
+
+// Checkpoints kept for reverse execution by default, and the cycles
+// between them until the history fills up
+#define EMU816_CHECKPOINTS          64
+#define EMU816_CHECKPOINT_INTERVAL  100000
+
+// Version of the input log written while recording, and the amount of it
+// buffered before it is passed on
+#define EMU816_RECORD_VERSION   1
+#define EMU816_RECORD_BUFFER    (64 * 1024)
+
 typedef uint32_t	    emu816_addr_t;
 typedef uint8_t         emu816_bit_t;
 
+// The instruction dispatch engines. The switch in step() is the reference
+// implementation and is always available. The threaded engine uses computed
+// goto handler tables and is only compiled when EMU816_THREADED is defined
+// (see the DISPATCH option in the Makefile).
+typedef enum {
+    EMU816_ENGINE_SWITCH=0,
+    EMU816_ENGINE_THREADED
+} emu816_engine_t;
+
+#if defined(EMU816_THREADED)
+#define EMU816_DEFAULT_ENGINE   EMU816_ENGINE_THREADED
+#else
+#define EMU816_DEFAULT_ENGINE   EMU816_ENGINE_SWITCH
+#endif
+
+// Why run_for() returned
+typedef enum {
+    EMU816_STOP_NONE,
+    EMU816_STOP_BUDGET,                     // the cycle budget was used up
+    EMU816_STOP_STP,                        // STP was executed
+    EMU816_STOP_WAI,                        // WAI is waiting for an interrupt
+    EMU816_STOP_WDM,                        // WDM #$FF was executed
+    EMU816_STOP_BREAKPOINT,                 // a breakpoint was hit
+    EMU816_STOP_HOST,                       // stop() or request_stop()
+    EMU816_STOP_REPLAY                      // the replayed log ended or diverged
+} emu816_stop_t;
+
+// Counters kept by the dynamic recompiler
+typedef struct {
+    uint64_t                compiled;       // blocks translated
+    uint64_t                executed;       // native block executions
+    uint64_t                invalidated;    // translations discarded by stores
+} emu816_jit_stats_t;
+
+// A device event. The callback is given the cycle it was scheduled for,
+// which may be slightly earlier than cycles() as instructions are not split.
+typedef int             emu816_event_t;
+typedef void            (*emu816_event_fn)(void *context, uint64_t deadline);
+
+// Where a recorded input log is written, and where a replayed one is read
+// from. The source returns the number of bytes it filled, zero at the end.
+typedef void            (*emu816_sink_fn)(void *context, const uint8_t *data, size_t size);
+typedef size_t          (*emu816_source_fn)(void *context, uint8_t *data, size_t size);
+
 // Defines the WDC 65C816 emulator. 
 class emu816 
 {
+    friend class emu816_lockstep;
+
     public:
 
         emu816();
@@ -43,9 +156,165 @@ class emu816
         virtual void            run(uint32_t cycles=0);
         virtual void            stop();
 
-        uint32_t                cycles();
+        emu816_stop_t           run_for(uint64_t cycles=0);
+        void                    request_stop();
+
+        // Interrupt inputs. IRQ is level sensitive and asserted while any
+        // of up to 32 sources (numbered 0 to 31) holds it. NMI and ABORT are
+        // taken once per call. Any of them wakes the processor from WAI.
+        void                    assert_irq(uint32_t source);
+        void                    release_irq(uint32_t source);
+        void                    raise_nmi();
+        void                    raise_abort();
+
+        // Device events keyed on the cycle count. Events are registered
+        // once and may then be scheduled, moved and cancelled as often as
+        // needed. These may only be called from the thread running the
+        // processor, including from event callbacks and load or store
+        // handlers.
+        emu816_event_t          add_event(emu816_event_fn fn, void *context);
+        void                    remove_event(emu816_event_t event);
+        void                    schedule(emu816_event_t event, uint64_t deadline);
+        void                    cancel(emu816_event_t event);
+        bool                    scheduled(emu816_event_t event);
+        emu816_stop_t           stop_reason() { return m_stop_reason; }
+
+        uint64_t                cycles();
         bool                    stopped();
 
+        // The status register. N, V, Z and C are held apart from p and only
+        // combined with it when read.
+        uint8_t                 get_p()
+                                    { return ((p.b & 0x3c) | (m_n & 0x80) | (m_v << 6)
+                                                | (m_z ? 0x00 : 0x02) | m_c); }
+        void                    set_p(uint8_t value)
+                                    { p.b = value; m_n = value; m_v = (value >> 6) & 1;
+                                      m_z = (value & 0x02) ? 0 : 1; m_c = value & 1;
+                                      update_interrupts(); }
+
+        bool                    set_engine(emu816_engine_t engine);
+        emu816_engine_t         engine() { return m_engine; }
+
+        void                    enable_block_cache(bool enable);
+        void                    invalidate_code(emu816_addr_t ea, uint32_t size);
+
+        void                    map_memory(emu816_addr_t base, uint32_t size,
+                                    uint8_t *host, uint32_t flags);
+
+        bool                    enable_jit(bool enable);
+        const emu816_jit_stats_t &jit_stats() { return m_jit_stats; }
+
+        // Charge the cycles spent to the routines running in a profile, or
+        // stop profiling with NULL. Calls and returns are not translated
+        // while profiling and the lockstep engine is not profiled. May not
+        // be called while the processor runs.
+        void                    set_profile(emu816_profile *profile);
+
+        // Breakpoints and watchpoints, which stop run_for() with
+        // EMU816_STOP_BREAKPOINT. An execution breakpoint stops before the
+        // instruction at its address, which is executed when the processor
+        // runs on. A load or store watchpoint stops after an instruction
+        // that accesses the byte as data, which excludes code fetches and
+        // the stack. Only accesses to pages holding any are looked up, and
+        // none stop the processor while it goes back in time. None may be
+        // called while the processor runs.
+        void                    set_breakpoint(emu816_addr_t ea, uint32_t kinds);
+        void                    clear_breakpoint(emu816_addr_t ea, uint32_t kinds);
+        void                    clear_breakpoints();
+        emu816_addr_t           break_address() { return (m_break_at); }
+        uint32_t                break_kind() { return (m_break_kind); }
+
+#if defined(EMU816_TRACE)
+        // Write a record of every instruction executed to a trace ring, or
+        // stop tracing with NULL. Translated code is not run while tracing
+        // and the lockstep engine is not traced. May not be called while
+        // the processor runs.
+        void                    set_trace(emu816_trace *trace);
+#endif
+
+#if defined(EMU816_COVERAGE)
+        // Count the edges between the destinations of control transfers
+        // (taken branches, jumps, calls, returns and interrupts) in an
+        // AFL-style map, or stop counting with NULL. The size must be a power
+        // of two. attach_coverage() uses the System V shared memory segment
+        // named by __AFL_SHM_ID, so a fuzzer reads the map directly, and
+        // clear_coverage() starts afresh for the next input. May not be
+        // called while the processor runs.
+        bool                    set_coverage(uint8_t *map, uint32_t size);
+        bool                    attach_coverage(uint32_t size=EMU816_COVERAGE_SIZE);
+        void                    clear_coverage();
+#endif
+
+        // Snapshots of the registers, interrupt inputs, event schedule and
+        // all memory mapped writable. Read-only pages and memory behind the
+        // load and store functions are left out, but devices may add their
+        // own state (see save_devices()). A snapshot can be loaded into any
+        // processor with the same events registered and the same pages
+        // mapped writable. Neither may be called while the processor runs.
+        void                    save_state(std::vector<uint8_t> &state);
+        bool                    load_state(const uint8_t *state, size_t size);
+        bool                    load_state(const std::vector<uint8_t> &state)
+                                    { return (load_state(state.data(), state.size())); }
+
+        // Make this processor a copy-on-write fork of a parent of the same
+        // class with the same events registered. It takes the parent's
+        // registers, events, devices and memory map, and reads the parent's
+        // writable pages in place until it first writes to each of them.
+        // The parent must not run or change its memory while its forks are
+        // in use. Returns false if the parent's events or devices do not
+        // fit this processor.
+        bool                    fork_from(emu816 &parent);
+
+        // A baseline to return to cheaply, e.g. between test runs. Stores
+        // to writable pages are tracked from set_baseline() and only the
+        // pages written are restored by reset_to_baseline(), along with
+        // the registers, events and device state. The memory map must not
+        // change in between.
+        void                    set_baseline();
+        bool                    reset_to_baseline();
+        const std::vector<uint32_t> &dirty_pages() { return m_dirty; }
+
+        // Reverse execution. While history is enabled a snapshot is taken
+        // at regular intervals, and when the given number have been kept
+        // every other one is dropped and the interval doubled. step_back()
+        // and run_back_to() go back to an earlier instruction boundary by
+        // restoring the checkpoint before it and running forward, so any
+        // device must be deterministic and keep its state in snapshots.
+        // Changes the host makes between runs are not seen again unless
+        // checkpoint() is called after them. Both return false, leaving the
+        // processor as it was, if the history does not reach back far
+        // enough. None may be called while the processor runs.
+        bool                    enable_history(size_t checkpoints=EMU816_CHECKPOINTS,
+                                    uint64_t interval=EMU816_CHECKPOINT_INTERVAL);
+        void                    disable_history();
+        void                    checkpoint();
+        bool                    step_back();
+        bool                    run_back_to(emu816_addr_t ea);
+
+        // Deterministic record and replay of external input. A recording
+        // logs every value returned by the load functions and every change
+        // to the interrupt inputs with its cycle count, and passes the log
+        // to the sink in large buffered chunks. A replay answers the loads
+        // from the log in place of the devices and changes the interrupt
+        // inputs at the same instruction boundaries, ignoring those made by
+        // the host, and uses one event while it runs. Both should start from
+        // the same state, e.g. a snapshot, and drive the processor through
+        // run_for(). When the log ends or no longer matches the program,
+        // run_for() returns EMU816_STOP_REPLAY and the load functions are
+        // used again. None may be called while the processor runs.
+        void                    start_recording(emu816_sink_fn fn, void *context);
+        void                    flush_recording();
+        void                    stop_recording();
+        bool                    start_replay(emu816_source_fn fn, void *context);
+        void                    stop_replay();
+        bool                    recording() { return (m_inputs == INPUT_RECORD); }
+        bool                    replaying() { return (m_inputs == INPUT_REPLAY); }
+        bool                    replay_diverged() { return (m_diverged); }
+
+        // Memory as the processor sees it, for the host to inspect or patch
+        uint8_t                 peek(emu816_addr_t ea) { return (read8(ea)); }
+        void                    poke(emu816_addr_t ea, uint8_t data) { write8(ea, data); }
+
         virtual uint8_t         load8(emu816_addr_t ea) = 0;
         virtual void            store8(emu816_addr_t ea, uint8_t data) = 0;
 
@@ -56,20 +325,6 @@ class emu816
 
     protected:
 
-        union FLAGS {
-            struct {
-                emu816_bit_t				f_c : 1;
-                emu816_bit_t				f_z : 1;
-                emu816_bit_t				f_i : 1;
-                emu816_bit_t				f_d : 1;
-                emu816_bit_t				f_x : 1;
-                emu816_bit_t				f_m : 1;
-                emu816_bit_t				f_v : 1;
-                emu816_bit_t				f_n : 1;
-            };
-            uint8_t			b;
-        }   p;
-
         emu816_bit_t		e;
 
         union REGS {
@@ -90,22 +345,372 @@ class emu816
         virtual void            set_stopped(bool stopped)
                                     { m_stopped = stopped; }
 
+        // Device state kept in snapshots. save_devices() appends to the
+        // snapshot and load_devices() is given back the same bytes before
+        // any processor state is replaced, returning false to reject them.
+        virtual void            save_devices(std::vector<uint8_t> &)
+                                    { }
+        virtual bool            load_devices(const uint8_t *, size_t)
+                                    { return (true); }
+
+        // Traps for BRK and COP may be implemented by overriding these,
+        // reading and changing the flags through get_p() and set_p().
         virtual void op_brk(emu816_addr_t ea);
         virtual void op_cop(emu816_addr_t ea);
         virtual void op_rti(emu816_addr_t ea);
 
    private:
 
+        // A predecoded instruction and a run of them ending at the first
+        // transfer of control or mode change. Blocks never cross a page.
+        struct INSN {
+            const void *        handler;
+            uint32_t            operand;
+            uint8_t             opcode;
+            uint8_t             length;
+        };
+
+        struct BLOCK {
+            emu816_addr_t       start;
+            uint32_t            gen;
+            uint8_t             mode;
+            uint8_t             count;
+            uint16_t            hits;
+            uint32_t            max_cycles;
+            uint32_t            native_cycles;
+            void                (*native)(emu816 *cpu);
+            INSN                insn[EMU816_BLOCK_LENGTH];
+        };
+
+        struct JIT;
+
         inline void             addPC(uint32_t count) {pc+=count;}
 
+        // The status register. Only its I, D, X and M bits are current, so
+        // it is private and subclasses use get_p() and set_p() instead.
+        union FLAGS {
+            struct {
+                emu816_bit_t				f_c : 1;
+                emu816_bit_t				f_z : 1;
+                emu816_bit_t				f_i : 1;
+                emu816_bit_t				f_d : 1;
+                emu816_bit_t				f_x : 1;
+                emu816_bit_t				f_m : 1;
+                emu816_bit_t				f_v : 1;
+                emu816_bit_t				f_n : 1;
+            };
+            uint8_t			b;
+        }   p;
+
+        // Lazily evaluated flags. N is bit 7 of m_n and Z is set if m_z
+        // is zero. C and V are 0 or 1.
+        uint16_t                m_z;
+        uint8_t                 m_n;
+        uint8_t                 m_c;
+        uint8_t                 m_v;
+
         bool		            m_stopped;
-        uint32_t                m_cycles;
+        uint64_t                m_cycles;
+        std::atomic<uint64_t>   m_horizon;
+        std::atomic<bool>       m_host_stop;
+        emu816_stop_t           m_stop_reason;
+        emu816_stop_t           m_idle;         // after WAI or STP
+
+        // Interrupt state. m_interrupt is non-zero when an interrupt can
+        // be taken before the next instruction.
+        enum { INT_IRQ = 1, INT_NMI = 2, INT_ABORT = 4 };
+        uint32_t                m_irq;          // sources asserting IRQ
+        uint8_t                 m_signals;      // NMI and ABORT raised
+        uint8_t                 m_interrupt;
+
+        // Device events. Scheduled events are kept in a binary min-heap
+        // of indices into m_events ordered by deadline, and each event
+        // records its position in the heap so that it can be moved or
+        // removed without a search.
+        struct EVENT {
+            emu816_event_fn     fn;
+            void *              context;
+            uint64_t            deadline;
+            int                 heap;           // -1 when not scheduled
+        };
+
+        EVENT                   m_events[EMU816_EVENTS];
+        int                     m_heap[EMU816_EVENTS];
+        int                     m_scheduled;
+
+        // The registers, interrupt inputs and event schedule, as kept by
+        // snapshots, forks and baselines. Events are in heap order.
+        struct CORE {
+            uint16_t            a, x, y, sp, dp, pc;
+            uint8_t             pbr, dbr, e, p;
+            uint64_t            cycles;
+            bool                stopped;
+            emu816_stop_t       stop_reason;
+            emu816_stop_t       idle;
+            uint8_t             signals;
+            uint32_t            irq;
+            int                 scheduled;
+            uint8_t             heap[EMU816_EVENTS];
+            uint64_t            deadline[EMU816_EVENTS];
+        };
+
+        // The baseline and the pages written since, with their contents
+        // at the baseline in the same order
+        CORE                    m_baseline;
+        bool                    m_has_baseline;
+        std::vector<uint8_t>    m_baseline_devices;
+        std::vector<uint32_t>   m_dirty;
+        std::vector<uint8_t *>  m_originals;
+
+        // Snapshots kept for reverse execution, oldest first
+        struct CHECKPOINT {
+            uint64_t                cycles;
+            std::vector<uint8_t>    state;
+        };
+
+        std::vector<CHECKPOINT> m_checkpoints;
+        size_t                  m_max_checkpoints;
+        uint64_t                m_interval;
+        emu816_event_t          m_history;
+        bool                    m_travelling;   // running forward to a point in the past
+
+        static void             checkpoint_event(void *context, uint64_t deadline);
+        bool                    go_back(emu816_addr_t ea);
+        bool                    advance(uint64_t limit);
+        bool                    find_back(emu816_addr_t ea, uint64_t &found);
+        void                    travel_to(uint64_t cycles);
+
+        emu816_engine_t         m_engine;
+
+        BLOCK *                 m_blocks;
+        JIT *                   m_jit;
+        emu816_jit_stats_t      m_jit_stats;
+        const INSN *            m_insn;
+        bool                    m_exit_block;   // code written or interrupt pending
+        bool                    m_cross;        // index page crossings cost a cycle
+        uint32_t                m_code_gen[EMU816_PAGES];
+
+        // Pages whose first store needs attention: those holding decoded
+        // code, and those whose baseline contents have not been kept yet.
+        // Pages holding breakpoints of each kind are also flagged.
+        enum { WATCH_CODE = 1, WATCH_BASELINE = 2, WATCH_EXEC = 4, WATCH_LOAD = 8, WATCH_STORE = 16 };
+        uint8_t                 m_watch[EMU816_PAGES];
+        uint8_t *               m_read[EMU816_PAGES];
+        uint8_t *               m_write[EMU816_PAGES];
+
+        static uint32_t         page(emu816_addr_t ea)
+                                    { return ((ea >> EMU816_PAGE_BITS) & (EMU816_PAGES - 1)); }
+        static uint32_t         offset(emu816_addr_t ea)
+                                    { return (ea & (EMU816_PAGE_SIZE - 1)); }
+
+        // Loads made by the processor, which use host memory directly for
+        // mapped pages. Words that straddle an unmapped page are passed to
+        // load16/load24 unless either page is mapped.
+        uint8_t                 read8(emu816_addr_t ea)
+                                    { const uint8_t *host = m_read[page(ea)];
+                                      return (host ? host[offset(ea)] : mmio8(ea)); }
+        uint16_t                read16(emu816_addr_t ea)
+                                    { const uint8_t *host = m_read[page(ea)];
+                                      if (host && offset(ea) < EMU816_PAGE_SIZE - 1)
+                                          return (host[offset(ea)] | (host[offset(ea) + 1] << 8));
+                                      if (!host && !m_read[page(ea + 1)]) return (mmio16(ea));
+                                      return (read8(ea) | (read8(ea + 1) << 8)); }
+        emu816_addr_t           read24(emu816_addr_t ea)
+                                    { const uint8_t *host = m_read[page(ea)];
+                                      if (host && offset(ea) < EMU816_PAGE_SIZE - 2)
+                                          return (host[offset(ea)] | (host[offset(ea) + 1] << 8)
+                                                    | (host[offset(ea) + 2] << 16));
+                                      if (!host && !m_read[page(ea + 2)]) return (mmio24(ea));
+                                      return (read8(ea) | (read8(ea + 1) << 8) | (read8(ea + 2) << 16)); }
+
+        // Loads passed to the load functions, which go through the input log
+        // while recording or replaying
+        enum { INPUT_NONE, INPUT_RECORD, INPUT_REPLAY };
+        struct INPUT;
+
+        // Kinds of input log entry. Loads are numbered by their size.
+        enum { LOG_LOAD8 = 1, LOG_LOAD16, LOG_LOAD24, LOG_ASSERT, LOG_RELEASE,
+               LOG_NMI, LOG_ABORT, LOG_REBASE, LOG_END };
+
+        INPUT *                 m_input;
+        uint8_t                 m_inputs;
+        bool                    m_diverged;
+        bool                    m_in_engine;
+
+        emu816_profile *        m_profile;
+
+        // The kinds of breakpoint at each address, and the last one hit
+        std::unordered_map<emu816_addr_t, uint8_t> m_breakpoints;
+        emu816_addr_t           m_break_at;
+        uint32_t                m_break_kind;
+        emu816_addr_t           m_resume;       // breakpoint to pass when running on
+
+        uint32_t                break_kinds(emu816_addr_t ea);
+        void                    flag_page(uint32_t page);
+        bool                    breakpoint();
+        void                    watched(emu816_addr_t ea, uint32_t size, uint32_t kind);
+
+        // Data accesses to pages holding watchpoints look them up
+        void                    watch_load(emu816_addr_t ea, uint32_t size)
+                                    { if ((m_watch[page(ea)] | m_watch[page(ea + size - 1)]) & WATCH_LOAD)
+                                          watched(ea, size, EMU816_BREAK_LOAD); }
+        void                    watch_store(emu816_addr_t ea, uint32_t size)
+                                    { if ((m_watch[page(ea)] | m_watch[page(ea + size - 1)]) & WATCH_STORE)
+                                          watched(ea, size, EMU816_BREAK_STORE); }
+
+        uint8_t                 mmio8(emu816_addr_t ea)
+                                    { return (m_inputs ? (uint8_t)input(ea, 1) : load8(ea)); }
+        uint16_t                mmio16(emu816_addr_t ea)
+                                    { return (m_inputs ? (uint16_t)input(ea, 2) : load16(ea)); }
+        emu816_addr_t           mmio24(emu816_addr_t ea)
+                                    { return (m_inputs ? input(ea, 3) : load24(ea)); }
+
+        uint32_t                input(emu816_addr_t ea, int size);
+        bool                    input_irq(uint8_t kind, uint32_t source);
+        void                    input_boundary();
+        void                    end_input();
+        void                    finish_replay(bool diverged);
+        void                    replay_due();
+        void                    arm_replay();
+        static void             replay_event(void *context, uint64_t deadline);
+
+        // Operand bytes following the opcode, taken from the decoded block
+        // when one is being executed.
+        uint8_t                 operand8()
+                                    { return (m_insn ? (uint8_t)m_insn->operand : read8(join(pbr, pc))); }
+        uint16_t                operand16()
+                                    { return (m_insn ? (uint16_t)m_insn->operand : read16(join(pbr, pc))); }
+        emu816_addr_t           operand24()
+                                    { return (m_insn ? m_insn->operand : read24(join(pbr, pc))); }
+
+        // Stores made by the processor, which discard any decoded blocks
+        // for the page written and use host memory for mapped pages. A page
+        // shared with the parent of a fork is copied before it is written.
+        void                    write8(emu816_addr_t ea, uint8_t data)
+                                    { uint8_t *host = m_write[page(ea)];
+                                      if (m_watch[page(ea)]) written(page(ea));
+                                      if (!host && m_shared[page(ea)]) host = copy_page(page(ea));
+                                      if (host) host[offset(ea)] = data; else store8(ea, data); }
+        void                    write16(emu816_addr_t ea, uint16_t data)
+                                    { uint8_t *host = m_write[page(ea)];
+                                      if (m_watch[page(ea)]) written(page(ea));
+                                      if (m_watch[page(ea + 1)]) written(page(ea + 1));
+                                      if (!host && m_shared[page(ea)]) host = copy_page(page(ea));
+                                      if (host && offset(ea) < EMU816_PAGE_SIZE - 1) {
+                                          host[offset(ea)] = (uint8_t)data;
+                                          host[offset(ea) + 1] = (uint8_t)(data >> 8);
+                                      }
+                                      else if (!host && !m_write[page(ea + 1)] && !m_shared[page(ea + 1)])
+                                          store16(ea, data);
+                                      else { write8(ea, (uint8_t)data); write8(ea + 1, (uint8_t)(data >> 8)); } }
+
+        // Writable pages of a fork that still share the parent's memory,
+        // and the pages allocated for private copies of them
+        const uint8_t *         m_shared[EMU816_PAGES];
+        std::vector<uint8_t *>  m_copies;
+        size_t                  m_copies_used;
+
+        uint8_t *               copy_page(uint32_t page);
+        void                    written(uint32_t page)
+                                    { if (m_watch[page] & WATCH_CODE) invalidate_page(page);
+                                      if (m_watch[page] & WATCH_BASELINE) keep_baseline(page); }
+
+        // The current memory of a writable page, whether shared or not
+        const uint8_t *         writable(uint32_t page)
+                                    { return (m_write[page] ? m_write[page] : m_shared[page]); }
+        void                    invalidate_page(uint32_t page);
+        void                    flush_blocks();
+        BLOCK *                 find_block(void * const *handlers);
+
+        bool                    run_native(BLOCK *block, uint64_t horizon);
+        bool                    jit_compile(BLOCK &block);
+        void                    jit_flush();
+
+        // Entry points called from translated code
+        static uint32_t         jit_load8(emu816 *cpu, emu816_addr_t ea);
+        static uint32_t         jit_load16(emu816 *cpu, emu816_addr_t ea);
+        static void             jit_store8(emu816 *cpu, emu816_addr_t ea, uint32_t data);
+        static void             jit_store16(emu816 *cpu, emu816_addr_t ea, uint32_t data);
+        static void             jit_push8(emu816 *cpu, uint32_t value);
+        static void             jit_push16(emu816 *cpu, uint32_t value);
+        static uint32_t         jit_pull8(emu816 *cpu);
+        static uint32_t         jit_pull16(emu816 *cpu);
+#if defined(EMU816_COVERAGE)
+        static void             jit_cover(emu816 *cpu);
+#endif
+
+        void                    charge(uint8_t timing);
+        void                    execute(uint8_t opcode);
+        void                    halt(emu816_stop_t reason);
+        void                    update_interrupts();
+        void                    take_interrupt();
+        void                    enter_vector(uint8_t status, uint16_t emulation, uint16_t native);
+        void                    move_block(uint8_t src, uint8_t dst, int step);
+
+        void                    run_engine();
+        void                    run_cached();
+        template <bool CACHED> void run_threaded();
+
+        void                    get_core(CORE &core);
+        void                    set_core(const CORE &core);
+        bool                    fits(const CORE &core);
+        void                    drop_baseline();
+        void                    keep_baseline(uint32_t page);
+
+#if defined(EMU816_TRACE)
+        // The trace ring and the record of the current instruction, which
+        // is committed when the next one starts or the engine stops. While
+        // not tracing, and when the ring is full, the record is scratch.
+        emu816_trace *          m_trace;
+        emu816_trace_t *        m_trace_record;
+        emu816_trace_t          m_trace_scratch;
+
+        void                    trace(uint8_t opcode);
+        void                    trace_commit();
+#endif
+
+#if defined(EMU816_COVERAGE)
+        // The coverage map and the hashed destination of the last transfer,
+        // which is shifted so that edges A->B and B->A count apart
+        uint8_t *               m_coverage;
+        uint32_t                m_coverage_mask;
+        uint32_t                m_coverage_last;
+
+        void                    cover(emu816_addr_t ea)
+                                    { uint32_t here = (ea * 0x9e3779b1) >> 8;
+                                      ++m_coverage[(here ^ m_coverage_last) & m_coverage_mask];
+                                      m_coverage_last = here >> 1; }
+#endif
+
+        void                    lower_horizon(uint64_t horizon);
+        void                    fire_events();
+        void                    sift_up(int pos);
+        void                    sift_down(int pos);
+        void                    place(int pos, int event)
+                                    { m_heap[pos] = event; m_events[event].heap = pos; }
+        bool                    before(int a, int b)
+                                    { return (m_events[m_heap[a]].deadline < m_events[m_heap[b]].deadline); }
 
         void                    pushByte(uint8_t value);
         void                    pushWord(uint16_t value);
         uint8_t                 pullByte();
         uint16_t                pullWord();
 
+        // Index of the handler table for the current E/M/X state. Bit 0 is
+        // set for an 8-bit accumulator and bit 1 for 8-bit index registers.
+        uint32_t                mode()
+                                    { return ((e || p.f_m) ? 1 : 0) | ((e || p.f_x) ? 2 : 0); }
+
+        // Operand width helpers. T is uint8_t or uint16_t.
+        template <typename T> static T          msb()
+                                    { return ((T)(1u << (8 * sizeof(T) - 1))); }
+        template <typename T> T &               reg(REGS &r);
+        template <typename T> T                 load(emu816_addr_t ea);
+        template <typename T> void              store(emu816_addr_t ea, T data);
+        template <typename T> void              push(T value);
+        template <typename T> T                 pull();
+        template <typename T> void              setnz(T value);
+
         emu816_addr_t am_absl();
         emu816_addr_t am_absx();
         emu816_addr_t am_absy();
@@ -128,6 +733,8 @@ class emu816
         emu816_addr_t am_immw();
         emu816_addr_t am_immm();
         emu816_addr_t am_immx();
+        template <typename T> emu816_addr_t am_immm();
+        template <typename T> emu816_addr_t am_immx();
         emu816_addr_t am_lrel();
         emu816_addr_t am_rela();
         emu816_addr_t am_srel();
@@ -142,14 +749,20 @@ class emu816
         void setnz_b(uint8_t value);
         void setnz_w(uint16_t value);
         void op_adc(emu816_addr_t ea);
+        template <typename T> void op_adc(emu816_addr_t ea);
         void op_and(emu816_addr_t ea);
+        template <typename T> void op_and(emu816_addr_t ea);
         void op_asl(emu816_addr_t ea);
+        template <typename T> void op_asl(emu816_addr_t ea);
         void op_asla(emu816_addr_t ea);
+        template <typename T> void op_asla(emu816_addr_t ea);
         void op_bcc(emu816_addr_t ea);
         void op_bcs(emu816_addr_t ea);
         void op_beq(emu816_addr_t ea);
         void op_bit(emu816_addr_t ea);
+        template <typename T> void op_bit(emu816_addr_t ea);
         void op_biti(emu816_addr_t ea);
+        template <typename T> void op_biti(emu816_addr_t ea);
         void op_bmi(emu816_addr_t ea);
         void op_bne(emu816_addr_t ea);
         void op_bpl(emu816_addr_t ea);
@@ -162,77 +775,120 @@ class emu816
         void op_cli(emu816_addr_t ea);
         void op_clv(emu816_addr_t ea);
         void op_cmp(emu816_addr_t ea);
+        template <typename T> void op_cmp(emu816_addr_t ea);
         void op_cpx(emu816_addr_t ea);
+        template <typename T> void op_cpx(emu816_addr_t ea);
         void op_cpy(emu816_addr_t ea);
+        template <typename T> void op_cpy(emu816_addr_t ea);
         void op_dec(emu816_addr_t ea);
+        template <typename T> void op_dec(emu816_addr_t ea);
         void op_deca(emu816_addr_t ea);
+        template <typename T> void op_deca(emu816_addr_t ea);
         void op_dex(emu816_addr_t ea);
+        template <typename T> void op_dex(emu816_addr_t ea);
         void op_dey(emu816_addr_t ea);
+        template <typename T> void op_dey(emu816_addr_t ea);
         void op_eor(emu816_addr_t ea);
+        template <typename T> void op_eor(emu816_addr_t ea);
         void op_inc(emu816_addr_t ea);
+        template <typename T> void op_inc(emu816_addr_t ea);
         void op_inca(emu816_addr_t ea);
+        template <typename T> void op_inca(emu816_addr_t ea);
         void op_inx(emu816_addr_t ea);
+        template <typename T> void op_inx(emu816_addr_t ea);
         void op_iny(emu816_addr_t ea);
+        template <typename T> void op_iny(emu816_addr_t ea);
         void op_jmp(emu816_addr_t ea);
         void op_jsl(emu816_addr_t ea);
         void op_jsr(emu816_addr_t ea);
         void op_lda(emu816_addr_t ea);
+        template <typename T> void op_lda(emu816_addr_t ea);
         void op_ldx(emu816_addr_t ea);
+        template <typename T> void op_ldx(emu816_addr_t ea);
         void op_ldy(emu816_addr_t ea);
+        template <typename T> void op_ldy(emu816_addr_t ea);
         void op_lsr(emu816_addr_t ea);
+        template <typename T> void op_lsr(emu816_addr_t ea);
         void op_lsra(emu816_addr_t ea);
+        template <typename T> void op_lsra(emu816_addr_t ea);
         void op_mvn(emu816_addr_t ea);
         void op_mvp(emu816_addr_t ea);
         void op_nop(emu816_addr_t ea);
         void op_ora(emu816_addr_t ea);
+        template <typename T> void op_ora(emu816_addr_t ea);
         void op_pea(emu816_addr_t ea);
         void op_pei(emu816_addr_t ea);
         void op_per(emu816_addr_t ea);
         void op_pha(emu816_addr_t ea);
+        template <typename T> void op_pha(emu816_addr_t ea);
         void op_phb(emu816_addr_t ea);
         void op_phd(emu816_addr_t ea);
         void op_phk(emu816_addr_t ea);
         void op_php(emu816_addr_t ea);
         void op_phx(emu816_addr_t ea);
+        template <typename T> void op_phx(emu816_addr_t ea);
         void op_phy(emu816_addr_t ea);
+        template <typename T> void op_phy(emu816_addr_t ea);
         void op_pla(emu816_addr_t ea);
+        template <typename T> void op_pla(emu816_addr_t ea);
         void op_plb(emu816_addr_t ea);
         void op_pld(emu816_addr_t ea);
         void op_plk(emu816_addr_t ea);
         void op_plp(emu816_addr_t ea);
         void op_plx(emu816_addr_t ea);
+        template <typename T> void op_plx(emu816_addr_t ea);
         void op_ply(emu816_addr_t ea);
+        template <typename T> void op_ply(emu816_addr_t ea);
         void op_rep(emu816_addr_t ea);
         void op_rol(emu816_addr_t ea);
+        template <typename T> void op_rol(emu816_addr_t ea);
         void op_rola(emu816_addr_t ea);
+        template <typename T> void op_rola(emu816_addr_t ea);
         void op_ror(emu816_addr_t ea);
+        template <typename T> void op_ror(emu816_addr_t ea);
         void op_rora(emu816_addr_t ea);
+        template <typename T> void op_rora(emu816_addr_t ea);
         void op_rtl(emu816_addr_t ea);
         void op_rts(emu816_addr_t ea);
         void op_sbc(emu816_addr_t ea);
+        template <typename T> void op_sbc(emu816_addr_t ea);
         void op_sec(emu816_addr_t ea);
         void op_sed(emu816_addr_t ea);
         void op_sei(emu816_addr_t ea);
         void op_sep(emu816_addr_t ea);
         void op_sta(emu816_addr_t ea);
+        template <typename T> void op_sta(emu816_addr_t ea);
         void op_stp(emu816_addr_t ea);
         void op_stx(emu816_addr_t ea);
+        template <typename T> void op_stx(emu816_addr_t ea);
         void op_sty(emu816_addr_t ea);
+        template <typename T> void op_sty(emu816_addr_t ea);
         void op_stz(emu816_addr_t ea);
+        template <typename T> void op_stz(emu816_addr_t ea);
         void op_tax(emu816_addr_t ea);
+        template <typename T> void op_tax(emu816_addr_t ea);
         void op_tay(emu816_addr_t ea);
+        template <typename T> void op_tay(emu816_addr_t ea);
         void op_tcd(emu816_addr_t ea);
         void op_tdc(emu816_addr_t ea);
+        template <typename T> void op_tdc(emu816_addr_t ea);
         void op_tcs(emu816_addr_t ea);
         void op_trb(emu816_addr_t ea);
+        template <typename T> void op_trb(emu816_addr_t ea);
         void op_tsb(emu816_addr_t ea);
+        template <typename T> void op_tsb(emu816_addr_t ea);
         void op_tsc(emu816_addr_t ea);
+        template <typename T> void op_tsc(emu816_addr_t ea);
         void op_tsx(emu816_addr_t ea);
         void op_txa(emu816_addr_t ea);
+        template <typename T> void op_txa(emu816_addr_t ea);
         void op_txs(emu816_addr_t ea);
         void op_txy(emu816_addr_t ea);
+        template <typename T> void op_txy(emu816_addr_t ea);
         void op_tya(emu816_addr_t ea);
+        template <typename T> void op_tya(emu816_addr_t ea);
         void op_tyx(emu816_addr_t ea);
+        template <typename T> void op_tyx(emu816_addr_t ea);
         void op_wai(emu816_addr_t ea);
         virtual void op_wdm(emu816_addr_t ea);
         void op_xba(emu816_addr_t ea);
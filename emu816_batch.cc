@@ -0,0 +1,256 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo   
+//                                         d88'   `8. o888    .88'     
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'      
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo. 
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88 
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P 
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'  
+//                                                                    
+// A Portable C++ WDC 65C816 Emulator  
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// Runs batches of independent processors on a pool of threads. Each worker
+// owns a queue of jobs, runs them a quantum at a time in turn and steals
+// from the other queues once its own is empty.
+
+#include <emu816_batch.h>
+#include <chrono>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Return the steady clock time in nanoseconds
+static int64_t now()
+{
+    return (std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+emu816_batch::emu816_batch(unsigned threads, uint64_t quantum)
+: m_threads(threads)
+, m_quantum(quantum ? quantum : EMU816_BATCH_QUANTUM)
+, m_pin(false)
+, m_queues(NULL)
+, m_next(0)
+, m_outstanding(0)
+, m_queued(0)
+, m_parked(0)
+, m_jobs(0)
+, m_cycles(0)
+, m_quanta(0)
+, m_steals(0)
+, m_start(0)
+, m_end(0)
+, m_done(NULL)
+, m_done_context(NULL)
+{
+    // Find the CPUs this process is allowed to use
+#if defined(__linux__)
+    cpu_set_t set;
+
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int n = 0; n < CPU_SETSIZE; ++n)
+            if (CPU_ISSET(n, &set)) m_cpus.push_back(n);
+    }
+#endif
+    if (!m_threads) m_threads = m_cpus.size();
+    if (!m_threads) m_threads = std::thread::hardware_concurrency();
+    if (!m_threads) m_threads = 1;
+
+    m_queues = new QUEUE[m_threads];
+}
+
+emu816_batch::~emu816_batch()
+{
+    delete[] m_queues;
+}
+
+// Add a job to the batch. Jobs are spread over the worker queues in turn.
+void emu816_batch::submit(emu816_job_t *job)
+{
+    job->reason = EMU816_STOP_NONE;
+    job->executed = 0;
+    ++m_outstanding;
+
+    push(m_next++ % m_threads, job);
+}
+
+// Put a job on the back of a worker's queue and wake a parked worker to
+// take it
+void emu816_batch::push(unsigned index, emu816_job_t *job)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_queues[index].lock);
+        m_queues[index].jobs.push_back(job);
+        ++m_queued;
+    }
+    wake(false);
+}
+
+// Wait until a job is queued or the batch has finished. A worker counts
+// itself as parked before it checks, so a job pushed at the same time
+// either is seen here or wakes it.
+void emu816_batch::park()
+{
+    std::unique_lock<std::mutex> guard(m_idle_lock);
+
+    ++m_parked;
+    m_idle.wait(guard, [this] { return (m_queued.load() || !m_outstanding.load()); });
+    --m_parked;
+}
+
+// Wake one parked worker, or all of them once the batch has finished
+void emu816_batch::wake(bool all)
+{
+    if (!m_parked.load()) return;
+
+    std::lock_guard<std::mutex> guard(m_idle_lock);
+    if (all)
+        m_idle.notify_all();
+    else
+        m_idle.notify_one();
+}
+
+// Run every job to completion, calling done as each one finishes
+void emu816_batch::run(emu816_job_done_fn done, void *context)
+{
+    std::vector<std::thread> workers;
+
+    m_done = done;
+    m_done_context = context;
+    m_jobs = 0;
+    m_cycles = 0;
+    m_quanta = 0;
+    m_steals = 0;
+    m_end = 0;
+    m_start = now();
+
+    for (unsigned n = 0; n < m_threads; ++n)
+        workers.push_back(std::thread(&emu816_batch::worker, this, n));
+    for (unsigned n = 0; n < m_threads; ++n)
+        workers[n].join();
+
+    m_end = now();
+}
+
+// Return the throughput so far
+emu816_batch_stats_t emu816_batch::stats()
+{
+    emu816_batch_stats_t stats;
+    int64_t start = m_start.load();
+    int64_t end = m_end.load();
+
+    stats.jobs = m_jobs.load();
+    stats.cycles = m_cycles.load();
+    stats.quanta = m_quanta.load();
+    stats.steals = m_steals.load();
+    stats.seconds = start ? ((end ? end : now()) - start) / 1e9 : 0.0;
+    stats.jobs_per_second = (stats.seconds > 0) ? stats.jobs / stats.seconds : 0.0;
+    stats.mhz = (stats.seconds > 0) ? stats.cycles / stats.seconds / 1e6 : 0.0;
+    return (stats);
+}
+
+// Run jobs from this worker's queue, or stolen from the others, until all
+// of them have finished
+void emu816_batch::worker(unsigned index)
+{
+#if defined(__linux__)
+    if (m_pin && m_cpus.size()) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(m_cpus[index % m_cpus.size()], &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#endif
+
+    while (m_outstanding.load()) {
+        emu816_job_t *job = take(index);
+
+        if (!job) {
+            park();
+            continue;
+        }
+        if (run_quantum(job))
+            finish(job);
+        else
+            push(index, job);
+    }
+}
+
+// Take the next job from the front of this worker's queue, or failing that
+// from the back of another's
+emu816_job_t *emu816_batch::take(unsigned index)
+{
+    emu816_job_t *job = NULL;
+
+    for (unsigned n = 0; n < m_threads && !job; ++n) {
+        QUEUE &queue = m_queues[(index + n) % m_threads];
+        std::lock_guard<std::mutex> guard(queue.lock);
+
+        if (queue.jobs.empty()) continue;
+        if (n == 0) {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+        }
+        else {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+            ++m_steals;
+        }
+        --m_queued;
+    }
+    return (job);
+}
+
+// Run a job for one quantum. Returns true when it has finished, either
+// because the processor stopped or because its cycle limit was reached.
+// A processor waiting in WAI runs on until its limit, if it has one, as
+// an event may wake it.
+bool emu816_batch::run_quantum(emu816_job_t *job)
+{
+    uint64_t budget = m_quantum;
+    uint64_t start = job->cpu->cycles();
+
+    if (job->cycles && job->cycles - job->executed < budget)
+        budget = job->cycles - job->executed;
+
+    job->reason = job->cpu->run_for(budget);
+
+    // A job that resets its processor restarts the cycle count
+    uint64_t end = job->cpu->cycles();
+    uint64_t ran = (end >= start) ? end - start : end;
+
+    job->executed += ran;
+    m_cycles += ran;
+    ++m_quanta;
+
+    if (job->reason == EMU816_STOP_BUDGET || (job->reason == EMU816_STOP_WAI && job->cycles))
+        return (job->cycles && job->executed >= job->cycles);
+    return (true);
+}
+
+// Report a finished job. The job only stops counting as outstanding once
+// the callback returns, so that jobs it submits keep the workers running.
+void emu816_batch::finish(emu816_job_t *job)
+{
+    ++m_jobs;
+    if (m_done) {
+        std::lock_guard<std::mutex> guard(m_done_lock);
+        m_done(job, m_done_context);
+    }
+    if (!--m_outstanding) wake(true);
+}
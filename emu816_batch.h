@@ -0,0 +1,129 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo   
+//                                         d88'   `8. o888    .88'     
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'      
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo. 
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88 
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P 
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'  
+//                                                                    
+// A Portable C++ WDC 65C816 Emulator  
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+#ifndef EMU816_BATCH_H
+#define EMU816_BATCH_H
+
+#include <emu816.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// Cycles a job runs for before it goes back on its queue
+#define EMU816_BATCH_QUANTUM    1000000
+
+// A job is a processor that has been set up and reset by the caller, along
+// with the number of cycles it may run for (0 for no limit). The runner
+// fills in the results when it finishes.
+typedef struct {
+    emu816 *                cpu;
+    uint64_t                cycles;
+    void *                  context;
+
+    emu816_stop_t           reason;         // why the job finished
+    uint64_t                executed;       // cycles run
+} emu816_job_t;
+
+// Called as each job finishes. Calls are serialised, so the callback need
+// not lock anything of its own, but are made on the worker threads.
+typedef void            (*emu816_job_done_fn)(emu816_job_t *job, void *context);
+
+// Throughput of the current or last batch
+typedef struct {
+    uint64_t                jobs;           // jobs finished
+    uint64_t                cycles;         // cycles emulated by all jobs
+    uint64_t                quanta;         // quanta run
+    uint64_t                steals;         // jobs taken from another worker
+    double                  seconds;        // wall clock time
+    double                  jobs_per_second;
+    double                  mhz;            // aggregate emulated clock rate
+} emu816_batch_stats_t;
+
+// Runs many independent jobs across a pool of worker threads. Each worker
+// has its own queue and takes work from the others when it runs dry. A job
+// runs for one quantum of cycles at a time and then goes to the back of
+// its worker's queue, so long jobs cannot hold up short ones and can move
+// to an idle worker.
+class emu816_batch
+{
+    public:
+
+        // A thread count of zero uses one worker per CPU that the process
+        // may run on.
+        emu816_batch(unsigned threads=0, uint64_t quantum=EMU816_BATCH_QUANTUM);
+        ~emu816_batch();
+
+        // Pin each worker to one of the CPUs the process may run on
+        void                    set_affinity(bool pin) { m_pin = pin; }
+        unsigned                threads() { return m_threads; }
+
+        // Jobs may be submitted before run() or from the done callback
+        void                    submit(emu816_job_t *job);
+
+        // Run until every submitted job has finished
+        void                    run(emu816_job_done_fn done, void *context);
+
+        // May be called from any thread while the batch is running
+        emu816_batch_stats_t    stats();
+
+    private:
+
+        struct QUEUE {
+            std::mutex              lock;
+            std::deque<emu816_job_t *> jobs;
+        };
+
+        unsigned                m_threads;
+        uint64_t                m_quantum;
+        bool                    m_pin;
+        std::vector<int>        m_cpus;
+        QUEUE *                 m_queues;
+
+        std::atomic<unsigned>   m_next;         // queue for the next submission
+        std::atomic<uint64_t>   m_outstanding;  // jobs submitted but not finished
+        std::atomic<uint64_t>   m_queued;       // jobs waiting on a queue
+        std::atomic<unsigned>   m_parked;       // workers waiting for work
+        std::atomic<uint64_t>   m_jobs;
+        std::atomic<uint64_t>   m_cycles;
+        std::atomic<uint64_t>   m_quanta;
+        std::atomic<uint64_t>   m_steals;
+        std::atomic<int64_t>    m_start;        // steady clock, in ns
+        std::atomic<int64_t>    m_end;
+
+        std::mutex              m_idle_lock;
+        std::condition_variable m_idle;         // work queued or batch finished
+
+        std::mutex              m_done_lock;
+        emu816_job_done_fn      m_done;
+        void *                  m_done_context;
+
+        void                    worker(unsigned index);
+        void                    push(unsigned index, emu816_job_t *job);
+        void                    park();
+        void                    wake(bool all);
+        emu816_job_t *          take(unsigned index);
+        bool                    run_quantum(emu816_job_t *job);
+        void                    finish(emu816_job_t *job);
+};
+
+#endif
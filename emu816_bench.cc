@@ -0,0 +1,398 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo   
+//                                         d88'   `8. o888    .88'     
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'      
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo. 
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88 
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P 
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'  
+//                                                                    
+// A Portable C++ WDC 65C816 Emulator  
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// Times the engines on a set of guest workloads and writes the results as
+// JSON, one entry per workload and engine:
+//
+//   emu816_bench [cycles [repeats]]
+//
+// Each workload is run for the given number of cycles (default 20000000)
+// from reset, taking the fastest of the repeats (default 3). Instructions
+// are counted once by stepping the reference engine; an interrupt taken
+// counts as one, and so does a block move however many bytes it moves. The state each engine finishes in is checksummed, and
+// the run fails if the engines disagree.
+
+#include <emu816.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+// A guest program, loaded at $00:1000
+struct WORKLOAD {
+    const char *            name;
+    const uint8_t *         code;
+    size_t                  size;
+    const uint8_t *         handler;        // IRQ handler at $00:4000, if any
+    size_t                  handler_size;
+    uint32_t                period;         // cycles between timer interrupts
+};
+
+// Add one to eight bytes in turn in emulation mode
+const uint8_t s_loop8[] = {
+    0x18,                   // 1000    CLC
+    0xa2, 0x00,             // 1001    LDX #0
+    0xa0, 0x00,             // 1003    LDY #0
+    0xb5, 0x10,             // 1005    LDA $10,X
+    0x69, 0x01,             // 1007    ADC #1
+    0x95, 0x10,             // 1009    STA $10,X
+    0x88,                   // 100B    DEY
+    0xd0, 0xf7,             // 100C    BNE $1005
+    0xe8,                   // 100E    INX
+    0xe0, 0x08,             // 100F    CPX #8
+    0xd0, 0xf0,             // 1011    BNE $1003
+    0x80, 0xeb              // 1013    BRA $1000
+};
+
+// A 16-bit linear congruential generator and some mixing in native mode
+const uint8_t s_arith16[] = {
+    0x18, 0xfb,             // 1000    CLC / XCE
+    0xc2, 0x30,             // 1002    REP #$30
+    0xa9, 0x34, 0x12,       // 1004    LDA #$1234
+    0x85, 0x10,             // 1007    STA $10
+    0xa5, 0x10,             // 1009    LDA $10
+    0x0a,                   // 100B    ASL A
+    0x0a,                   // 100C    ASL A
+    0x18,                   // 100D    CLC
+    0x65, 0x10,             // 100E    ADC $10
+    0x69, 0x39, 0x30,       // 1010    ADC #$3039
+    0x85, 0x10,             // 1013    STA $10
+    0x38,                   // 1015    SEC
+    0xe5, 0x12,             // 1016    SBC $12
+    0x85, 0x12,             // 1018    STA $12
+    0x45, 0x10,             // 101A    EOR $10
+    0x4a,                   // 101C    LSR A
+    0x85, 0x14,             // 101D    STA $14
+    0xe6, 0x16,             // 101F    INC $16
+    0x80, 0xe6              // 1021    BRA $1009
+};
+
+// 16-bit decimal adds and subtracts
+const uint8_t s_bcd[] = {
+    0x18, 0xfb,             // 1000    CLC / XCE
+    0xc2, 0x30,             // 1002    REP #$30
+    0xf8,                   // 1004    SED
+    0xa9, 0x00, 0x00,       // 1005    LDA #0
+    0x85, 0x10,             // 1008    STA $10
+    0x85, 0x12,             // 100A    STA $12
+    0x18,                   // 100C    CLC
+    0xa5, 0x10,             // 100D    LDA $10
+    0x69, 0x37, 0x12,       // 100F    ADC #$1237
+    0x85, 0x10,             // 1012    STA $10
+    0x38,                   // 1014    SEC
+    0xa5, 0x12,             // 1015    LDA $12
+    0xe9, 0x89, 0x04,       // 1017    SBC #$0489
+    0x85, 0x12,             // 101A    STA $12
+    0x18,                   // 101C    CLC
+    0x65, 0x10,             // 101D    ADC $10
+    0x85, 0x14,             // 101F    STA $14
+    0x80, 0xe9              // 1021    BRA $100C
+};
+
+// Copy 4K from bank 1 to bank 2 and back again
+const uint8_t s_block[] = {
+    0x18, 0xfb,             // 1000    CLC / XCE
+    0xc2, 0x30,             // 1002    REP #$30
+    0xa9, 0xff, 0x0f,       // 1004    LDA #$0FFF
+    0xa2, 0x00, 0x00,       // 1007    LDX #$0000
+    0xa0, 0x00, 0x00,       // 100A    LDY #$0000
+    0x54, 0x02, 0x01,       // 100D    MVN $01,$02
+    0xa9, 0xff, 0x0f,       // 1010    LDA #$0FFF
+    0xa2, 0xff, 0x0f,       // 1013    LDX #$0FFF
+    0xa0, 0xff, 0x1f,       // 1016    LDY #$1FFF
+    0x44, 0x01, 0x02,       // 1019    MVP $02,$01
+    0x80, 0xe6              // 101C    BRA $1004
+};
+
+// Recurse 200 deep with JSR, making a JSL at each level on the way out
+const uint8_t s_recurse[] = {
+    0x18, 0xfb,             // 1000    CLC / XCE
+    0xc2, 0x30,             // 1002    REP #$30
+    0xa2, 0xff, 0x7f,       // 1004    LDX #$7FFF
+    0x9a,                   // 1007    TXS
+    0xa2, 0xc8, 0x00,       // 1008    LDX #200
+    0x20, 0x00, 0x20,       // 100B    JSR $2000
+    0x80, 0xf8              // 100E    BRA $1008
+};
+
+const uint8_t s_recurse_sub[] = {
+    0xe0, 0x00, 0x00,       // 2000    CPX #0
+    0xf0, 0x09,             // 2003    BEQ $200E
+    0xca,                   // 2005    DEX
+    0x20, 0x00, 0x20,       // 2006    JSR $2000
+    0x22, 0x00, 0x30, 0x00, // 2009    JSL $003000
+    0xe8,                   // 200D    INX
+    0x60                    // 200E    RTS
+};
+
+const uint8_t s_recurse_far[] = {
+    0x8b,                   // 3000    PHB
+    0x48,                   // 3001    PHA
+    0x68,                   // 3002    PLA
+    0xab,                   // 3003    PLB
+    0x6b                    // 3004    RTL
+};
+
+// Walk arrays through (dp),Y, [dp],Y and (dp,X) pointers
+const uint8_t s_indirect[] = {
+    0x18, 0xfb,             // 1000    CLC / XCE
+    0xc2, 0x30,             // 1002    REP #$30
+    0xa9, 0x00, 0x40,       // 1004    LDA #$4000
+    0x85, 0x20,             // 1007    STA $20
+    0xa9, 0x00, 0x50,       // 1009    LDA #$5000
+    0x85, 0x22,             // 100C    STA $22
+    0x64, 0x24,             // 100E    STZ $24
+    0xa9, 0x01, 0x00,       // 1010    LDA #1
+    0x85, 0x26,             // 1013    STA $26
+    0xa0, 0x00, 0x00,       // 1015    LDY #0
+    0xb1, 0x20,             // 1018    LDA ($20),Y
+    0x18,                   // 101A    CLC
+    0x77, 0x24,             // 101B    ADC [$24],Y
+    0x91, 0x22,             // 101D    STA ($22),Y
+    0xa2, 0x00, 0x00,       // 101F    LDX #0
+    0xa1, 0x20,             // 1022    LDA ($20,X)
+    0x97, 0x24,             // 1024    STA [$24],Y
+    0xc8,                   // 1026    INY
+    0xc8,                   // 1027    INY
+    0xc0, 0x00, 0x02,       // 1028    CPY #$200
+    0xd0, 0xeb,             // 102B    BNE $1018
+    0x80, 0xe6              // 102D    BRA $1015
+};
+
+// Count in a loop while a timer interrupts every 100 cycles, each handler
+// acknowledging it through a device register
+const uint8_t s_irq[] = {
+    0x18, 0xfb,             // 1000    CLC / XCE
+    0xc2, 0x30,             // 1002    REP #$30
+    0x58,                   // 1004    CLI
+    0xe8,                   // 1005    INX
+    0xc8,                   // 1006    INY
+    0x1a,                   // 1007    INC A
+    0x80, 0xfb              // 1008    BRA $1005
+};
+
+const uint8_t s_irq_handler[] = {
+    0x48,                   // 4000    PHA
+    0xaf, 0x00, 0x00, 0x03, // 4001    LDA $030000
+    0xe6, 0x30,             // 4005    INC $30
+    0x68,                   // 4007    PLA
+    0x40                    // 4008    RTI
+};
+
+#define EMU816_WORKLOAD(name)   s_##name, sizeof(s_##name)
+
+const WORKLOAD s_workloads[] = {
+    { "loop8",      EMU816_WORKLOAD(loop8),     NULL, 0, 0 },
+    { "arith16",    EMU816_WORKLOAD(arith16),   NULL, 0, 0 },
+    { "bcd",        EMU816_WORKLOAD(bcd),       NULL, 0, 0 },
+    { "block_move", EMU816_WORKLOAD(block),     NULL, 0, 0 },
+    { "recursion",  EMU816_WORKLOAD(recurse),   NULL, 0, 0 },
+    { "indirect",   EMU816_WORKLOAD(indirect),  NULL, 0, 0 },
+    { "interrupts", EMU816_WORKLOAD(irq),       EMU816_WORKLOAD(irq_handler), 100 }
+};
+
+#undef EMU816_WORKLOAD
+
+// The ways of running a processor
+struct ENGINE {
+    const char *            name;
+    emu816_engine_t         engine;
+    bool                    cache;
+    bool                    jit;
+};
+
+const ENGINE s_engines[] = {
+    { "switch",         EMU816_ENGINE_SWITCH,   false,  false },
+    { "switch_cache",   EMU816_ENGINE_SWITCH,   true,   false },
+    { "switch_jit",     EMU816_ENGINE_SWITCH,   true,   true  },
+    { "threaded",       EMU816_ENGINE_THREADED, false,  false },
+    { "threaded_cache", EMU816_ENGINE_THREADED, true,   false },
+    { "threaded_jit",   EMU816_ENGINE_THREADED, true,   true  }
+};
+
+// Banks 0 to 2 are RAM and bank 3 holds a timer's acknowledge register
+class machine : public emu816
+{
+    public:
+
+        machine(const WORKLOAD &w)
+        : m_ram(0x30000, 0)
+        , m_period(w.period)
+        {
+            memcpy(&m_ram[0x1000], w.code, w.size);
+            if (w.code == s_recurse) {
+                memcpy(&m_ram[0x2000], s_recurse_sub, sizeof(s_recurse_sub));
+                memcpy(&m_ram[0x3000], s_recurse_far, sizeof(s_recurse_far));
+            }
+            if (w.handler) memcpy(&m_ram[0x4000], w.handler, w.handler_size);
+            m_ram[0xffee] = 0x00;
+            m_ram[0xffef] = 0x40;
+            for (uint32_t n = 0; n < 0x1000; ++n)
+                m_ram[0x14000 + n] = (uint8_t)(n * 7);
+
+            map_memory(0, 0x30000, &m_ram[0], EMU816_MAP_RAM);
+            m_timer = add_event(tick, this);
+            reset(0x1000);
+            a.w = x.w = y.w = 0;
+            if (m_period) schedule(m_timer, m_period);
+        }
+
+        // A hash of the registers and memory
+        uint64_t checksum()
+        {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            uint8_t regs[] = { lo(a.w), hi(a.w), lo(x.w), hi(x.w), lo(y.w), hi(y.w),
+                               lo(sp.w), hi(sp.w), lo(dp.w), hi(dp.w), dbr, pbr,
+                               lo(pc), hi(pc), get_p(), e };
+
+            for (size_t n = 0; n < sizeof(regs); ++n)
+                hash = (hash ^ regs[n]) * 0x100000001b3ull;
+            for (size_t n = 0; n < m_ram.size(); ++n)
+                hash = (hash ^ m_ram[n]) * 0x100000001b3ull;
+            return (hash);
+        }
+
+        // The next instruction, and the stack pointer that taking an
+        // interrupt moves
+        emu816_addr_t next() { return (join(pbr, pc)); }
+        uint16_t stack() { return (sp.w); }
+
+        uint8_t load8(emu816_addr_t ea)
+            { if (ea < m_ram.size()) return (m_ram[ea]);
+              release_irq(0);
+              return (0); }
+        void store8(emu816_addr_t ea, uint8_t data)
+            { if (ea < m_ram.size()) m_ram[ea] = data; }
+        uint16_t load16(emu816_addr_t ea)
+            { return (load8(ea) | (load8(ea + 1) << 8)); }
+        void store16(emu816_addr_t ea, uint16_t data)
+            { store8(ea, data); store8(ea + 1, data >> 8); }
+        emu816_addr_t load24(emu816_addr_t ea)
+            { return (load8(ea) | (load8(ea + 1) << 8) | (load8(ea + 2) << 16)); }
+
+    private:
+
+        std::vector<uint8_t>    m_ram;
+        uint32_t                m_period;
+        emu816_event_t          m_timer;
+
+        static void tick(void *context, uint64_t deadline)
+            { machine *m = (machine *)context;
+              m->assert_irq(0);
+              m->schedule(m->m_timer, deadline + m->m_period); }
+};
+
+// Count the instructions the workload executes in the given cycles. MVN
+// and MVP take a step per byte and leave the PC on themselves until the
+// move is done, so a step carrying on the move left by the last one is
+// not counted again.
+uint64_t count(const WORKLOAD &w, uint64_t cycles, uint64_t &checksum)
+{
+    machine m(w);
+    uint64_t n = 0;
+    emu816_addr_t moving = EMU816_INVALID_PC;
+
+    while (m.cycles() < cycles) {
+        emu816_addr_t at = m.next();
+        uint16_t sp = m.stack();
+        uint8_t opcode = m.peek(at);
+
+        m.run_for(1);
+        if (at != moving || m.stack() != sp) ++n;
+        moving = ((opcode == 0x44 || opcode == 0x54) && m.next() == at) ? at : EMU816_INVALID_PC;
+    }
+    checksum = m.checksum();
+    return (n);
+}
+
+// Time the workload on an engine, returning false if it is not available
+bool time(const WORKLOAD &w, const ENGINE &engine, uint64_t cycles, int repeats,
+    double &best, uint64_t &ran, uint64_t &checksum)
+{
+    best = 0;
+    for (int r = 0; r < repeats; ++r) {
+        machine m(w);
+
+        if (!m.set_engine(engine.engine)) return (false);
+        m.enable_block_cache(engine.cache);
+        if (engine.jit && !m.enable_jit(true)) return (false);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        m.run_for(cycles);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (r == 0 || seconds < best) best = seconds;
+        ran = m.cycles();
+        checksum = m.checksum();
+    }
+    return (true);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t cycles = (argc > 1) ? strtoull(argv[1], NULL, 0) : 20000000;
+    int repeats = (argc > 2) ? atoi(argv[2]) : 3;
+    size_t workloads = sizeof(s_workloads) / sizeof(s_workloads[0]);
+    size_t engines = sizeof(s_engines) / sizeof(s_engines[0]);
+    bool first = true;
+    int status = 0;
+
+    if (cycles == 0 || repeats < 1) {
+        fprintf(stderr, "usage: emu816_bench [cycles [repeats]]\n");
+        return (1);
+    }
+
+    printf("{\n  \"cycles\": %llu,\n  \"repeats\": %d,\n  \"results\": [",
+        (unsigned long long)cycles, repeats);
+    for (size_t w = 0; w < workloads; ++w) {
+        const WORKLOAD &work = s_workloads[w];
+        uint64_t expected;
+        uint64_t insns = count(work, cycles, expected);
+
+        for (size_t e = 0; e < engines; ++e) {
+            const ENGINE &engine = s_engines[e];
+            double seconds;
+            uint64_t ran, checksum;
+
+            if (!time(work, engine, cycles, repeats, seconds, ran, checksum)) continue;
+            if (checksum != expected) {
+                fprintf(stderr, "%s: %s finished in a different state\n", work.name, engine.name);
+                status = 1;
+            }
+            printf("%s\n    { \"workload\": \"%s\", \"engine\": \"%s\", \"cycles\": %llu, "
+                "\"instructions\": %llu, \"seconds\": %.6f, \"mhz\": %.2f, "
+                "\"instructions_per_second\": %.0f, \"ns_per_instruction\": %.3f, "
+                "\"checksum\": \"%016llx\" }",
+                first ? "" : ",", work.name, engine.name, (unsigned long long)ran,
+                (unsigned long long)insns, seconds, ran / seconds / 1e6,
+                insns / seconds, seconds * 1e9 / insns, (unsigned long long)checksum);
+            first = false;
+            fflush(stdout);
+        }
+    }
+    printf("\n  ]\n}\n");
+    return (status);
+}
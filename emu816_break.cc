@@ -0,0 +1,129 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo
+//                                         d88'   `8. o888    .88'
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo.
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'
+//
+// A Portable C++ WDC 65C816 Emulator
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// Breakpoints and watchpoints.
+//
+// The kinds of breakpoint set at each address are kept in a map, and each
+// page holding any is flagged in the watch table for the kinds it has. The
+// execution paths only look an address up when its page is flagged, so
+// breakpoints cost nothing elsewhere. Blocks of decoded instructions end
+// before an execution breakpoint so that it is only ever checked at the
+// start of one.
+//
+// The processor stops before the instruction at an execution breakpoint,
+// and remembers it so that running on from there executes it rather than
+// stopping again.
+
+#include <emu816.h>
+
+// Add the kinds given to the breakpoint at an address.
+void emu816::set_breakpoint(emu816_addr_t ea, uint32_t kinds)
+{
+    ea &= 0xffffff;
+    kinds &= EMU816_BREAK_EXEC | EMU816_BREAK_LOAD | EMU816_BREAK_STORE;
+    if (!kinds) return;
+
+    m_breakpoints[ea] |= kinds;
+    flag_page(page(ea));
+    if (kinds & EMU816_BREAK_EXEC) invalidate_page(page(ea));
+}
+
+// Remove the kinds given from the breakpoint at an address, and drop it if
+// none are left.
+void emu816::clear_breakpoint(emu816_addr_t ea, uint32_t kinds)
+{
+    std::unordered_map<emu816_addr_t, uint8_t>::iterator it = m_breakpoints.find(ea & 0xffffff);
+
+    if (it == m_breakpoints.end()) return;
+
+    uint8_t old = it->second;
+
+    if ((it->second &= ~kinds) == 0)
+        m_breakpoints.erase(it);
+    flag_page(page(ea));
+    if (old & kinds & EMU816_BREAK_EXEC) invalidate_page(page(ea));
+}
+
+// Remove every breakpoint.
+void emu816::clear_breakpoints()
+{
+    while (!m_breakpoints.empty())
+        clear_breakpoint(m_breakpoints.begin()->first, ~0u);
+}
+
+// Recompute the breakpoint flags of a page from the breakpoints in it.
+void emu816::flag_page(uint32_t pg)
+{
+    uint8_t flags = 0;
+
+    for (std::unordered_map<emu816_addr_t, uint8_t>::const_iterator it = m_breakpoints.begin();
+            it != m_breakpoints.end(); ++it) {
+        if (page(it->first) != pg) continue;
+        if (it->second & EMU816_BREAK_EXEC) flags |= WATCH_EXEC;
+        if (it->second & EMU816_BREAK_LOAD) flags |= WATCH_LOAD;
+        if (it->second & EMU816_BREAK_STORE) flags |= WATCH_STORE;
+    }
+    m_watch[pg] = (m_watch[pg] & ~(WATCH_EXEC | WATCH_LOAD | WATCH_STORE)) | flags;
+}
+
+// Return the kinds of breakpoint at an address.
+uint32_t emu816::break_kinds(emu816_addr_t ea)
+{
+    std::unordered_map<emu816_addr_t, uint8_t>::const_iterator it = m_breakpoints.find(ea & 0xffffff);
+
+    return (it == m_breakpoints.end() ? 0 : it->second);
+}
+
+// Stop before the next instruction if there is an execution breakpoint at
+// it, unless the processor is running on from it. Returns true if stopped.
+bool emu816::breakpoint()
+{
+    emu816_addr_t ea = join(pbr, pc);
+
+    if (m_travelling) return (false);
+    if (ea == m_resume) {
+        m_resume = EMU816_INVALID_PC;
+        return (false);
+    }
+    if (!(break_kinds(ea) & EMU816_BREAK_EXEC)) return (false);
+
+    m_break_at = ea;
+    m_break_kind = EMU816_BREAK_EXEC;
+    m_resume = ea;
+    halt(EMU816_STOP_BREAKPOINT);
+    return (true);
+}
+
+// Stop after the current instruction if any of the bytes of a data access
+// has a watchpoint of the kind made.
+void emu816::watched(emu816_addr_t ea, uint32_t size, uint32_t kind)
+{
+    if (m_travelling) return;
+
+    for (uint32_t n = 0; n < size; ++n) {
+        if (break_kinds((ea + n) & 0xffffff) & kind) {
+            m_break_at = (ea + n) & 0xffffff;
+            m_break_kind = kind;
+            halt(EMU816_STOP_BREAKPOINT);
+            return;
+        }
+    }
+}
@@ -0,0 +1,71 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo
+//                                         d88'   `8. o888    .88'
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo.
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'
+//
+// A Portable C++ WDC 65C816 Emulator
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// Edge coverage for coverage-guided fuzzing, in the form used by AFL.
+//
+// Each control transfer hashes its destination and counts the edge from the
+// destination of the one before in a byte of the map. The map is normally
+// the shared memory segment the fuzzer created, so it sees the counts
+// without a copy. Everything here compiles to nothing unless EMU816_COVERAGE
+// is defined.
+
+#include <emu816.h>
+
+#if defined(EMU816_COVERAGE)
+#include <stdlib.h>
+#include <string.h>
+#include <sys/shm.h>
+
+// Count edges in a map of a power of two bytes, or stop with NULL. Returns
+// false if the size is not a power of two.
+bool emu816::set_coverage(uint8_t *map, uint32_t size)
+{
+    if (map && (size == 0 || (size & (size - 1)))) return (false);
+
+    // Translated code counts edges only if it was made while covering
+    if (m_jit && !m_coverage != !map) jit_flush();
+    m_coverage = map;
+    m_coverage_mask = map ? size - 1 : 0;
+    m_coverage_last = 0;
+    return (true);
+}
+
+// Count edges in the shared memory segment whose identifier the fuzzer
+// passed in __AFL_SHM_ID. Returns false if there is none.
+bool emu816::attach_coverage(uint32_t size)
+{
+    const char *id = getenv("__AFL_SHM_ID");
+
+    if (!id) return (false);
+
+    void *map = shmat(atoi(id), NULL, 0);
+
+    if (map == (void *)-1) return (false);
+    return (set_coverage((uint8_t *)map, size));
+}
+
+// Zero the map and forget the last transfer, e.g. before the next input
+void emu816::clear_coverage()
+{
+    if (m_coverage) memset(m_coverage, 0, m_coverage_mask + 1);
+    m_coverage_last = 0;
+}
+#endif
@@ -0,0 +1,697 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo   
+//                                         d88'   `8. o888    .88'     
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'      
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo. 
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88 
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P 
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'  
+//                                                                    
+// A Portable C++ WDC 65C816 Emulator  
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// Checks the faster execution engines against the reference interpreter.
+//
+//   emu816_diffcheck [-1 engine] [-2 engine] [-a load] [-e entry]
+//                    [-c cycles] [-b interval] [-n period] [-t dump] image
+//
+// runs a binary image on two engines side by side, the reference switch
+// and the recompiler unless told otherwise, for the given cycles (default
+// 10000000). After every interval (default 1 cycle, i.e. every
+// instruction) the registers, flags, cycle counts, stop reasons and the
+// memory writes made are compared. The first difference is reported with
+// the instructions leading up to it, which can also be written as a trace
+// dump for emu816_tracedump. Translated blocks only run when they fit in
+// the interval, so the recompiler needs one of 50 cycles or more to be
+// tested. An NMI may be raised every period cycles to exercise interrupts.
+//
+//   emu816_diffcheck -r seed [options as above]
+//
+// fuzzes in the same way with 64K of random code in place of an image,
+// lacking STP, WAI and WDM, and random values in A, X and Y. The processor
+// starts in emulation mode, so X and Y begin 8 bits wide with their high
+// bytes set, which the index page crossing penalty must ignore.
+//
+//   emu816_diffcheck -v [-j jobs] [-E engine] [-C] vectors.json...
+//
+// runs per-opcode test vectors in the SingleStepTests JSON format, files
+// in parallel across the cores, on the given engine (default the switch)
+// and compares the registers and memory each test ends with, and its cycle
+// count with -C.
+
+#include <emu816.h>
+#include <emu816_lockstep.h>
+#include <emu816_trace.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+
+// Instructions kept to show what led up to a difference
+const size_t s_history = 64;
+
+// Instructions of the history printed with a difference
+const size_t s_shown = 16;
+
+// The ways of running a processor
+struct ENGINE {
+    const char *            name;
+    emu816_engine_t         engine;
+    bool                    cache;
+    bool                    jit;
+    bool                    lockstep;
+};
+
+const ENGINE s_engines[] = {
+    { "switch",         EMU816_ENGINE_SWITCH,   false,  false,  false },
+    { "switch_cache",   EMU816_ENGINE_SWITCH,   true,   false,  false },
+    { "switch_jit",     EMU816_ENGINE_SWITCH,   true,   true,   false },
+    { "threaded",       EMU816_ENGINE_THREADED, false,  false,  false },
+    { "threaded_cache", EMU816_ENGINE_THREADED, true,   false,  false },
+    { "threaded_jit",   EMU816_ENGINE_THREADED, true,   true,   false },
+    { "lockstep",       EMU816_ENGINE_SWITCH,   false,  false,  true  }
+};
+
+const ENGINE *find_engine(const char *name)
+{
+    for (size_t n = 0; n < sizeof(s_engines) / sizeof(s_engines[0]); ++n)
+        if (!strcmp(s_engines[n].name, name)) return (&s_engines[n]);
+    return (NULL);
+}
+
+// The registers and flags compared
+struct STATE {
+    uint16_t                a, x, y, sp, dp, pc;
+    uint8_t                 pbr, dbr, p, e;
+};
+
+// Step a xorshift generator, which must not start at zero
+uint32_t next_random(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state);
+}
+
+// A store made by the processor
+struct WRITE {
+    emu816_addr_t           ea;
+    uint8_t                 data;
+};
+
+// The whole address space as host memory, mapped read-only so that every
+// store reaches store8() to be logged. Stores to code that has been
+// decoded invalidate it, as they would for writable memory.
+class machine : public emu816
+{
+    public:
+
+        machine()
+        : m_memory(1 << 24, 0)
+        , m_nmi(EMU816_NO_EVENT)
+        , m_period(0)
+        {
+            map_memory(0, 1 << 24, &m_memory[0], EMU816_MAP_ROM);
+        }
+
+        bool configure(const ENGINE &engine)
+        {
+            if (!set_engine(engine.engine)) return (false);
+            enable_block_cache(engine.cache);
+            return (!engine.jit || enable_jit(true));
+        }
+
+        // Load memory from the host, forgetting any code decoded from it
+        void load(emu816_addr_t ea, const uint8_t *data, size_t size)
+        {
+            for (size_t n = 0; n < size; ++n)
+                m_memory[(ea + n) & 0xffffff] = data[n];
+            invalidate_code(ea, (uint32_t)size);
+        }
+
+        void start(uint32_t entry, uint32_t period, uint32_t seed)
+        {
+            reset(entry);
+            a.w = x.w = y.w = 0;
+            if (seed) {
+                a.w = next_random(seed);
+                x.w = next_random(seed);
+                y.w = next_random(seed);
+            }
+            if (period) {
+                m_period = period;
+                m_nmi = add_event(nmi, this);
+                schedule(m_nmi, period);
+            }
+        }
+
+        void get(STATE &s)
+        {
+            s.a = a.w; s.x = x.w; s.y = y.w; s.sp = sp.w; s.dp = dp.w; s.pc = pc;
+            s.pbr = pbr; s.dbr = dbr; s.p = get_p(); s.e = e;
+        }
+
+        void set(const STATE &s)
+        {
+            e = s.e;
+            set_p(s.p);
+            a.w = s.a; x.w = s.x; y.w = s.y; sp.w = s.sp; dp.w = s.dp; pc = s.pc;
+            pbr = s.pbr; dbr = s.dbr;
+        }
+
+        // Describe the next instruction and the registers before it
+        void record(emu816_trace_t &r)
+        {
+            r.cycles = cycles();
+            r.pc = join(pbr, pc);
+            r.ea = EMU816_INVALID_PC;
+            r.a = a.w; r.x = x.w; r.y = y.w; r.sp = sp.w; r.dp = dp.w;
+            r.dbr = dbr; r.p = get_p(); r.e = e;
+            r.opcode = m_memory[r.pc];
+            for (int n = 0; n < 3; ++n)
+                r.operand[n] = m_memory[join(pbr, (uint16_t)(pc + 1 + n))];
+        }
+
+        uint8_t memory(emu816_addr_t ea) { return (m_memory[ea & 0xffffff]); }
+        std::vector<WRITE> &writes() { return (m_writes); }
+
+        uint8_t load8(emu816_addr_t ea)
+            { return (m_memory[ea & 0xffffff]); }
+        void store8(emu816_addr_t ea, uint8_t data)
+            { WRITE w = { ea & 0xffffff, data };
+              m_writes.push_back(w);
+              m_memory[w.ea] = data;
+              invalidate_code(w.ea, 1); }
+        uint16_t load16(emu816_addr_t ea)
+            { return (load8(ea) | (load8(ea + 1) << 8)); }
+        void store16(emu816_addr_t ea, uint16_t data)
+            { store8(ea, data); store8(ea + 1, data >> 8); }
+        emu816_addr_t load24(emu816_addr_t ea)
+            { return (load8(ea) | (load8(ea + 1) << 8) | (load8(ea + 2) << 16)); }
+
+    private:
+
+        std::vector<uint8_t>    m_memory;
+        std::vector<WRITE>      m_writes;
+        emu816_event_t          m_nmi;
+        uint32_t                m_period;
+
+        static void nmi(void *context, uint64_t deadline)
+            { machine *m = (machine *)context;
+              m->raise_nmi();
+              m->schedule(m->m_nmi, deadline + m->m_period); }
+};
+
+// Append a line to a report for each register that differs
+void compare(const STATE &l, const STATE &r, std::string &report)
+{
+    char line[64];
+
+#define EMU816_COMPARE(reg, digits) \
+    if (l.reg != r.reg) { \
+        snprintf(line, sizeof(line), "  %-4s %0*X != %0*X\n", #reg, digits, l.reg, digits, r.reg); \
+        report += line; \
+    }
+
+    EMU816_COMPARE(a, 4) EMU816_COMPARE(x, 4) EMU816_COMPARE(y, 4)
+    EMU816_COMPARE(sp, 4) EMU816_COMPARE(dp, 4) EMU816_COMPARE(pc, 4)
+    EMU816_COMPARE(pbr, 2) EMU816_COMPARE(dbr, 2) EMU816_COMPARE(p, 2)
+    EMU816_COMPARE(e, 1)
+
+#undef EMU816_COMPARE
+}
+
+// Append the first difference between two write logs to a report
+void compare(const std::vector<WRITE> &l, const std::vector<WRITE> &r, std::string &report)
+{
+    char line[80];
+
+    for (size_t n = 0; n < l.size() || n < r.size(); ++n) {
+        if (n < l.size() && n < r.size() && l[n].ea == r[n].ea && l[n].data == r[n].data)
+            continue;
+        if (n >= r.size())
+            snprintf(line, sizeof(line), "  write %zu: %06X=%02X != none\n", n, l[n].ea, l[n].data);
+        else if (n >= l.size())
+            snprintf(line, sizeof(line), "  write %zu: none != %06X=%02X\n", n, r[n].ea, r[n].data);
+        else
+            snprintf(line, sizeof(line), "  write %zu: %06X=%02X != %06X=%02X\n",
+                n, l[n].ea, l[n].data, r[n].ea, r[n].data);
+        report += line;
+        return;
+    }
+}
+
+// Print a recorded instruction in raw form, as a dump would hold it
+void print(const emu816_trace_t &r)
+{
+    printf("  %02X:%04X  %02X %02X %02X %02X  A=%04X X=%04X Y=%04X S=%04X D=%04X B=%02X P=%02X E=%d CYC=%llu\n",
+        r.pc >> 16, r.pc & 0xffff, r.opcode, r.operand[0], r.operand[1], r.operand[2],
+        r.a, r.x, r.y, r.sp, r.dp, r.dbr, r.p, r.e, (unsigned long long)r.cycles);
+}
+
+// Read an image, or make one of random code when given a seed
+bool read_image(const char *path, uint32_t &seed, std::vector<uint8_t> &image)
+{
+    FILE *file;
+    int c;
+
+    if (seed) {
+        uint32_t state = seed;
+
+        for (size_t n = 0; n < 0x10000; ++n) {
+            uint8_t opcode = (uint8_t)(next_random(state) >> 24);
+
+            if (opcode == 0xdb || opcode == 0xcb || opcode == 0x42) opcode = 0xea;
+            image.push_back(opcode);
+        }
+        seed = state;
+        return (true);
+    }
+    if ((file = fopen(path, "rb")) == NULL) {
+        perror(path);
+        return (false);
+    }
+    while ((c = fgetc(file)) != EOF) image.push_back((uint8_t)c);
+    fclose(file);
+    return (true);
+}
+
+// Run an image on two engines, comparing them after every interval
+int check(const ENGINE &first, const ENGINE &second, const char *path, uint32_t seed,
+    uint32_t load, uint32_t entry, uint64_t cycles, uint64_t interval, uint32_t period,
+    const char *dump)
+{
+    machine ref, cand;
+    std::vector<uint8_t> code;
+    emu816_lockstep lockstep;
+    emu816_trace_t history[s_history];
+    uint64_t steps = 0;
+    FILE *file;
+
+    if (!read_image(path, seed, code)) return (2);
+
+    if (!ref.configure(first) || !cand.configure(second)) {
+        fprintf(stderr, "engine not available in this build\n");
+        return (2);
+    }
+    ref.load(load, code.data(), code.size());
+    cand.load(load, code.data(), code.size());
+    ref.start(entry, period, seed);
+    cand.start(entry, period, seed);
+    if (second.lockstep) lockstep.add(&cand);
+
+    while (ref.cycles() < cycles) {
+        ref.record(history[steps++ % s_history]);
+
+        emu816_stop_t stop = ref.run_for(interval);
+
+        if (second.lockstep)
+            lockstep.run_for(interval);
+        else
+            cand.run_for(interval);
+
+        STATE l, r;
+        std::string report;
+        char line[80];
+
+        ref.get(l);
+        cand.get(r);
+        compare(l, r, report);
+        if (ref.cycles() != cand.cycles()) {
+            snprintf(line, sizeof(line), "  cycles %llu != %llu\n",
+                (unsigned long long)ref.cycles(), (unsigned long long)cand.cycles());
+            report += line;
+        }
+        if (stop != cand.stop_reason()) {
+            snprintf(line, sizeof(line), "  stopped %d != %d\n", stop, cand.stop_reason());
+            report += line;
+        }
+        compare(ref.writes(), cand.writes(), report);
+
+        if (!report.empty()) {
+            size_t shown = steps < s_shown ? steps : s_shown;
+
+            printf("%s and %s differ after %llu cycles (%s first):\n%s",
+                first.name, second.name, (unsigned long long)ref.cycles(), first.name,
+                report.c_str());
+            printf("leading up to it:\n");
+            for (size_t n = steps - shown; n < steps; ++n)
+                print(history[n % s_history]);
+
+            if (dump && (file = fopen(dump, "wb")) != NULL) {
+                size_t kept = steps < s_history ? steps : s_history;
+                emu816_trace ring(kept);
+
+                for (size_t n = steps - kept; n < steps; ++n) {
+                    *ring.reserve() = history[n % s_history];
+                    ring.commit();
+                }
+                ring.dump(file);
+                fclose(file);
+            }
+            return (1);
+        }
+        ref.writes().clear();
+        cand.writes().clear();
+        if (stop != EMU816_STOP_BUDGET) break;
+    }
+    printf("%s and %s agree over %llu cycles\n", first.name, second.name,
+        (unsigned long long)ref.cycles());
+    return (0);
+}
+
+// Just enough of JSON to read test vectors
+struct JSON {
+    enum { NUMBER, STRING, ARRAY, OBJECT, OTHER } type;
+    double                  number;
+    std::string             text;
+    std::vector<JSON>       items;          // of an array, or values of an object
+    std::vector<std::string> keys;
+
+    const JSON *get(const char *key) const
+    {
+        for (size_t n = 0; n < keys.size(); ++n)
+            if (keys[n] == key) return (&items[n]);
+        return (NULL);
+    }
+
+    uint32_t value(const char *key) const
+    {
+        const JSON *v = get(key);
+
+        return ((v && v->type == NUMBER) ? (uint32_t)v->number : 0);
+    }
+};
+
+class reader
+{
+    public:
+
+        reader(FILE *file) : m_file(file) { }
+
+        bool value(JSON &v);
+        bool next(int &c) { c = skip(); return (c != EOF); }
+
+    private:
+
+        FILE *              m_file;
+
+        int                 skip()
+                                { int c;
+                                  while ((c = getc(m_file)) != EOF && (isspace(c) || c == ','
+                                            || c == ':')) ;
+                                  return (c); }
+        bool                string(std::string &text);
+};
+
+// Read a string after its opening quote
+bool reader::string(std::string &text)
+{
+    int c;
+
+    text.clear();
+    while ((c = getc(m_file)) != EOF && c != '"') {
+        if (c == '\\') c = getc(m_file);
+        text += (char)c;
+    }
+    return (c == '"');
+}
+
+// Read a value, taking separators loosely
+bool reader::value(JSON &v)
+{
+    int c = skip();
+
+    v.items.clear();
+    v.keys.clear();
+    if (c == '[' || c == '{') {
+        bool object = (c == '{');
+
+        v.type = object ? JSON::OBJECT : JSON::ARRAY;
+        while ((c = skip()) != EOF && c != (object ? '}' : ']')) {
+            if (object) {
+                v.keys.push_back(std::string());
+                if (c != '"' || !string(v.keys.back())) return (false);
+            }
+            else
+                ungetc(c, m_file);
+            v.items.push_back(JSON());
+            if (!value(v.items.back())) return (false);
+        }
+        return (c != EOF);
+    }
+    if (c == '"') {
+        v.type = JSON::STRING;
+        return (string(v.text));
+    }
+    if (c == '-' || isdigit(c)) {
+        std::string text(1, (char)c);
+
+        while ((c = getc(m_file)) != EOF && (isdigit(c) || strchr("+-.eE", c)))
+            text += (char)c;
+        if (c != EOF) ungetc(c, m_file);
+        v.type = JSON::NUMBER;
+        v.number = strtod(text.c_str(), NULL);
+        return (true);
+    }
+    if (isalpha(c)) {
+        while ((c = getc(m_file)) != EOF && isalpha(c)) ;
+        if (c != EOF) ungetc(c, m_file);
+        v.type = JSON::OTHER;
+        return (true);
+    }
+    return (false);
+}
+
+// Set a processor to a test's initial or expected state
+void state(const JSON &test, STATE &s)
+{
+    s.a = test.value("a"); s.x = test.value("x"); s.y = test.value("y");
+    s.sp = test.value("s"); s.dp = test.value("d"); s.pc = test.value("pc");
+    s.pbr = test.value("pbr"); s.dbr = test.value("dbr");
+    s.p = test.value("p"); s.e = test.value("e");
+}
+
+// The outcome of one file of test vectors
+struct RESULT {
+    uint64_t                passed;
+    uint64_t                failed;
+    std::string             report;         // about the first failure
+};
+
+// Run every test in a file on a processor
+void run_vectors(machine &m, const char *path, bool cycles, RESULT &result)
+{
+    FILE *file = fopen(path, "r");
+    JSON test;
+    int c;
+
+    result.passed = result.failed = 0;
+    if (!file) {
+        result.report = std::string("  cannot open ") + path + "\n";
+        ++result.failed;
+        return;
+    }
+
+    reader in(file);
+
+    if (!in.next(c) || c != '[') {
+        result.report = "  not an array of tests\n";
+        ++result.failed;
+    }
+    else while (in.value(test) && test.type == JSON::OBJECT) {
+        const JSON *initial = test.get("initial");
+        const JSON *final = test.get("final");
+        const JSON *bus = test.get("cycles");
+        const JSON *ram;
+        STATE start, want, got;
+        std::string report;
+        char line[80];
+
+        if (!initial || !final) break;
+        state(*initial, start);
+        state(*final, want);
+
+        m.reset(start.pc);
+        m.set(start);
+        if ((ram = initial->get("ram")) != NULL) {
+            for (size_t n = 0; n < ram->items.size(); ++n) {
+                const JSON &cell = ram->items[n];
+
+                if (cell.items.size() < 2) continue;
+
+                uint8_t data = (uint8_t)cell.items[1].number;
+
+                m.load((uint32_t)cell.items[0].number, &data, 1);
+            }
+        }
+
+        m.run_for(1);
+
+        m.get(got);
+        compare(got, want, report);
+        if ((ram = final->get("ram")) != NULL) {
+            for (size_t n = 0; n < ram->items.size(); ++n) {
+                const JSON &cell = ram->items[n];
+
+                if (cell.items.size() < 2) continue;
+
+                uint32_t ea = (uint32_t)cell.items[0].number;
+                uint8_t data = (uint8_t)cell.items[1].number;
+
+                if (m.memory(ea) != data) {
+                    snprintf(line, sizeof(line), "  ram %06X %02X != %02X\n", ea, m.memory(ea), data);
+                    report += line;
+                }
+            }
+        }
+        if (cycles && bus && m.cycles() != bus->items.size()) {
+            snprintf(line, sizeof(line), "  cycles %llu != %zu\n",
+                (unsigned long long)m.cycles(), bus->items.size());
+            report += line;
+        }
+        m.writes().clear();
+
+        if (report.empty())
+            ++result.passed;
+        else if (result.failed++ == 0) {
+            const JSON *name = test.get("name");
+
+            result.report = "  first failure";
+            if (name && name->type == JSON::STRING) result.report += " \"" + name->text + "\"";
+            result.report += ", emulator != expected:\n" + report;
+        }
+    }
+    fclose(file);
+}
+
+// The files of test vectors shared out between threads
+struct VECTORS {
+    const ENGINE *          engine;
+    char **                 paths;
+    int                     files;
+    bool                    cycles;
+    std::atomic<int>        next;
+    std::atomic<bool>       available;
+    std::vector<RESULT>     results;
+};
+
+// Take files to run until there are none left
+void worker(VECTORS *v)
+{
+    machine *m = new machine;
+    int f;
+
+    if (!m->configure(*v->engine))
+        v->available = false;
+    else {
+        while ((f = v->next.fetch_add(1)) < v->files)
+            run_vectors(*m, v->paths[f], v->cycles, v->results[f]);
+    }
+    delete m;
+}
+
+// Run files of test vectors on a number of threads, reporting in order
+int vectors(const ENGINE &engine, char **paths, int files, int jobs, bool cycles)
+{
+    std::vector<std::thread> workers;
+    VECTORS v;
+    uint64_t passed = 0, failed = 0;
+
+    v.engine = &engine;
+    v.paths = paths;
+    v.files = files;
+    v.cycles = cycles;
+    v.next = 0;
+    v.available = true;
+    v.results.resize(files);
+
+    for (int j = 0; j < jobs && j < files; ++j)
+        workers.push_back(std::thread(worker, &v));
+    for (size_t j = 0; j < workers.size(); ++j)
+        workers[j].join();
+
+    std::vector<RESULT> &results = v.results;
+
+    if (!v.available) {
+        fprintf(stderr, "engine not available in this build\n");
+        return (2);
+    }
+
+    for (int f = 0; f < files; ++f) {
+        passed += results[f].passed;
+        failed += results[f].failed;
+        if (results[f].failed) {
+            printf("%s: %llu of %llu failed\n%s", paths[f], (unsigned long long)results[f].failed,
+                (unsigned long long)(results[f].passed + results[f].failed), results[f].report.c_str());
+        }
+    }
+    printf("%s: %llu passed, %llu failed\n", engine.name,
+        (unsigned long long)passed, (unsigned long long)failed);
+    return (failed ? 1 : 0);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    const ENGINE *first = find_engine("switch");
+    const ENGINE *second = find_engine("switch_jit");
+    const ENGINE *tested = find_engine("switch");
+    uint32_t load = 0x1000, entry = EMU816_INVALID_PC, period = 0, seed = 0;
+    uint64_t cycles = 10000000, interval = 1;
+    int jobs = (int)std::thread::hardware_concurrency();
+    bool tests = false, bus = false;
+    const char *dump = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "1:2:E:a:e:c:b:n:t:r:j:vC")) != -1) {
+        switch (opt) {
+        case '1':   first = find_engine(optarg);    break;
+        case '2':   second = find_engine(optarg);   break;
+        case 'E':   tested = find_engine(optarg);   break;
+        case 'a':   load = strtoul(optarg, NULL, 0);        break;
+        case 'e':   entry = strtoul(optarg, NULL, 0);       break;
+        case 'c':   cycles = strtoull(optarg, NULL, 0);     break;
+        case 'b':   interval = strtoull(optarg, NULL, 0);   break;
+        case 'n':   period = strtoul(optarg, NULL, 0);      break;
+        case 't':   dump = optarg;                  break;
+        case 'r':   seed = strtoul(optarg, NULL, 0);        break;
+        case 'j':   jobs = atoi(optarg);            break;
+        case 'v':   tests = true;                   break;
+        case 'C':   bus = true;                     break;
+        default:    return (2);
+        }
+    }
+    if (!first || !second || !tested || interval == 0 || (optind >= argc && (tests || !seed))) {
+        fprintf(stderr, "usage: emu816_diffcheck [-1 engine] [-2 engine] [-a load] [-e entry]\n"
+                        "           [-c cycles] [-b interval] [-n period] [-t dump] image\n"
+                        "       emu816_diffcheck -r seed [options as above]\n"
+                        "       emu816_diffcheck -v [-j jobs] [-E engine] [-C] vectors.json...\n"
+                        "engines: switch, switch_cache, switch_jit, threaded, threaded_cache,\n"
+                        "         threaded_jit, lockstep\n");
+        return (2);
+    }
+
+    if (tests)
+        return (vectors(*tested, argv + optind, argc - optind, jobs < 1 ? 1 : jobs, bus));
+    return (check(*first, *second, seed ? NULL : argv[optind], seed, load,
+        entry == EMU816_INVALID_PC ? load : entry, cycles, interval, period, dump));
+}
@@ -0,0 +1,189 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo
+//                                         d88'   `8. o888    .88'
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo.
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'
+//
+// A Portable C++ WDC 65C816 Emulator
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// Reverse execution from checkpoints.
+//
+// A checkpoint is a snapshot taken by an event at the end of each interval.
+// Any earlier instruction boundary is reached by loading the checkpoint
+// before it and running forward. To find the boundary before the current
+// one, or the last at a given address, the interval leading up to it is run
+// one instruction at a time from its checkpoint, and the one before that if
+// need be. The processor then goes back to the checkpoint and runs straight
+// to the boundary found, and checkpoints later than it are dropped.
+//
+// The instruction boundaries of a run are identified by their cycle counts,
+// which only ever increase, so the history starts again if the clock goes
+// back, e.g. after reset().
+
+#include <emu816.h>
+
+// Start keeping checkpoints, the first of them now. Returns false if no
+// event is free.
+bool emu816::enable_history(size_t checkpoints, uint64_t interval)
+{
+    if (m_history == EMU816_NO_EVENT) {
+        m_history = add_event(checkpoint_event, this);
+        if (m_history == EMU816_NO_EVENT) return (false);
+    }
+    m_max_checkpoints = (checkpoints < 2) ? 2 : checkpoints;
+    m_interval = interval ? interval : 1;
+    m_checkpoints.clear();
+    checkpoint();
+    return (true);
+}
+
+// Stop keeping checkpoints and release them
+void emu816::disable_history()
+{
+    if (m_history != EMU816_NO_EVENT) remove_event(m_history);
+    m_history = EMU816_NO_EVENT;
+    std::vector<CHECKPOINT>().swap(m_checkpoints);
+}
+
+// Take a checkpoint now, thinning out the older ones if the history is
+// full, and schedule the next
+void emu816::checkpoint()
+{
+    if (m_history == EMU816_NO_EVENT) return;
+
+    if (!m_checkpoints.empty() && m_checkpoints.back().cycles > m_cycles)
+        m_checkpoints.clear();
+    if (!m_checkpoints.empty() && m_checkpoints.back().cycles == m_cycles)
+        m_checkpoints.pop_back();
+
+    if (m_checkpoints.size() >= m_max_checkpoints) {
+        size_t kept = 0;
+
+        for (size_t n = 0; n < m_checkpoints.size(); n += 2, ++kept) {
+            m_checkpoints[kept].cycles = m_checkpoints[n].cycles;
+            m_checkpoints[kept].state.swap(m_checkpoints[n].state);
+        }
+        m_checkpoints.resize(kept);
+        m_interval *= 2;
+    }
+
+    // The snapshot includes the next checkpoint, so that it is taken again
+    // after the snapshot is loaded
+    schedule(m_history, m_cycles + m_interval);
+    m_checkpoints.push_back(CHECKPOINT());
+    m_checkpoints.back().cycles = m_cycles;
+    save_state(m_checkpoints.back().state);
+}
+
+void emu816::checkpoint_event(void *context, uint64_t)
+{
+    emu816 *cpu = (emu816 *)context;
+
+    if (cpu->m_travelling)
+        cpu->schedule(cpu->m_history, cpu->m_cycles + cpu->m_interval);
+    else
+        cpu->checkpoint();
+}
+
+// Go back to the previous instruction boundary
+bool emu816::step_back()
+{
+    return (go_back(EMU816_INVALID_PC));
+}
+
+// Go back to the last time the instruction at an address was about to be
+// executed
+bool emu816::run_back_to(emu816_addr_t ea)
+{
+    return (go_back(ea & 0xffffff));
+}
+
+// Go back to the boundary found by find_back(), or stay in the present
+// if there is none
+bool emu816::go_back(emu816_addr_t ea)
+{
+    std::vector<uint8_t> present;
+    uint64_t found;
+
+    if (m_checkpoints.empty()) return (false);
+
+    save_state(present);
+    if (!find_back(ea, found)) {
+        load_state(present);
+        return (false);
+    }
+    travel_to(found);
+    while (m_checkpoints.size() > 1 && m_checkpoints.back().cycles > m_cycles)
+        m_checkpoints.pop_back();
+    return (true);
+}
+
+// Find the latest boundary before the current one at which the next
+// instruction is at ea, or any boundary for EMU816_INVALID_PC, searching
+// back an interval at a time. Leaves the processor at an unknown point.
+bool emu816::find_back(emu816_addr_t ea, uint64_t &found)
+{
+    uint64_t end = m_cycles;
+    bool hit = false;
+
+    m_travelling = true;
+    for (size_t n = m_checkpoints.size(); n > 0 && !hit; --n) {
+        const CHECKPOINT &point = m_checkpoints[n - 1];
+
+        if (point.cycles >= end) continue;
+        load_state(point.state);
+        while (m_cycles < end) {
+            if (ea == EMU816_INVALID_PC || (!m_idle && join(pbr, pc) == ea)) {
+                found = m_cycles;
+                hit = true;
+            }
+            if (!advance(end)) break;
+        }
+        end = point.cycles;
+    }
+    m_travelling = false;
+    return (hit);
+}
+
+// Advance to the next instruction boundary as run_for() would, firing the
+// events that are due. A waiting processor moves on to its next event, or
+// to the limit if that is sooner. Returns false if it cannot advance.
+bool emu816::advance(uint64_t limit)
+{
+    uint64_t start = m_cycles;
+    uint64_t until = m_cycles + 1;
+
+    if (m_idle) {
+        if (m_scheduled && m_events[m_heap[0]].deadline < limit)
+            limit = m_events[m_heap[0]].deadline;
+        if (limit > until) until = limit;
+    }
+    run_for(until - m_cycles);
+    return (m_cycles != start);
+}
+
+// Load the latest checkpoint at or before a boundary and run forward to it
+void emu816::travel_to(uint64_t cycles)
+{
+    size_t n = m_checkpoints.size();
+
+    while (n > 1 && m_checkpoints[n - 1].cycles > cycles) --n;
+
+    m_travelling = true;
+    load_state(m_checkpoints[n - 1].state);
+    if (m_cycles < cycles) run_for(cycles - m_cycles);
+    m_travelling = false;
+}
@@ -0,0 +1,1299 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo
+//                                         d88'   `8. o888    .88'
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo.
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'
+//
+// A Portable C++ WDC 65C816 Emulator
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// A dynamic recompiler that translates hot blocks from the decoded block
+// cache into x86-64 code.
+//
+// Translated code works directly on the registers held in the emu816 object
+// (pointed to by RBX) so the processor state is exact at every instruction
+// boundary. Memory and stack accesses call back into the same paths as the
+// interpreter. Translation stops at the first instruction that is not
+// supported, or when decimal mode is set for ADC/SBC, leaving the
+// interpreter to execute it. A block also exits early if a store hits
+// cached code, an interrupt becomes pending or the processor is stopped.
+
+#include <emu816.h>
+#include <emu816_opcodes.h>
+#include <string.h>
+
+#if defined(EMU816_JIT)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+struct emu816::JIT {
+    uint8_t *               arena;
+    size_t                  used;
+};
+
+#if defined(EMU816_JIT)
+
+namespace {
+
+// Operations and addressing modes
+enum {
+    OP_adc, OP_and, OP_asl, OP_asla, OP_bcc, OP_bcs, OP_beq, OP_bit, OP_biti,
+    OP_bmi, OP_bne, OP_bpl, OP_bra, OP_brk, OP_brl, OP_bvc, OP_bvs, OP_clc,
+    OP_cld, OP_cli, OP_clv, OP_cmp, OP_cop, OP_cpx, OP_cpy, OP_dec, OP_deca,
+    OP_dex, OP_dey, OP_eor, OP_inc, OP_inca, OP_inx, OP_iny, OP_jmp, OP_jsl,
+    OP_jsr, OP_lda, OP_ldx, OP_ldy, OP_lsr, OP_lsra, OP_mvn, OP_mvp, OP_nop,
+    OP_ora, OP_pea, OP_pei, OP_per, OP_pha, OP_phb, OP_phd, OP_phk, OP_php,
+    OP_phx, OP_phy, OP_pla, OP_plb, OP_pld, OP_plp, OP_plx, OP_ply, OP_rep,
+    OP_rol, OP_rola, OP_ror, OP_rora, OP_rti, OP_rtl, OP_rts, OP_sbc, OP_sec,
+    OP_sed, OP_sei, OP_sep, OP_sta, OP_stp, OP_stx, OP_sty, OP_stz, OP_tax,
+    OP_tay, OP_tcd, OP_tcs, OP_tdc, OP_trb, OP_tsb, OP_tsc, OP_tsx, OP_txa,
+    OP_txs, OP_txy, OP_tya, OP_tyx, OP_wai, OP_wdm, OP_xba, OP_xce
+};
+
+enum {
+    AM_abil, AM_absi, AM_absl, AM_absx, AM_absy, AM_abxi, AM_acc, AM_alng,
+    AM_alnx, AM_dily, AM_dpag, AM_dpgi, AM_dpgx, AM_dpgy, AM_dpil, AM_dpix,
+    AM_dpiy, AM_immb, AM_immm, AM_immw, AM_immx, AM_impl, AM_lrel, AM_rela,
+    AM_srel, AM_sriy
+};
+
+#define EMU816_JIT_OP(code, op, am, w, f)   OP_##op,
+#define EMU816_JIT_AM(code, op, am, w, f)   AM_##am,
+
+const uint8_t s_op[256] = { EMU816_OPCODES(EMU816_JIT_OP) };
+const uint8_t s_am[256] = { EMU816_OPCODES(EMU816_JIT_AM) };
+
+#undef EMU816_JIT_AM
+#undef EMU816_JIT_OP
+
+// Host registers (AH is only valid for byte operations)
+enum { EAX = 0, ECX = 1, EDX = 2, AH = 4, ESI = 6, R12 = 12 };
+
+// Arithmetic group, shift group and condition codes
+enum { ADD = 0, OR = 1, ADC = 2, AND = 4, SUB = 5, XOR = 6, CMP = 7 };
+enum { ROL = 0, ROR = 1, RCL = 2, RCR = 3, SHL = 4, SHR = 5 };
+enum { CC_O = 0, CC_C = 2, CC_Z = 4, CC_NZ = 5, CC_A = 7 };
+
+// Processor status bits held in p
+enum { P_D = 0x08 };
+
+// Emits x86-64 instructions. Memory operands are always [RBX + disp32].
+class emitter
+{
+    public:
+
+        emitter(uint8_t *code, size_t size)
+        : m_code(code), m_size(size), m_used(0)
+        { }
+
+        size_t          used() const { return (m_used); }
+        bool            overflow() const { return (m_used > m_size); }
+
+        void b(uint8_t value)
+        {
+            if (m_used < m_size) m_code[m_used] = value;
+            ++m_used;
+        }
+
+        void d(uint32_t value)
+        {
+            for (int n = 0; n < 4; ++n) b(value >> (8 * n));
+        }
+
+        void q(uint64_t value)
+        {
+            d((uint32_t)value);
+            d((uint32_t)(value >> 32));
+        }
+
+        void mem(uint8_t reg, int32_t disp)
+        {
+            b(0x83 | ((reg & 7) << 3));
+            d(disp);
+        }
+
+        void rr(uint8_t reg, uint8_t rm)
+        {
+            b(0xc0 | ((reg & 7) << 3) | (rm & 7));
+        }
+
+        void size16(int size)
+        {
+            if (size == 2) b(0x66);
+        }
+
+        // Zero extending load of a 1, 2 or 4 byte field
+        void load(uint8_t reg, int32_t disp, int size)
+        {
+            if (size == 1) { b(0x0f); b(0xb6); }
+            else if (size == 2) { b(0x0f); b(0xb7); }
+            else b(0x8b);
+            mem(reg, disp);
+        }
+
+        void store(int32_t disp, uint8_t reg, int size)
+        {
+            size16(size);
+            b(size == 1 ? 0x88 : 0x89);
+            mem(reg, disp);
+        }
+
+        void store_imm(int32_t disp, uint32_t imm, int size)
+        {
+            size16(size);
+            b(size == 1 ? 0xc6 : 0xc7);
+            mem(0, disp);
+            b(imm);
+            if (size > 1) b(imm >> 8);
+            if (size > 2) { b(imm >> 16); b(imm >> 24); }
+        }
+
+        void alu_mem8(uint8_t op, int32_t disp, uint8_t imm)
+        {
+            b(0x80);
+            mem(op, disp);
+            b(imm);
+        }
+
+        void test_mem8(int32_t disp, uint8_t imm)
+        {
+            b(0xf6);
+            mem(0, disp);
+            b(imm);
+        }
+
+        void add_mem64(int32_t disp, uint32_t imm)
+        {
+            b(0x48);
+            b(0x81);
+            mem(0, disp);
+            d(imm);
+        }
+
+        void add_mem64_reg(int32_t disp, uint8_t reg)
+        {
+            b(0x48);
+            b(0x01);
+            mem(reg, disp);
+        }
+
+        void mov_imm(uint8_t reg, uint32_t imm)
+        {
+            b(0xb8 + reg);
+            d(imm);
+        }
+
+        void mov(uint8_t dst, uint8_t src)
+        {
+            if ((dst | src) & 8) b(0x40 | ((src & 8) ? 4 : 0) | ((dst & 8) ? 1 : 0));
+            b(0x89);
+            rr(src, dst);
+        }
+
+        void alu(uint8_t op, uint8_t dst, uint8_t src, int size)
+        {
+            size16(size);
+            b(op * 8 + (size == 1 ? 0 : 1));
+            rr(src, dst);
+        }
+
+        void alu_imm(uint8_t op, uint8_t reg, uint32_t imm)
+        {
+            b(0x81);
+            rr(op, reg);
+            d(imm);
+        }
+
+        void test(uint8_t r1, uint8_t r2, int size)
+        {
+            size16(size);
+            b(size == 1 ? 0x84 : 0x85);
+            rr(r2, r1);
+        }
+
+        void not_(uint8_t reg, int size)
+        {
+            size16(size);
+            b(size == 1 ? 0xf6 : 0xf7);
+            rr(2, reg);
+        }
+
+        void incdec(bool dec, uint8_t reg, int size)
+        {
+            size16(size);
+            b(size == 1 ? 0xfe : 0xff);
+            rr(dec ? 1 : 0, reg);
+        }
+
+        void shift1(uint8_t op, uint8_t reg, int size)
+        {
+            size16(size);
+            b(size == 1 ? 0xd0 : 0xd1);
+            rr(op, reg);
+        }
+
+        void shift(uint8_t op, uint8_t reg, uint8_t count, int size)
+        {
+            size16(size);
+            b(size == 1 ? 0xc0 : 0xc1);
+            rr(op, reg);
+            b(count);
+        }
+
+        void setcc_mem(uint8_t cc, int32_t disp)
+        {
+            b(0x0f);
+            b(0x90 + cc);
+            mem(0, disp);
+        }
+
+        void setcc(uint8_t cc, uint8_t reg)
+        {
+            b(0x0f);
+            b(0x90 + cc);
+            rr(0, reg);
+        }
+
+        void cmp_mem16(int32_t disp, uint8_t imm)
+        {
+            b(0x66);
+            b(0x83);
+            mem(7, disp);
+            b(imm);
+        }
+
+        void movzx8(uint8_t reg)
+        {
+            b(0x0f);
+            b(0xb6);
+            rr(reg, reg);
+        }
+
+        // Forms used to look up the host memory tables: test a byte at
+        // [RBX + index + disp32], load a pointer from [RBX + index * 8 +
+        // disp32] and access [base + index]
+        void test_table8(int32_t disp, uint8_t index, uint8_t imm)
+        {
+            b(0xf6);
+            b(0x84);
+            b(((index & 7) << 3) | 3);
+            d(disp);
+            b(imm);
+        }
+
+        void load_table64(uint8_t reg, int32_t disp, uint8_t index)
+        {
+            b(0x48);
+            b(0x8b);
+            b(0x84 | ((reg & 7) << 3));
+            b(0xc0 | ((index & 7) << 3) | 3);
+            d(disp);
+        }
+
+        void test64(uint8_t r1, uint8_t r2)
+        {
+            b(0x48);
+            b(0x85);
+            rr(r2, r1);
+        }
+
+        void load_host(uint8_t reg, uint8_t base, uint8_t index, int size)
+        {
+            b(0x0f);
+            b(size == 1 ? 0xb6 : 0xb7);
+            b(0x04 | ((reg & 7) << 3));
+            b(((index & 7) << 3) | (base & 7));
+        }
+
+        void store_host(uint8_t base, uint8_t index, uint8_t reg, int size)
+        {
+            size16(size);
+            b(size == 1 ? 0x88 : 0x89);
+            b(0x04 | ((reg & 7) << 3));
+            b(((index & 7) << 3) | (base & 7));
+        }
+
+        void call(const void *fn)
+        {
+            b(0x48); b(0x89); b(0xdf);                  // mov rdi,rbx
+            b(0x48); b(0xb8); q((uintptr_t)fn);         // mov rax,fn
+            b(0xff); b(0xd0);                           // call rax
+        }
+
+        size_t jcc(uint8_t cc)
+        {
+            b(0x0f);
+            b(0x80 + cc);
+            d(0);
+            return (m_used - 4);
+        }
+
+        size_t jmp()
+        {
+            b(0xe9);
+            d(0);
+            return (m_used - 4);
+        }
+
+        void patch(size_t at, size_t target)
+        {
+            int32_t rel = (int32_t)(target - (at + 4));
+
+            if (at + 4 <= m_size) memcpy(m_code + at, &rel, 4);
+        }
+
+    private:
+
+        uint8_t *       m_code;
+        size_t          m_size;
+        size_t          m_used;
+};
+
+// Offsets of the processor state and the entry points used by translated
+// code, filled in by emu816::jit_compile().
+struct layout
+{
+    int32_t         a, x, y, sp, dp, p, pbr, dbr, pc;
+    int32_t         n, z, c, v;
+    int32_t         cycles, stopped, exit;
+    int32_t         read, write, watch;         // host memory page tables
+    uint8_t         watch_load;
+    const void *    load8, * load16, * store8, * store16;
+    const void *    push8, * push16, * pull8, * pull16;
+    const void *    cover;                      // NULL unless covering edges
+};
+
+// Translates one block
+class translator
+{
+    public:
+
+        translator(const layout &l, uint8_t *code, size_t size, bool e, uint32_t mode, bool calls)
+        : m_l(l), m_x(code, size), m_e(e)
+        , m_msize((mode & 1) ? 1 : 2), m_xsize((mode & 2) ? 1 : 2)
+        , m_pending(0), m_exits(0), m_max(0), m_closed(false), m_returns(0)
+        , m_calls(calls), m_cross(false), m_dl(false)
+        { }
+
+        size_t          used() const { return (m_x.used()); }
+        bool            overflow() const { return (m_x.overflow() || m_exits > MAX_EXITS); }
+        uint32_t        max_cycles() const { return (m_max); }
+        bool            closed() const { return (m_closed); }
+
+        void            prologue();
+        bool            supported(uint8_t opcode) const;
+        bool            translate(const uint8_t opcode, uint32_t operand, uint16_t addr, uint16_t next);
+        void            leave(uint16_t pc);
+        void            transfer(uint16_t pc);
+        void            finish();
+
+    private:
+
+        enum { MAX_EXITS = 3 * EMU816_BLOCK_LENGTH };
+
+        struct exit {
+            size_t          at;
+            uint16_t        pc;
+            uint32_t        cycles;
+        };
+
+        const layout &  m_l;
+        emitter         m_x;
+        bool            m_e;
+        int             m_msize;
+        int             m_xsize;
+        uint32_t        m_pending;
+        uint32_t        m_exits;
+        uint32_t        m_max;
+        bool            m_closed;
+        exit            m_exit[MAX_EXITS + 1];
+        size_t          m_epilogue[EMU816_BLOCK_LENGTH + MAX_EXITS + 1];
+        uint32_t        m_returns;
+        bool            m_calls;        // calls and returns may be translated
+        bool            m_cross;        // index page crossings cost a cycle
+        bool            m_dl;           // the low byte of D is known to be zero
+
+        static uint32_t mask(int size) { return (size == 1 ? 0xff : 0xffff); }
+
+        int             size_of(uint8_t op) const;
+
+        void            call(const void *fn);
+        void            load(int size);
+        void            store(int size);
+        void            flush();
+        void            exit_if(uint8_t cc, uint16_t pc);
+        void            check(uint16_t pc);
+        void            ret();
+        void            nz(int size, uint8_t reg = EAX);
+        void            ea(uint8_t am, uint32_t operand);
+        void            value(uint8_t am, uint32_t operand, int size);
+        void            branch(uint16_t next, uint16_t target, uint32_t cycles);
+        void            crossed();
+};
+
+// Width of the operation's operand
+int translator::size_of(uint8_t op) const
+{
+    switch (op) {
+    case OP_cpx: case OP_cpy: case OP_dex: case OP_dey: case OP_inx:
+    case OP_iny: case OP_ldx: case OP_ldy: case OP_phx: case OP_phy:
+    case OP_plx: case OP_ply: case OP_stx: case OP_sty: case OP_tax:
+    case OP_tay: case OP_txy: case OP_tyx:
+        return (m_xsize);
+    }
+    return (m_msize);
+}
+
+// Which instructions can be translated
+bool translator::supported(uint8_t opcode) const
+{
+    uint8_t am = s_am[opcode];
+
+    switch (s_op[opcode]) {
+    case OP_lda: case OP_ldx: case OP_ldy: case OP_adc: case OP_sbc:
+    case OP_and: case OP_ora: case OP_eor: case OP_cmp: case OP_cpx:
+    case OP_cpy: case OP_bit: case OP_biti:
+        if (am == AM_immm || am == AM_immx) return (true);
+        // Fall through
+    case OP_sta: case OP_stx: case OP_sty: case OP_stz:
+        switch (am) {
+        case AM_absl: case AM_absx: case AM_absy: case AM_alng: case AM_alnx:
+        case AM_dpag: case AM_dpgx: case AM_dpgy: case AM_dpgi: case AM_dpiy:
+        case AM_srel:
+            return (true);
+        }
+        return (false);
+
+    case OP_inc: case OP_dec:
+        return (am == AM_absl || am == AM_absx || am == AM_dpag || am == AM_dpgx);
+
+    case OP_inca: case OP_deca: case OP_inx: case OP_iny: case OP_dex:
+    case OP_dey: case OP_tax: case OP_tay: case OP_txa: case OP_tya:
+    case OP_txy: case OP_tyx: case OP_tdc: case OP_tsc: case OP_tcd:
+    case OP_tcs: case OP_txs: case OP_tsx: case OP_xba: case OP_asla:
+    case OP_lsra: case OP_rola: case OP_rora: case OP_clc: case OP_sec: case OP_cld: case OP_sed:
+    case OP_clv: case OP_nop: case OP_pha: case OP_pla: case OP_phx:
+    case OP_phy: case OP_plx: case OP_ply:
+    case OP_bcc: case OP_bcs: case OP_beq: case OP_bmi: case OP_bne:
+    case OP_bpl: case OP_bvc: case OP_bvs: case OP_bra: case OP_brl:
+        return (true);
+
+    case OP_jsl: case OP_rts: case OP_rtl:
+        return (m_calls);
+    case OP_jmp:
+        return (am == AM_absl || am == AM_alng);
+    case OP_jsr:
+        return (m_calls && am == AM_absl);
+    }
+    return (false);
+}
+
+void translator::prologue()
+{
+    m_x.b(0x53);                                // push rbx
+    m_x.b(0x41); m_x.b(0x54);                   // push r12
+    m_x.b(0x41); m_x.b(0x55);                   // push r13
+    m_x.b(0x48); m_x.b(0x89); m_x.b(0xfb);      // mov rbx,rdi
+}
+
+// Add the cycles charged so far to the counter
+void translator::flush()
+{
+    if (m_pending) {
+        m_x.add_mem64(m_l.cycles, m_pending);
+        m_pending = 0;
+    }
+}
+
+void translator::call(const void *fn)
+{
+    flush();
+    m_x.call(fn);
+}
+
+// Load a byte or word from the address in ESI into EAX. Mapped pages
+// without load watchpoints are read from host memory here, and anything
+// else goes through the load function.
+void translator::load(int size)
+{
+    size_t slow[3];
+    size_t done;
+    int n = 0;
+
+    flush();
+    m_x.mov(EAX, ESI);
+    m_x.shift(SHR, EAX, EMU816_PAGE_BITS, 4);
+    m_x.alu_imm(AND, EAX, EMU816_PAGES - 1);
+    m_x.test_table8(m_l.watch, EAX, m_l.watch_load);
+    slow[n++] = m_x.jcc(CC_NZ);
+    m_x.load_table64(EDX, m_l.read, EAX);
+    m_x.test64(EDX, EDX);
+    slow[n++] = m_x.jcc(CC_Z);
+    m_x.mov(ECX, ESI);
+    m_x.alu_imm(AND, ECX, EMU816_PAGE_SIZE - 1);
+    if (size == 2) {
+        m_x.alu_imm(CMP, ECX, EMU816_PAGE_SIZE - 1);
+        slow[n++] = m_x.jcc(CC_Z);
+    }
+    m_x.load_host(EAX, EDX, ECX, size);
+    done = m_x.jmp();
+
+    while (n) m_x.patch(slow[--n], m_x.used());
+    m_x.call(size == 1 ? m_l.load8 : m_l.load16);
+    m_x.patch(done, m_x.used());
+}
+
+// Store the byte or word in EDX at the address in ESI. Writable pages that
+// are not watched for any reason, such as holding decoded code, are written
+// here and anything else goes through the store function.
+void translator::store(int size)
+{
+    size_t slow[3];
+    size_t done;
+    int n = 0;
+
+    flush();
+    m_x.mov(EAX, ESI);
+    m_x.shift(SHR, EAX, EMU816_PAGE_BITS, 4);
+    m_x.alu_imm(AND, EAX, EMU816_PAGES - 1);
+    m_x.test_table8(m_l.watch, EAX, 0xff);
+    slow[n++] = m_x.jcc(CC_NZ);
+    m_x.load_table64(EAX, m_l.write, EAX);
+    m_x.test64(EAX, EAX);
+    slow[n++] = m_x.jcc(CC_Z);
+    m_x.mov(ECX, ESI);
+    m_x.alu_imm(AND, ECX, EMU816_PAGE_SIZE - 1);
+    if (size == 2) {
+        m_x.alu_imm(CMP, ECX, EMU816_PAGE_SIZE - 1);
+        slow[n++] = m_x.jcc(CC_Z);
+    }
+    m_x.store_host(EAX, ECX, EDX, size);
+    done = m_x.jmp();
+
+    while (n) m_x.patch(slow[--n], m_x.used());
+    m_x.call(size == 1 ? m_l.store8 : m_l.store16);
+    m_x.patch(done, m_x.used());
+}
+
+void translator::ret()
+{
+    m_epilogue[m_returns++] = m_x.jmp();
+}
+
+// Leave the block with the PC set to the given address
+void translator::leave(uint16_t pc)
+{
+    m_closed = true;
+    flush();
+    m_x.store_imm(m_l.pc, pc, 2);
+    ret();
+}
+
+// Leave the block after a transfer of control to the given address,
+// counting the edge if covering
+void translator::transfer(uint16_t pc)
+{
+    m_closed = true;
+    flush();
+    m_x.store_imm(m_l.pc, pc, 2);
+    if (m_l.cover) call(m_l.cover);
+    ret();
+}
+
+// Leave the block at pc if the condition holds
+void translator::exit_if(uint8_t cc, uint16_t pc)
+{
+    if (m_exits < MAX_EXITS) {
+        m_exit[m_exits].at = m_x.jcc(cc);
+        m_exit[m_exits].pc = pc;
+        m_exit[m_exits].cycles = m_pending;
+    }
+    ++m_exits;
+}
+
+// Leave after an instruction that called back into the emulator if the
+// processor was stopped or the block must be left, e.g. because a store hit
+// cached code or an interrupt is pending.
+void translator::check(uint16_t pc)
+{
+    m_x.alu_mem8(CMP, m_l.stopped, 0);
+    exit_if(CC_NZ, pc);
+    m_x.alu_mem8(CMP, m_l.exit, 0);
+    exit_if(CC_NZ, pc);
+}
+
+// Record a result for the lazily evaluated N and Z flags. The register must
+// be EAX, ECX or EDX.
+void translator::nz(int size, uint8_t reg)
+{
+    if (size == 1) {
+        m_x.movzx8(reg);
+        m_x.store(m_l.z, reg, 2);
+        m_x.store(m_l.n, reg, 1);
+    }
+    else {
+        m_x.store(m_l.z, reg, 2);
+        m_x.store(m_l.n, reg + AH, 1);
+    }
+}
+
+// Compute the effective address into ESI
+void translator::ea(uint8_t am, uint32_t operand)
+{
+    switch (am) {
+    case AM_absl:
+    case AM_absx:
+    case AM_absy:
+        m_x.load(ESI, m_l.dbr, 1);
+        m_x.shift(SHL, ESI, 16, 4);
+        m_x.alu_imm(OR, ESI, operand & 0xffff);
+        if (am != AM_absl) {
+            m_x.load(ECX, am == AM_absx ? m_l.x : m_l.y, 2);
+            m_x.alu(ADD, ESI, ECX, 4);
+            if (m_cross) {
+                m_x.mov_imm(EDX, operand & 0xff);
+                crossed();
+            }
+        }
+        break;
+
+    case AM_alng:
+    case AM_alnx:
+        m_x.mov_imm(ESI, operand & 0xffffff);
+        if (am == AM_alnx) {
+            m_x.load(ECX, m_l.x, 2);
+            m_x.alu(ADD, ESI, ECX, 4);
+        }
+        break;
+
+    case AM_dpag:
+    case AM_dpgi:
+        m_x.load(ESI, m_l.dp, 2);
+        m_x.alu_imm(ADD, ESI, operand & 0xff);
+        m_x.alu_imm(AND, ESI, 0xffff);
+        if (am == AM_dpgi) {
+            load(2);
+            m_x.load(ESI, m_l.dbr, 1);
+            m_x.shift(SHL, ESI, 16, 4);
+            m_x.alu(OR, ESI, EAX, 4);
+        }
+        break;
+
+    case AM_dpgx:
+    case AM_dpgy:
+        m_x.load(ECX, am == AM_dpgx ? m_l.x : m_l.y, 1);
+        m_x.alu_imm(ADD, ECX, operand & 0xff);
+        m_x.alu_imm(AND, ECX, 0xff);
+        m_x.load(ESI, m_l.dp, 2);
+        m_x.alu(ADD, ESI, ECX, 4);
+        m_x.alu_imm(AND, ESI, 0xffff);
+        break;
+
+    case AM_dpiy:
+        m_x.load(ESI, m_l.dp, 2);
+        m_x.alu_imm(ADD, ESI, operand & 0xff);
+        load(2);
+        m_x.load(ECX, m_l.y, 2);
+        if (m_cross) {
+            m_x.mov(EDX, EAX);
+            m_x.movzx8(EDX);
+            crossed();
+        }
+        m_x.alu(ADD, EAX, ECX, 4);
+        m_x.load(ESI, m_l.dbr, 1);
+        m_x.shift(SHL, ESI, 16, 4);
+        m_x.alu(OR, ESI, EAX, 4);
+        break;
+
+    case AM_srel:
+        if (m_e) {
+            m_x.load(ESI, m_l.sp, 1);
+            m_x.alu_imm(ADD, ESI, operand & 0xff);
+            m_x.alu_imm(AND, ESI, 0xff);
+            m_x.load(ECX, m_l.sp, 2);
+            m_x.alu_imm(AND, ECX, 0xff00);
+            m_x.alu(OR, ESI, ECX, 4);
+        }
+        else {
+            m_x.load(ESI, m_l.sp, 2);
+            m_x.alu_imm(ADD, ESI, operand & 0xff);
+            m_x.alu_imm(AND, ESI, 0xffff);
+        }
+        break;
+    }
+}
+
+// Charge a cycle if adding the index in ECX to the low byte of the base
+// address in EDX crosses a page. The index may be any 16-bit value, as the
+// high byte of X and Y survives XCE into emulation mode.
+void translator::crossed()
+{
+    m_x.alu(ADD, EDX, ECX, 4);
+    m_x.alu_imm(CMP, EDX, 0xff);
+    m_x.setcc(CC_A, EDX);
+    m_x.movzx8(EDX);
+    m_x.add_mem64_reg(m_l.cycles, EDX);
+}
+
+// Fetch an operand value into EAX
+void translator::value(uint8_t am, uint32_t operand, int size)
+{
+    if (am == AM_immm || am == AM_immx)
+        m_x.mov_imm(EAX, operand & mask(size));
+    else {
+        ea(am, operand);
+        load(size);
+    }
+}
+
+// Finish a conditional branch that has not been taken
+void translator::branch(uint16_t next, uint16_t target, uint32_t cycles)
+{
+    uint32_t taken = cycles + 1 + ((m_e && ((next ^ target) & 0xff00)) ? 1 : 0);
+
+    m_max += taken;
+    m_pending += taken;
+    transfer(target);
+}
+
+// Translate an instruction. Returns false if it is not supported.
+bool translator::translate(const uint8_t opcode, uint32_t operand, uint16_t addr, uint16_t next)
+{
+    uint8_t op = s_op[opcode];
+    uint8_t am = s_am[opcode];
+    int size = size_of(op);
+    uint32_t cycles = emu816_cycles(opcode, m_e, m_msize == 1, m_xsize == 1);
+    int32_t reg;
+
+    if (!supported(opcode)) return (false);
+
+    // Direct page accesses take a cycle longer when D is not page aligned,
+    // which is left to the interpreter
+    if ((emu816_timing[opcode] & EMU816_TIME_DL) && !m_dl) {
+        m_x.alu_mem8(CMP, m_l.dp, 0);
+        exit_if(CC_NZ, addr);
+        m_dl = true;
+    }
+    m_cross = (emu816_timing[opcode] & EMU816_TIME_IX) && m_xsize == 1;
+
+    // Conditional branches end the block
+    switch (op) {
+    case OP_bcc: case OP_bcs: case OP_beq: case OP_bmi:
+    case OP_bne: case OP_bpl: case OP_bvc: case OP_bvs:
+        {
+            uint8_t skip;
+
+            // Test the flag and find the condition for not branching
+            switch (op) {
+            case OP_bcc: m_x.test_mem8(m_l.c, 1); skip = CC_NZ; break;
+            case OP_bcs: m_x.test_mem8(m_l.c, 1); skip = CC_Z; break;
+            case OP_beq: m_x.cmp_mem16(m_l.z, 0); skip = CC_NZ; break;
+            case OP_bne: m_x.cmp_mem16(m_l.z, 0); skip = CC_Z; break;
+            case OP_bmi: m_x.test_mem8(m_l.n, 0x80); skip = CC_Z; break;
+            case OP_bpl: m_x.test_mem8(m_l.n, 0x80); skip = CC_NZ; break;
+            case OP_bvc: m_x.test_mem8(m_l.v, 1); skip = CC_NZ; break;
+            default:     m_x.test_mem8(m_l.v, 1); skip = CC_Z; break;
+            }
+
+            m_pending += cycles;
+            exit_if(skip, next);
+            m_pending -= cycles;
+            branch(next, (uint16_t)(next + (int8_t)operand), cycles);
+        }
+        return (true);
+
+    case OP_bra:
+        branch(next, (uint16_t)(next + (int8_t)operand), cycles);
+        return (true);
+    }
+
+    // Decimal mode arithmetic is left to the interpreter
+    if (op == OP_adc || op == OP_sbc) {
+        m_x.test_mem8(m_l.p, P_D);
+        exit_if(CC_NZ, addr);
+    }
+
+    m_pending += cycles;
+    m_max += cycles + m_cross;
+
+    switch (op) {
+    case OP_lda:
+        value(am, operand, size);
+        m_x.store(m_l.a, EAX, size);
+        nz(size);
+        break;
+
+    case OP_ldx:
+    case OP_ldy:
+        value(am, operand, size);
+        m_x.store(op == OP_ldx ? m_l.x : m_l.y, EAX, 2);
+        nz(size);
+        break;
+
+    case OP_and:
+    case OP_ora:
+    case OP_eor:
+        value(am, operand, size);
+        m_x.load(ECX, m_l.a, size);
+        m_x.alu(op == OP_and ? AND : op == OP_ora ? OR : XOR, ECX, EAX, size);
+        m_x.store(m_l.a, ECX, size);
+        nz(size, ECX);
+        break;
+
+    case OP_adc:
+    case OP_sbc:
+        value(am, operand, size);
+        m_x.mov(EDX, EAX);
+        if (op == OP_sbc) m_x.not_(EDX, size);
+        m_x.load(EAX, m_l.a, size);
+        m_x.load(ECX, m_l.c, 1);
+        m_x.shift1(SHR, ECX, 1);
+        m_x.alu(ADC, EAX, EDX, size);
+        m_x.setcc_mem(CC_C, m_l.c);
+        m_x.setcc_mem(CC_O, m_l.v);
+        m_x.store(m_l.a, EAX, size);
+        nz(size);
+        break;
+
+    case OP_cmp:
+    case OP_cpx:
+    case OP_cpy:
+        value(am, operand, size);
+        m_x.load(ECX, op == OP_cmp ? m_l.a : op == OP_cpx ? m_l.x : m_l.y, size);
+        m_x.alu(SUB, ECX, EAX, size);
+        m_x.setcc_mem(CC_C, m_l.c);
+        nz(size, ECX);
+        break;
+
+    case OP_bit:
+        value(am, operand, size);
+        m_x.load(ECX, m_l.a, size);
+        m_x.alu(AND, ECX, EAX, size);
+        m_x.store(m_l.z, ECX, 2);
+        m_x.store(m_l.n, size == 1 ? EAX : AH, 1);
+        m_x.mov(EDX, EAX);
+        m_x.shift(SHR, EDX, 8 * size - 2, 4);
+        m_x.alu_imm(AND, EDX, 1);
+        m_x.store(m_l.v, EDX, 1);
+        break;
+
+    case OP_biti:
+        value(am, operand, size);
+        m_x.load(ECX, m_l.a, size);
+        m_x.alu(AND, ECX, EAX, size);
+        m_x.store(m_l.z, ECX, 2);
+        break;
+
+    case OP_sta:
+    case OP_stx:
+    case OP_sty:
+    case OP_stz:
+        ea(am, operand);
+        if (op == OP_stz)
+            m_x.mov_imm(EDX, 0);
+        else
+            m_x.load(EDX, op == OP_sta ? m_l.a : op == OP_stx ? m_l.x : m_l.y, size);
+        store(size);
+        break;
+
+    case OP_inc:
+    case OP_dec:
+        ea(am, operand);
+        m_x.mov(R12, ESI);
+        load(size);
+        m_x.incdec(op == OP_dec, EAX, size);
+        nz(size);
+        m_x.mov(EDX, EAX);
+        m_x.mov(ESI, R12);
+        store(size);
+        break;
+
+    case OP_inca:
+    case OP_deca:
+    case OP_inx:
+    case OP_iny:
+    case OP_dex:
+    case OP_dey:
+        reg = (op == OP_inca || op == OP_deca) ? m_l.a :
+              (op == OP_inx || op == OP_dex) ? m_l.x : m_l.y;
+        m_x.load(EAX, reg, size);
+        m_x.incdec(op == OP_deca || op == OP_dex || op == OP_dey, EAX, size);
+        m_x.store(reg, EAX, size);
+        nz(size);
+        break;
+
+    case OP_tax:
+    case OP_tay:
+        m_x.load(EAX, m_l.a, size);
+        m_x.store(op == OP_tax ? m_l.x : m_l.y, EAX, 2);
+        nz(size);
+        break;
+
+    case OP_txy:
+    case OP_tyx:
+        m_x.load(EAX, op == OP_txy ? m_l.x : m_l.y, 2);
+        m_x.store(op == OP_txy ? m_l.y : m_l.x, EAX, 2);
+        nz(size);
+        break;
+
+    case OP_txa:
+    case OP_tya:
+        m_x.load(EAX, op == OP_txa ? m_l.x : m_l.y, size);
+        m_x.store(m_l.a, EAX, size);
+        nz(size);
+        break;
+
+    case OP_tdc:
+    case OP_tsc:
+        m_x.load(EAX, op == OP_tdc ? m_l.dp : m_l.sp, 2);
+        m_x.store(m_l.a, EAX, 2);
+        nz(size);
+        break;
+
+    case OP_tcd:
+        m_x.load(EAX, m_l.a, 2);
+        m_x.store(m_l.dp, EAX, 2);
+        m_dl = false;
+        break;
+
+    case OP_tcs:
+    case OP_txs:
+        reg = (op == OP_tcs) ? m_l.a : m_l.x;
+        if (m_e) {
+            m_x.load(EAX, reg, 1);
+            m_x.alu_imm(OR, EAX, 0x0100);
+        }
+        else
+            m_x.load(EAX, reg, 2);
+        m_x.store(m_l.sp, EAX, 2);
+        break;
+
+    case OP_tsx:
+        m_x.load(EAX, m_l.sp, m_e ? 1 : 2);
+        m_x.store(m_l.x, EAX, m_e ? 1 : 2);
+        nz(m_e ? 1 : 2);
+        break;
+
+    case OP_xba:
+        m_x.load(EAX, m_l.a, 2);
+        m_x.shift(ROL, EAX, 8, 2);
+        m_x.store(m_l.a, EAX, 2);
+        nz(1);
+        break;
+
+    case OP_asla:
+    case OP_lsra:
+        m_x.load(EAX, m_l.a, size);
+        m_x.shift1(op == OP_asla ? SHL : SHR, EAX, size);
+        m_x.setcc_mem(CC_C, m_l.c);
+        m_x.store(m_l.a, EAX, size);
+        nz(size);
+        break;
+
+    case OP_rola:
+    case OP_rora:
+        m_x.load(EAX, m_l.a, size);
+        m_x.load(ECX, m_l.c, 1);
+        m_x.shift1(SHR, ECX, 1);
+        m_x.shift1(op == OP_rola ? RCL : RCR, EAX, size);
+        m_x.setcc_mem(CC_C, m_l.c);
+        m_x.store(m_l.a, EAX, size);
+        nz(size);
+        break;
+
+    case OP_clc: m_x.store_imm(m_l.c, 0, 1); break;
+    case OP_sec: m_x.store_imm(m_l.c, 1, 1); break;
+    case OP_cld: m_x.alu_mem8(AND, m_l.p, (uint8_t)~P_D); break;
+    case OP_sed: m_x.alu_mem8(OR, m_l.p, P_D); break;
+    case OP_clv: m_x.store_imm(m_l.v, 0, 1); break;
+    case OP_nop: break;
+
+    case OP_pha:
+    case OP_phx:
+    case OP_phy:
+        m_x.load(ESI, op == OP_pha ? m_l.a : op == OP_phx ? m_l.x : m_l.y, size);
+        call(size == 1 ? m_l.push8 : m_l.push16);
+        break;
+
+    case OP_pla:
+        call(size == 1 ? m_l.pull8 : m_l.pull16);
+        m_x.store(m_l.a, EAX, size);
+        nz(size);
+        break;
+
+    case OP_plx:
+    case OP_ply:
+        call(size == 1 ? m_l.pull8 : m_l.pull16);
+        m_x.store(op == OP_plx ? m_l.x : m_l.y, EAX, 2);
+        nz(size);
+        break;
+
+    // Unconditional transfers end the block
+    case OP_brl:
+        transfer((uint16_t)(next + (int16_t)operand));
+        return (true);
+
+    case OP_jmp:
+        if (am == AM_absl) {
+            m_x.load(EAX, m_l.dbr, 1);
+            m_x.store(m_l.pbr, EAX, 1);
+        }
+        else
+            m_x.store_imm(m_l.pbr, (operand >> 16) & 0xff, 1);
+        transfer((uint16_t)operand);
+        return (true);
+
+    case OP_jsr:
+    case OP_jsl:
+        if (op == OP_jsl) {
+            m_x.load(ESI, m_l.pbr, 1);
+            call(m_l.push8);
+        }
+        m_x.mov_imm(ESI, (uint16_t)(next - 1));
+        call(m_l.push16);
+        if (op == OP_jsl)
+            m_x.store_imm(m_l.pbr, (operand >> 16) & 0xff, 1);
+        transfer((uint16_t)operand);
+        return (true);
+
+    case OP_rts:
+    case OP_rtl:
+        call(m_l.pull16);
+        m_x.alu_imm(ADD, EAX, 1);
+        m_x.store(m_l.pc, EAX, 2);
+        if (op == OP_rtl) {
+            call(m_l.pull8);
+            m_x.store(m_l.pbr, EAX, 1);
+        }
+        if (m_l.cover) call(m_l.cover);
+        m_closed = true;
+        flush();
+        ret();
+        return (true);
+    }
+
+    // Stop after anything that called back into the emulator
+    switch (op) {
+    case OP_pha: case OP_phx: case OP_phy: case OP_pla: case OP_plx:
+    case OP_ply:
+        check(next);
+        break;
+    default:
+        if (am != AM_immm && am != AM_immx && am != AM_impl && am != AM_acc)
+            check(next);
+        break;
+    }
+    return (true);
+}
+
+// Emit the exit stubs and the shared epilogue
+void translator::finish()
+{
+    for (uint32_t n = 0; n < m_exits && n < MAX_EXITS; ++n) {
+        m_x.patch(m_exit[n].at, m_x.used());
+        if (m_exit[n].cycles) m_x.add_mem64(m_l.cycles, m_exit[n].cycles);
+        m_x.store_imm(m_l.pc, m_exit[n].pc, 2);
+        ret();
+    }
+
+    for (uint32_t n = 0; n < m_returns; ++n)
+        m_x.patch(m_epilogue[n], m_x.used());
+
+    m_x.b(0x41); m_x.b(0x5d);                   // pop r13
+    m_x.b(0x41); m_x.b(0x5c);                   // pop r12
+    m_x.b(0x5b);                                // pop rbx
+    m_x.b(0xc3);                                // ret
+}
+
+}
+
+// Turn the dynamic recompiler on or off. It needs the block cache, which is
+// enabled with it. Returns false if it is not available on this host. The
+// arena is never writable and executable at once: the pages a translation
+// is written to are made writable for it and executable again afterwards.
+bool emu816::enable_jit(bool enable)
+{
+    if (enable && !m_jit) {
+        void *arena = mmap(NULL, EMU816_JIT_ARENA, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (arena == MAP_FAILED) return (false);
+
+        enable_block_cache(true);
+        m_jit = new JIT;
+        m_jit->arena = (uint8_t *)arena;
+        m_jit->used = 0;
+        jit_flush();
+    }
+    else if (!enable && m_jit) {
+        jit_flush();
+        munmap(m_jit->arena, EMU816_JIT_ARENA);
+        delete m_jit;
+        m_jit = NULL;
+    }
+    return (true);
+}
+
+// Discard all translations
+void emu816::jit_flush()
+{
+    if (m_jit) m_jit->used = 0;
+
+    if (m_blocks) {
+        for (uint32_t n = 0; n < EMU816_BLOCK_CACHE; ++n) {
+            m_blocks[n].native = NULL;
+            m_blocks[n].hits = 0;
+        }
+    }
+}
+
+// Translate a block into the arena. Returns false if its first instruction
+// cannot be translated.
+bool emu816::jit_compile(BLOCK &block)
+{
+    const size_t worst = 256 * (EMU816_BLOCK_LENGTH + 4);
+    layout l;
+
+    l.a = (uint8_t *)&a - (uint8_t *)this;
+    l.x = (uint8_t *)&x - (uint8_t *)this;
+    l.y = (uint8_t *)&y - (uint8_t *)this;
+    l.sp = (uint8_t *)&sp - (uint8_t *)this;
+    l.dp = (uint8_t *)&dp - (uint8_t *)this;
+    l.p = (uint8_t *)&p - (uint8_t *)this;
+    l.n = (uint8_t *)&m_n - (uint8_t *)this;
+    l.z = (uint8_t *)&m_z - (uint8_t *)this;
+    l.c = (uint8_t *)&m_c - (uint8_t *)this;
+    l.v = (uint8_t *)&m_v - (uint8_t *)this;
+    l.pbr = (uint8_t *)&pbr - (uint8_t *)this;
+    l.dbr = (uint8_t *)&dbr - (uint8_t *)this;
+    l.pc = (uint8_t *)&pc - (uint8_t *)this;
+    l.cycles = (uint8_t *)&m_cycles - (uint8_t *)this;
+    l.stopped = (uint8_t *)&m_stopped - (uint8_t *)this;
+    l.exit = (uint8_t *)&m_exit_block - (uint8_t *)this;
+    l.read = (uint8_t *)m_read - (uint8_t *)this;
+    l.write = (uint8_t *)m_write - (uint8_t *)this;
+    l.watch = (uint8_t *)m_watch - (uint8_t *)this;
+    l.watch_load = WATCH_LOAD;
+    l.load8 = (const void *)&jit_load8;
+    l.load16 = (const void *)&jit_load16;
+    l.store8 = (const void *)&jit_store8;
+    l.store16 = (const void *)&jit_store16;
+    l.push8 = (const void *)&jit_push8;
+    l.push16 = (const void *)&jit_push16;
+    l.pull8 = (const void *)&jit_pull8;
+    l.pull16 = (const void *)&jit_pull16;
+    l.cover = NULL;
+#if defined(EMU816_COVERAGE)
+    if (m_coverage) l.cover = (const void *)&jit_cover;
+#endif
+
+    if (m_jit->used + worst > EMU816_JIT_ARENA) {
+        uint16_t hits = block.hits;
+
+        jit_flush();
+        block.hits = hits;
+    }
+
+    uint8_t *code = m_jit->arena + m_jit->used;
+    translator t(l, code, worst, block.mode & 4, block.mode & 3, !m_profile);
+    uint16_t addr = block.start;
+    uint32_t n;
+
+    if (!t.supported(block.insn[0].opcode)) return (false);
+
+    // The pages the translation may be written to
+    uintptr_t host = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t from = (uintptr_t)code & ~(host - 1);
+    uintptr_t to = ((uintptr_t)code + worst + host - 1) & ~(host - 1);
+
+    if (mprotect((void *)from, to - from, PROT_READ | PROT_WRITE) != 0) return (false);
+
+    t.prologue();
+    for (n = 0; n < block.count && !t.closed(); ++n) {
+        const INSN &insn = block.insn[n];
+        uint16_t next = addr + insn.length;
+
+        if (!t.translate(insn.opcode, insn.operand, addr, next)) break;
+        addr = next;
+    }
+    if (!t.closed()) t.leave(addr);
+    t.finish();
+
+    if (mprotect((void *)from, to - from, PROT_READ | PROT_EXEC) != 0) {
+        jit_flush();
+        return (false);
+    }
+    if (t.overflow()) return (false);
+
+    m_jit->used = (m_jit->used + t.used() + 15) & ~(size_t)15;
+    block.native = (void (*)(emu816 *))code;
+    block.native_cycles = t.max_cycles();
+    ++m_jit_stats.compiled;
+    return (true);
+}
+
+// Execute a block as native code if it has been (or now can be) translated
+// and it cannot overrun the cycle budget. Returns false if the interpreter
+// should execute the block instead.
+bool emu816::run_native(BLOCK *block, uint64_t horizon)
+{
+#if defined(EMU816_TRACE)
+    if (m_trace) return (false);
+#endif
+    if (!block->native) {
+        if (block->hits == 0xffff || ++block->hits < EMU816_JIT_THRESHOLD)
+            return (false);
+        if (!jit_compile(*block)) {
+            block->hits = 0xffff;
+            return (false);
+        }
+    }
+
+    if (m_cycles + block->native_cycles >= horizon)
+        return (false);
+
+    uint64_t before = m_cycles;
+
+    m_exit_block = false;
+    block->native(this);
+    ++m_jit_stats.executed;
+
+    // No progress means the first instruction was left to the interpreter
+    return (m_cycles != before);
+}
+
+#else
+
+bool emu816::enable_jit(bool enable)
+{
+    return (!enable);
+}
+
+void emu816::jit_flush()
+{
+}
+
+bool emu816::jit_compile(BLOCK &block)
+{
+    return (false);
+}
+
+bool emu816::run_native(BLOCK *block, uint64_t horizon)
+{
+    return (false);
+}
+
+#endif
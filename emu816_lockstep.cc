@@ -0,0 +1,729 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo   
+//                                         d88'   `8. o888    .88'     
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'      
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo. 
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88 
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P 
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'  
+//                                                                    
+// A Portable C++ WDC 65C816 Emulator  
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// A lockstep engine that runs many processors over the same code with
+// their registers and flags held in vectors, one lane per processor.
+//
+// Only the common data handling instructions are vectorised: loads,
+// stores, logic, arithmetic in binary mode, compares, increments, shifts,
+// transfers, flag changes and conditional branches, with immediate,
+// direct page and absolute operands. Memory accesses are still made lane
+// by lane through each processor's own read and write paths. Everything
+// else is stepped lane by lane with emu816::step(), which keeps the
+// results exactly those of the scalar core.
+
+#include <emu816_lockstep.h>
+#include <emu816_opcodes.h>
+#include <string.h>
+
+namespace {
+
+// Operations and addressing modes
+enum {
+    OP_adc, OP_and, OP_asl, OP_asla, OP_bcc, OP_bcs, OP_beq, OP_bit, OP_biti,
+    OP_bmi, OP_bne, OP_bpl, OP_bra, OP_brk, OP_brl, OP_bvc, OP_bvs, OP_clc,
+    OP_cld, OP_cli, OP_clv, OP_cmp, OP_cop, OP_cpx, OP_cpy, OP_dec, OP_deca,
+    OP_dex, OP_dey, OP_eor, OP_inc, OP_inca, OP_inx, OP_iny, OP_jmp, OP_jsl,
+    OP_jsr, OP_lda, OP_ldx, OP_ldy, OP_lsr, OP_lsra, OP_mvn, OP_mvp, OP_nop,
+    OP_ora, OP_pea, OP_pei, OP_per, OP_pha, OP_phb, OP_phd, OP_phk, OP_php,
+    OP_phx, OP_phy, OP_pla, OP_plb, OP_pld, OP_plp, OP_plx, OP_ply, OP_rep,
+    OP_rol, OP_rola, OP_ror, OP_rora, OP_rti, OP_rtl, OP_rts, OP_sbc, OP_sec,
+    OP_sed, OP_sei, OP_sep, OP_sta, OP_stp, OP_stx, OP_sty, OP_stz, OP_tax,
+    OP_tay, OP_tcd, OP_tcs, OP_tdc, OP_trb, OP_tsb, OP_tsc, OP_tsx, OP_txa,
+    OP_txs, OP_txy, OP_tya, OP_tyx, OP_wai, OP_wdm, OP_xba, OP_xce
+};
+
+enum {
+    AM_abil, AM_absi, AM_absl, AM_absx, AM_absy, AM_abxi, AM_acc, AM_alng,
+    AM_alnx, AM_dily, AM_dpag, AM_dpgi, AM_dpgx, AM_dpgy, AM_dpil, AM_dpix,
+    AM_dpiy, AM_immb, AM_immm, AM_immw, AM_immx, AM_impl, AM_lrel, AM_rela,
+    AM_srel, AM_sriy
+};
+
+// Operand width, as in the opcode table
+enum { W_N, W_M, W_X, W_P };
+
+#define EMU816_LOCKSTEP_OP(code, op, am, w, f)  OP_##op,
+#define EMU816_LOCKSTEP_AM(code, op, am, w, f)  AM_##am,
+#define EMU816_LOCKSTEP_W(code, op, am, w, f)   W_##w,
+
+const uint8_t s_op[256] = { EMU816_OPCODES(EMU816_LOCKSTEP_OP) };
+const uint8_t s_am[256] = { EMU816_OPCODES(EMU816_LOCKSTEP_AM) };
+const uint8_t s_w[256] = { EMU816_OPCODES(EMU816_LOCKSTEP_W) };
+
+#undef EMU816_LOCKSTEP_W
+#undef EMU816_LOCKSTEP_AM
+#undef EMU816_LOCKSTEP_OP
+
+// Processor status bits held in p
+enum { P_D = 0x08, P_X = 0x10, P_M = 0x20 };
+
+// Most cycles counted in a vector before a lane's count is brought up to date
+const uint32_t s_span = 1 << 30;
+
+// Bytes of code compared at once to let a group run through them unchecked
+const uint32_t s_window = 16;
+
+// Return the length of an instruction in bytes
+uint32_t length(uint8_t am, bool m8, bool x8)
+{
+    switch (am) {
+    case AM_impl: case AM_acc:
+        return (1);
+    case AM_immm:
+        return (m8 ? 2 : 3);
+    case AM_immx:
+        return (x8 ? 2 : 3);
+    case AM_immw: case AM_absl: case AM_absx: case AM_absy: case AM_absi:
+    case AM_abxi: case AM_abil: case AM_lrel:
+        return (3);
+    case AM_alng: case AM_alnx:
+        return (4);
+    }
+    return (2);
+}
+
+}
+
+emu816_lockstep::emu816_lockstep()
+: m_lanes(0)
+, m_touched(false)
+, m_known_from(0)
+, m_known_to(0)
+, m_slack(0)
+, m_most(0)
+{
+    memset(m_cpu, 0, sizeof(m_cpu));
+    memset(&m_stats, 0, sizeof(m_stats));
+    memset(m_live, 0, sizeof(m_live));
+}
+
+// Add a processor as the next lane
+bool emu816_lockstep::add(emu816 *cpu)
+{
+    if (m_lanes == EMU816_LANES) return (false);
+    m_cpu[m_lanes++] = cpu;
+    return (true);
+}
+
+// Return true if a processor must run on its own: to take an interrupt or
+// deal with events, because a stop was asked for, or while it is traced or
+// records or replays its input, which need every instruction and load to
+// go through the interpreter
+bool emu816_lockstep::alone(emu816 *cpu)
+{
+    if (cpu->m_idle || cpu->m_interrupt || cpu->m_scheduled || cpu->m_host_stop.load()
+            || cpu->m_inputs != emu816::INPUT_NONE)
+        return (true);
+#if defined(EMU816_TRACE)
+    if (cpu->m_trace) return (true);
+#endif
+    return (false);
+}
+
+// Copy the state of a processor into its lane
+void emu816_lockstep::load(unsigned lane)
+{
+    emu816 *cpu = m_cpu[lane];
+
+    m_a[lane] = cpu->a.w;
+    m_x[lane] = cpu->x.w;
+    m_y[lane] = cpu->y.w;
+    m_n[lane] = cpu->m_n;
+    m_z[lane] = cpu->m_z;
+    m_c[lane] = cpu->m_c;
+    m_v[lane] = cpu->m_v;
+    m_sp[lane] = cpu->sp.w;
+    m_dp[lane] = cpu->dp.w;
+    m_pc[lane] = cpu->pc;
+    m_pbr[lane] = cpu->pbr;
+    m_dbr[lane] = cpu->dbr;
+    m_e[lane] = cpu->e;
+    m_p[lane] = cpu->p.b;
+    m_base[lane] = cpu->m_cycles;
+    m_spent[lane] = 0;
+    m_limit[lane] = (m_base[lane] >= m_horizon[lane]) ? 0
+                        : (m_horizon[lane] - m_base[lane] < s_span) ? m_horizon[lane] - m_base[lane] : s_span;
+}
+
+// Copy the state of a lane back into its processor
+void emu816_lockstep::save(unsigned lane)
+{
+    emu816 *cpu = m_cpu[lane];
+
+    cpu->a.w = m_a[lane];
+    cpu->x.w = m_x[lane];
+    cpu->y.w = m_y[lane];
+    cpu->m_n = (uint8_t)m_n[lane];
+    cpu->m_z = m_z[lane];
+    cpu->m_c = (uint8_t)m_c[lane];
+    cpu->m_v = (uint8_t)m_v[lane];
+    cpu->sp.w = m_sp[lane];
+    cpu->dp.w = m_dp[lane];
+    cpu->pc = m_pc[lane];
+    cpu->pbr = m_pbr[lane];
+    cpu->dbr = m_dbr[lane];
+    cpu->e = m_e[lane];
+    cpu->p.b = m_p[lane];
+    cpu->m_cycles = count(lane);
+}
+
+// Run every lane until it stops or has used the given number of cycles
+void emu816_lockstep::run_for(uint64_t cycles)
+{
+    // Lanes that must run alone do so from the start
+    for (unsigned lane = 0; lane < m_lanes; ++lane) {
+        emu816 *cpu = m_cpu[lane];
+
+        m_live[lane] = false;
+        if (alone(cpu)) {
+            cpu->run_for(cycles);
+            ++m_stats.detached;
+            continue;
+        }
+        m_horizon[lane] = (cycles && cycles <= UINT64_MAX - cpu->m_cycles)
+                            ? cpu->m_cycles + cycles : UINT64_MAX;
+        cpu->m_stopped = false;
+        cpu->m_stop_reason = EMU816_STOP_NONE;
+        if (cpu->m_resume != cpu->join(cpu->pbr, cpu->pc)) cpu->m_resume = EMU816_INVALID_PC;
+        cpu->m_horizon.store(m_horizon[lane]);
+        m_wait[lane] = 0;
+        m_live[lane] = true;
+        load(lane);
+    }
+
+    // While every live lane is in one group the lead stays the same, the
+    // instruction bytes from m_known_from to m_known_to are known to match
+    // and no lane can reach its limit for another m_slack cycles
+    bool together = false;
+    unsigned lead = m_lanes;
+    VEC act = { 0 };
+    uint32_t group = 0;
+
+    m_known_to = 0;
+    for (;;) {
+        // The lanes at the lowest address run next
+        if (!together || !m_live[lead]) {
+            emu816_addr_t low = 0;
+
+            lead = m_lanes;
+            for (unsigned lane = 0; lane < m_lanes; ++lane) {
+                if (m_live[lane] && (lead == m_lanes || address(lane) < low)) {
+                    lead = lane;
+                    low = address(lane);
+                }
+            }
+            if (lead == m_lanes) break;
+            together = false;
+        }
+
+        // Code outside mapped memory is fetched through the load functions,
+        // which must see each byte fetched once, so the lead runs alone
+        emu816 *first = m_cpu[lead];
+        emu816_addr_t at = address(lead);
+
+        if (!first->m_read[emu816::page(at)]
+                || !first->m_read[emu816::page(first->join(m_pbr[lead], (uint16_t)(m_pc[lead] + 3)))]) {
+            finish(lead);
+            together = false;
+            continue;
+        }
+
+        // They form a group with the same mode and instruction bytes
+        uint8_t opcode = first->read8(at);
+        uint32_t mode = this->mode(lead);
+        uint32_t size = length(s_am[opcode], m_e[lead] || (m_p[lead] & P_M),
+                            m_e[lead] || (m_p[lead] & P_X));
+        bool apart = false;
+
+        if (!together || at < m_known_from || at + size > m_known_to) {
+            bool window = true;
+
+            memset(&act, 0, sizeof(act));
+            group = 0;
+            for (unsigned lane = 0; lane < m_lanes; ++lane) {
+                if (!m_live[lane]) continue;
+                if (lane == lead || ((together || (address(lane) == at && this->mode(lane) == mode))
+                        && same_code(lead, lane, at, size))) {
+                    act[lane] = 0xffff;
+                    m_wait[lane] = 0;
+                    ++group;
+                    if (lane != lead && window)
+                        window = same_window(lead, lane, at);
+                }
+                else {
+                    apart = true;
+                    if (++m_wait[lane] > EMU816_LOCKSTEP_PATIENCE)
+                        finish(lane);
+                }
+            }
+            m_known_from = at;
+            m_known_to = (!apart && window && emu816::offset(at) <= EMU816_PAGE_SIZE - s_window)
+                            ? at + s_window : 0;
+            if (!together) m_slack = 0;
+        }
+
+        if (vector(opcode, act, lead)) {
+            m_stats.lanes += group;
+            together = !apart;
+        }
+        else {
+            scalar(act);
+            together = false;
+            m_touched = true;
+        }
+        if (together && !m_touched && m_slack > m_most) {
+            m_slack -= m_most;
+            continue;
+        }
+
+        // Lanes that have used up their cycles leave the group, as do any
+        // that stopped or have an interrupt or event to deal with after a
+        // branch or an access through a handler
+        m_slack = UINT32_MAX;
+        for (unsigned lane = 0; lane < m_lanes; ++lane) {
+            emu816 *cpu = m_cpu[lane];
+
+            if (!act[lane]) continue;
+            if (m_spent[lane] >= m_limit[lane]) {
+                if (count(lane) >= m_horizon[lane]) {
+                    finish(lane);
+                    act[lane] = 0;
+                    --group;
+                    continue;
+                }
+                save(lane);
+                load(lane);
+            }
+            if (m_touched && (cpu->m_stopped || alone(cpu))) {
+                finish(lane);
+                act[lane] = 0;
+                --group;
+                continue;
+            }
+            if (m_pc[lane] != m_pc[lead])
+                together = false;
+            if (m_limit[lane] - m_spent[lane] < m_slack)
+                m_slack = m_limit[lane] - m_spent[lane];
+        }
+    }
+}
+
+// Take a lane out of the group. It is either stopped, as run_for() would
+// have left it, or left to finish on its own.
+void emu816_lockstep::finish(unsigned lane)
+{
+    emu816 *cpu = m_cpu[lane];
+    emu816_stop_t reason = EMU816_STOP_NONE;
+
+    m_live[lane] = false;
+    save(lane);
+
+    if (cpu->m_stopped && !cpu->m_idle)
+        reason = cpu->m_stop_reason;
+    else if (count(lane) < m_horizon[lane] && !cpu->m_host_stop.load()) {
+        ++m_stats.detached;
+        cpu->run_for((m_horizon[lane] == UINT64_MAX) ? 0 : m_horizon[lane] - count(lane));
+        return;
+    }
+    else
+        reason = cpu->m_idle;
+
+    cpu->m_stopped = true;
+    cpu->m_host_stop.store(false);
+    if (reason == EMU816_STOP_NONE)
+        reason = (count(lane) >= m_horizon[lane]) ? EMU816_STOP_BUDGET : EMU816_STOP_HOST;
+    cpu->m_stop_reason = reason;
+}
+
+// Compare instruction bytes that cross a page. Code outside mapped memory
+// never matches, as reading it would call the load functions.
+bool emu816_lockstep::compare_code(unsigned lead, unsigned lane, emu816_addr_t ea, uint32_t length)
+{
+    emu816 *a = m_cpu[lead];
+    emu816 *b = m_cpu[lane];
+    uint8_t pbr = ea >> 16;
+    uint16_t pc = (uint16_t)ea;
+
+    for (uint32_t n = 0; n < length; ++n) {
+        emu816_addr_t at = a->join(pbr, (uint16_t)(pc + n));
+
+        if (!a->m_read[emu816::page(at)] || !b->m_read[emu816::page(at)]
+                || a->read8(at) != b->read8(at))
+            return (false);
+    }
+    return (true);
+}
+
+// Return true if the lead lane and another have the same code for a window
+// of bytes from an address, which must be in mapped memory
+bool emu816_lockstep::same_window(unsigned lead, unsigned lane, emu816_addr_t ea)
+{
+    const uint8_t *a = m_cpu[lead]->m_read[emu816::page(ea)];
+    const uint8_t *b = m_cpu[lane]->m_read[emu816::page(ea)];
+    uint32_t at = emu816::offset(ea);
+
+    if (!a || !b || at > EMU816_PAGE_SIZE - s_window) return (false);
+    return (a == b || !memcmp(a + at, b + at, s_window));
+}
+
+// Store a result for each lane in the group. The code known to match is
+// forgotten if any lane writes to host memory holding its own or the lead
+// lane's copy of it.
+void emu816_lockstep::store(const VEC &act, unsigned lead, const emu816_addr_t *ea, const VEC &value, bool byte)
+{
+    uint32_t code = emu816::page(m_known_from);
+
+    for (unsigned lane = 0; lane < m_lanes; ++lane) {
+        emu816 *cpu = m_cpu[lane];
+
+        if (!act[lane]) continue;
+        if (m_known_to) {
+            const uint8_t *low = cpu->m_write[emu816::page(ea[lane])];
+            const uint8_t *high = cpu->m_write[emu816::page(ea[lane] + !byte)];
+
+            if (low == cpu->m_read[code] || low == m_cpu[lead]->m_read[code]
+                    || high == cpu->m_read[code] || high == m_cpu[lead]->m_read[code])
+                m_known_to = 0;
+        }
+        if (byte)
+            cpu->write8(ea[lane], (uint8_t)value[lane]);
+        else
+            cpu->write16(ea[lane], value[lane]);
+    }
+}
+
+// Step each lane in the group with the scalar interpreter
+void emu816_lockstep::scalar(const VEC &act)
+{
+    for (unsigned lane = 0; lane < m_lanes; ++lane) {
+        if (!act[lane]) continue;
+        save(lane);
+        m_cpu[lane]->step();
+        load(lane);
+    }
+    m_known_to = 0;
+    ++m_stats.scalar;
+}
+
+// Execute the instruction once across the group if it is one that is
+// vectorised. Returns false if it is not.
+bool emu816_lockstep::vector(uint8_t opcode, const VEC &act, unsigned lead)
+{
+    uint8_t op = s_op[opcode];
+    uint8_t am = s_am[opcode];
+
+    switch (op) {
+    case OP_adc: case OP_sbc:
+        if (m_p[lead] & P_D) return (false);
+        break;
+    case OP_lda: case OP_ldx: case OP_ldy: case OP_sta: case OP_stx:
+    case OP_sty: case OP_stz: case OP_and: case OP_ora: case OP_eor:
+    case OP_cmp: case OP_cpx: case OP_cpy: case OP_bit: case OP_biti:
+    case OP_inc: case OP_dec: case OP_inca: case OP_deca: case OP_inx:
+    case OP_iny: case OP_dex: case OP_dey: case OP_tax: case OP_tay:
+    case OP_txa: case OP_tya: case OP_txy: case OP_tyx: case OP_clc:
+    case OP_sec: case OP_clv: case OP_nop: case OP_bcc: case OP_bcs:
+    case OP_beq: case OP_bne: case OP_bmi: case OP_bpl: case OP_bvc:
+    case OP_bvs: case OP_bra: case OP_asl: case OP_lsr: case OP_rol:
+    case OP_ror: case OP_rola: case OP_rora:
+        break;
+    default:
+        return (false);
+    }
+    switch (am) {
+    case AM_immm: case AM_immx: case AM_dpag: case AM_dpgx: case AM_dpgy:
+    case AM_absl: case AM_absx: case AM_absy: case AM_impl: case AM_acc:
+    case AM_rela:
+        break;
+    default:
+        return (false);
+    }
+
+    // Breakpoints are checked by the interpreter
+    emu816_addr_t code = m_cpu[lead]->join(m_pbr[lead], m_pc[lead]);
+
+    for (unsigned lane = 0; lane < m_lanes; ++lane) {
+        emu816 *cpu = m_cpu[lane];
+
+        if (act[lane] && (cpu->m_watch[emu816::page(code)] & emu816::WATCH_EXEC)
+                && (cpu->break_kinds(code) & EMU816_BREAK_EXEC))
+            return (false);
+    }
+
+    emu816 *cpu = m_cpu[lead];
+    bool e = m_e[lead];
+    bool m8 = e || (m_p[lead] & P_M);
+    bool x8 = e || (m_p[lead] & P_X);
+    bool byte = (s_w[opcode] == W_X) ? x8 : m8;
+    bool cross = (emu816_timing[opcode] & EMU816_TIME_IX) && x8;
+    uint16_t mask = byte ? 0x00ff : 0xffff;
+    uint16_t msb = byte ? 0x0080 : 0x8000;
+    uint16_t pc = m_pc[lead] + 1;
+    emu816_addr_t at = cpu->join(m_pbr[lead], pc);
+    emu816_addr_t ea[EMU816_LANES];
+    uint32_t cycles = emu816_cycles(opcode, e, m8, x8);
+    uint32_t operand = 0;
+    VEC data = { 0 };
+    VEC slow = { 0 };
+    VEC r;
+
+    // Work out the operand or the address of each lane's operand
+    switch (am) {
+    case AM_immm: case AM_immx:
+        operand = byte ? cpu->read8(at) : cpu->read16(at);
+        data += (uint16_t)operand;
+        pc += byte ? 1 : 2;
+        break;
+    case AM_dpag: case AM_dpgx: case AM_dpgy:
+        operand = cpu->read8(at);
+        pc += 1;
+        for (unsigned lane = 0; lane < m_lanes; ++lane) {
+            uint8_t offset = operand + ((am == AM_dpgx) ? m_x[lane] : (am == AM_dpgy) ? m_y[lane] : 0);
+
+            ea[lane] = (uint16_t)(m_dp[lane] + offset);
+            slow[lane] = (m_dp[lane] & 0xff) ? 0xffff : 0;
+        }
+        break;
+    case AM_absl: case AM_absx: case AM_absy:
+        operand = cpu->read16(at);
+        pc += 2;
+        for (unsigned lane = 0; lane < m_lanes; ++lane) {
+            uint16_t index = (am == AM_absx) ? m_x[lane] : (am == AM_absy) ? m_y[lane] : 0;
+
+            ea[lane] = cpu->join(m_dbr[lane], (uint16_t)operand) + index;
+            slow[lane] = (cross && (operand & 0xff) + index > 0xff) ? 0xffff : 0;
+        }
+        break;
+    case AM_rela:
+        operand = cpu->read8(at);
+        pc += 1;
+        break;
+    }
+
+    // Watched accesses are made by the interpreter
+    if (am != AM_immm && am != AM_immx && am != AM_impl && am != AM_acc && am != AM_rela) {
+        for (unsigned lane = 0; lane < m_lanes; ++lane) {
+            const uint8_t *watch = m_cpu[lane]->m_watch;
+
+            if (act[lane] && ((watch[emu816::page(ea[lane])] | watch[emu816::page(ea[lane] + !byte)])
+                    & (emu816::WATCH_LOAD | emu816::WATCH_STORE)))
+                return (false);
+        }
+    }
+
+    // Accesses through handlers may change anything, so the code must be
+    // compared again and the lanes checked afterwards, as they are after
+    // every branch. The handlers see the time as the interpreter has it.
+    m_touched = false;
+    if (am != AM_immm && am != AM_immx && am != AM_impl && am != AM_acc && am != AM_rela) {
+        for (unsigned lane = 0; lane < m_lanes; ++lane) {
+            if (act[lane] && !direct(m_cpu[lane], ea[lane], byte))
+                m_touched = true;
+        }
+    }
+    if (m_touched) {
+        m_known_to = 0;
+        clock(act, cycles, slow);
+    }
+    m_touched |= (am == AM_rela);
+
+    // Fetch memory operands lane by lane
+    switch (op) {
+    case OP_lda: case OP_ldx: case OP_ldy: case OP_and: case OP_ora:
+    case OP_eor: case OP_adc: case OP_sbc: case OP_cmp: case OP_cpx:
+    case OP_cpy: case OP_bit: case OP_inc: case OP_dec: case OP_asl:
+    case OP_lsr: case OP_rol: case OP_ror:
+        if (am == AM_immm || am == AM_immx) break;
+        for (unsigned lane = 0; lane < m_lanes; ++lane) {
+            if (act[lane])
+                data[lane] = byte ? m_cpu[lane]->read8(ea[lane]) : m_cpu[lane]->read16(ea[lane]);
+        }
+        break;
+    }
+
+    switch (op) {
+    case OP_lda:
+        set(m_a, act, (m_a & (uint16_t)~mask) | data);
+        nz(act, data, byte);
+        break;
+    case OP_ldx:
+        set(m_x, act, data);
+        nz(act, data, byte);
+        break;
+    case OP_ldy:
+        set(m_y, act, data);
+        nz(act, data, byte);
+        break;
+    case OP_sta: case OP_stx: case OP_sty: case OP_stz:
+        r = (op == OP_sta) ? m_a : (op == OP_stx) ? m_x : (op == OP_sty) ? m_y : data;
+        store(act, lead, ea, r, byte);
+        break;
+    case OP_and: case OP_ora: case OP_eor:
+        r = (op == OP_and) ? (m_a & data) : (op == OP_ora) ? (m_a | data) : (m_a ^ data);
+        r &= mask;
+        set(m_a, act, (m_a & (uint16_t)~mask) | r);
+        nz(act, r, byte);
+        break;
+    case OP_adc: case OP_sbc: {
+        VEC a = m_a & mask;
+        VEC c;
+        VEC v;
+
+        if (op == OP_sbc) data = ~data & mask;
+        if (byte) {
+            r = a + data + m_c;
+            c = (r >> 8) & 1;
+        }
+        else {
+            VEC sum = a + data;
+
+            r = sum + m_c;
+            c = ((VEC)(sum < a) | (VEC)(r < sum)) & 1;
+        }
+        v = ~(a ^ data) & (a ^ r) & msb;
+        r &= mask;
+        set(m_a, act, (m_a & (uint16_t)~mask) | r);
+        set(m_c, act, c);
+        set(m_v, act, (VEC)(v != 0) & 1);
+        nz(act, r, byte);
+        break;
+    }
+    case OP_cmp: case OP_cpx: case OP_cpy:
+        r = ((op == OP_cmp) ? m_a : (op == OP_cpx) ? m_x : m_y) & mask;
+        set(m_c, act, (VEC)(r < data) & 1);
+        r = (r - data) & mask;
+        nz(act, r, byte);
+        break;
+    case OP_bit: case OP_biti:
+        set(m_z, act, (VEC)((m_a & data & mask) != 0) & 1);
+        if (op == OP_bit) {
+            set(m_n, act, (VEC)((data & msb) != 0) & 0x80);
+            set(m_v, act, (VEC)((data & (msb >> 1)) != 0) & 1);
+        }
+        break;
+    case OP_inc: case OP_dec:
+        r = ((op == OP_inc) ? data + 1 : data - 1) & mask;
+        store(act, lead, ea, r, byte);
+        nz(act, r, byte);
+        break;
+    case OP_asl: case OP_lsr: case OP_rol: case OP_ror:
+    case OP_rola: case OP_rora: {
+        bool left = (op == OP_asl || op == OP_rol || op == OP_rola);
+        VEC in = (op == OP_rola || op == OP_rora) ? (m_a & mask) : data;
+        VEC carry = (op == OP_rol || op == OP_rola) ? m_c
+                        : (op == OP_ror || op == OP_rora) ? ((VEC)(m_c != 0) & msb) : data ^ data;
+
+        set(m_c, act, left ? ((VEC)((in & msb) != 0) & 1) : (in & 1));
+        r = left ? (((in << 1) | carry) & mask) : ((in >> 1) | carry);
+        nz(act, r, byte);
+        if (op == OP_rola || op == OP_rora) {
+            set(m_a, act, (m_a & (uint16_t)~mask) | r);
+            break;
+        }
+        store(act, lead, ea, r, byte);
+        break;
+    }
+    case OP_inca: case OP_deca:
+        r = ((op == OP_inca) ? m_a + 1 : m_a - 1) & mask;
+        set(m_a, act, (m_a & (uint16_t)~mask) | r);
+        nz(act, r, byte);
+        break;
+    case OP_inx: case OP_dex:
+        r = ((op == OP_inx) ? m_x + 1 : m_x - 1) & mask;
+        set(m_x, act, (m_x & (uint16_t)~mask) | r);
+        nz(act, r, byte);
+        break;
+    case OP_iny: case OP_dey:
+        r = ((op == OP_iny) ? m_y + 1 : m_y - 1) & mask;
+        set(m_y, act, (m_y & (uint16_t)~mask) | r);
+        nz(act, r, byte);
+        break;
+    case OP_tax: case OP_tay:
+        r = m_a & mask;
+        if (op == OP_tax)
+            set(m_x, act, r);
+        else
+            set(m_y, act, r);
+        nz(act, r, byte);
+        break;
+    case OP_txa: case OP_tya:
+        r = ((op == OP_txa) ? m_x : m_y) & mask;
+        set(m_a, act, (m_a & (uint16_t)~mask) | r);
+        nz(act, r, byte);
+        break;
+    case OP_txy: case OP_tyx:
+        r = (op == OP_txy) ? m_x : m_y;
+        if (op == OP_txy)
+            set(m_y, act, r);
+        else
+            set(m_x, act, r);
+        nz(act, r & mask, byte);
+        break;
+    case OP_clc: case OP_sec:
+        set(m_c, act, (op == OP_sec) ? data + 1 : data);
+        break;
+    case OP_clv:
+        set(m_v, act, data);
+        break;
+    case OP_nop:
+        break;
+    default: {
+        // A conditional branch
+        uint16_t target = pc + (int8_t)operand;
+        uint32_t taken = 1 + ((e && ((pc ^ target) & 0xff00)) ? 1 : 0);
+        VEC cond;
+
+        switch (op) {
+        case OP_bcc:    cond = (VEC)(m_c == 0); break;
+        case OP_bcs:    cond = (VEC)(m_c != 0); break;
+        case OP_beq:    cond = (VEC)(m_z == 0); break;
+        case OP_bne:    cond = (VEC)(m_z != 0); break;
+        case OP_bmi:    cond = (VEC)((m_n & 0x80) != 0); break;
+        case OP_bpl:    cond = (VEC)((m_n & 0x80) == 0); break;
+        case OP_bvc:    cond = (VEC)(m_v == 0); break;
+        case OP_bvs:    cond = (VEC)(m_v != 0); break;
+        default:        cond = act; break;
+        }
+        set(m_pc, act, (cond & target) | (~cond & pc));
+#if defined(EMU816_COVERAGE)
+        for (unsigned lane = 0; lane < m_lanes; ++lane) {
+            emu816 *cpu = m_cpu[lane];
+
+            if ((act[lane] & cond[lane]) && cpu->m_coverage)
+                cpu->cover(cpu->join(m_pbr[lane], target));
+        }
+#endif
+        spend(m_spent, act, cycles);
+        spend(m_spent, act & cond, taken);
+        m_most = cycles + taken;
+        ++m_stats.vector;
+        return (true);
+    }
+    }
+
+    set(m_pc, act, (data & 0) + pc);
+    spend(m_spent, act, cycles);
+    spend(m_spent, act & slow, 1);
+    m_most = emu816_max_cycles(opcode, e, m8, x8);
+    ++m_stats.vector;
+    return (true);
+}
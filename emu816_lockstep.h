@@ -0,0 +1,170 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo   
+//                                         d88'   `8. o888    .88'     
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'      
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo. 
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88 
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P 
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'  
+//                                                                    
+// A Portable C++ WDC 65C816 Emulator  
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+#ifndef EMU816_LOCKSTEP_H
+#define EMU816_LOCKSTEP_H
+
+#include <emu816.h>
+
+// The number of processors run side by side, EMU816_LANES, comes from the
+// LANES option in the Makefile by way of emu816_config.h. Each register is
+// held as a vector of 16-bit lanes, so 16 lanes fill an AVX2 register and 32
+// an AVX-512 one (see the SIMD option).
+
+// Instructions a lane may wait for the others to reach it before it is
+// left to run on its own
+#define EMU816_LOCKSTEP_PATIENCE    256
+
+// Counters kept by the lockstep engine
+typedef struct {
+    uint64_t                vector;         // instructions run once for a group
+    uint64_t                scalar;         // instructions stepped lane by lane
+    uint64_t                lanes;          // lane instructions run in groups
+    uint64_t                detached;       // lanes left to run on their own
+} emu816_lockstep_stats_t;
+
+// Runs a set of processors executing the same code with different data.
+// Lanes at the same address and in the same mode form a group whose common
+// instruction is executed once across all of them, with the registers and
+// flags of every lane held in vectors. Lanes that branch apart wait, and
+// the group at the lowest address always runs first so that they meet
+// again where the paths join. Instructions that are not vectorised are
+// stepped lane by lane with the ordinary interpreter. A lane that waits
+// too long, takes an interrupt, has events scheduled, is traced, records or
+// replays its input or runs code outside mapped memory is left to run on
+// its own.
+//
+// Each lane ends exactly as if run_for() had been called on it, and
+// stop_reason() gives the reason it stopped. Lanes are grouped by comparing
+// their instruction bytes, which is much quicker when the code is mapped
+// onto host memory and quickest when every lane shares the same copy.
+class emu816_lockstep
+{
+    public:
+
+        emu816_lockstep();
+
+        // Add a processor that has been set up and reset. Returns false
+        // once every lane is in use.
+        bool                    add(emu816 *cpu);
+        unsigned                lanes() { return m_lanes; }
+
+        // Run every lane for the given number of cycles (0 for no limit)
+        void                    run_for(uint64_t cycles);
+
+        const emu816_lockstep_stats_t &stats() { return m_stats; }
+
+    private:
+
+        typedef uint16_t        VEC __attribute__((vector_size(2 * EMU816_LANES)));
+        typedef uint32_t        CNT __attribute__((vector_size(4 * EMU816_LANES)));
+
+        emu816 *                m_cpu[EMU816_LANES];
+        unsigned                m_lanes;
+        emu816_lockstep_stats_t m_stats;
+
+        // Registers and flags of each lane, laid out as in emu816
+        VEC                     m_a, m_x, m_y;
+        VEC                     m_n, m_z, m_c, m_v;
+        uint16_t                m_sp[EMU816_LANES];
+        uint16_t                m_dp[EMU816_LANES];
+        VEC                     m_pc;
+        uint8_t                 m_pbr[EMU816_LANES];
+        uint8_t                 m_dbr[EMU816_LANES];
+        uint8_t                 m_e[EMU816_LANES];
+        uint8_t                 m_p[EMU816_LANES];
+
+        // Cycles are counted from the value each lane was loaded with, in
+        // spans short enough to count in vectors
+        uint64_t                m_base[EMU816_LANES];
+        CNT                     m_spent;
+        CNT                     m_limit;
+        uint64_t                m_horizon[EMU816_LANES];
+        uint32_t                m_wait[EMU816_LANES];
+        bool                    m_live[EMU816_LANES];
+        bool                    m_touched;      // last instruction branched or used a handler
+        emu816_addr_t           m_known_from;   // code known to match in every lane
+        emu816_addr_t           m_known_to;
+        uint32_t                m_slack;        // cycles before a lane can reach its limit
+        uint32_t                m_most;         // most cycles the last instruction took
+
+        // Set the lanes of reg selected by act to value
+        static void             set(VEC &reg, const VEC &act, const VEC &value)
+                                    { reg = (value & act) | (reg & ~act); }
+
+        // Add a number of cycles to the counts of the lanes selected by act
+        static void             spend(CNT &count, const VEC &act, uint32_t cycles)
+                                    { count += (CNT)(__builtin_convertvector(act, CNT) != 0) & cycles; }
+
+        // Bring the cycle counts of the lanes selected by act up to the
+        // point in an instruction where the interpreter makes its accesses,
+        // for handlers that look at the time
+        void                    clock(const VEC &act, uint32_t cycles, const VEC &slow)
+                                    { for (unsigned lane = 0; lane < m_lanes; ++lane)
+                                          if (act[lane])
+                                              m_cpu[lane]->m_cycles = count(lane) + cycles + (slow[lane] != 0); }
+
+        // Set N and Z from a byte or word result, as setnz<T>()
+        void                    nz(const VEC &act, const VEC &value, bool byte)
+                                    { set(m_n, act, byte ? value : (VEC)(value >> 8));
+                                      set(m_z, act, value); }
+
+        // The address of a lane's next instruction and the mode bits that
+        // a group must share (E, M, X and D)
+        emu816_addr_t           address(unsigned lane)
+                                    { return ((m_pbr[lane] << 16) | m_pc[lane]); }
+        uint32_t                mode(unsigned lane)
+                                    { return ((m_e[lane] << 8) | (m_p[lane] & 0x38)); }
+        uint64_t                count(unsigned lane)
+                                    { return (m_base[lane] + m_spent[lane]); }
+
+        // Return true if an access by a lane goes straight to host memory
+        // and so cannot have side effects
+        static bool             direct(emu816 *cpu, emu816_addr_t ea, bool byte)
+                                    { return (cpu->m_read[emu816::page(ea)] && cpu->m_write[emu816::page(ea)]
+                                                && (byte || emu816::offset(ea) < EMU816_PAGE_SIZE - 1)); }
+
+        // Return true if a lane has the same instruction bytes as the lead
+        // lane. Code in mapped memory is compared directly and certainly
+        // matches when both lanes share the host memory holding it.
+        bool                    same_code(unsigned lead, unsigned lane, emu816_addr_t ea, uint32_t length)
+                                    { const uint8_t *a = m_cpu[lead]->m_read[emu816::page(ea)];
+                                      const uint8_t *b = m_cpu[lane]->m_read[emu816::page(ea)];
+                                      uint32_t at = emu816::offset(ea);
+                                      if (!a || !b || at + length > EMU816_PAGE_SIZE)
+                                          return (compare_code(lead, lane, ea, length));
+                                      if (a == b) return (true);
+                                      for (uint32_t n = 0; n < length; ++n)
+                                          if (a[at + n] != b[at + n]) return (false);
+                                      return (true); }
+
+        static bool             alone(emu816 *cpu);
+        void                    load(unsigned lane);
+        void                    save(unsigned lane);
+        void                    finish(unsigned lane);
+        bool                    same_window(unsigned lead, unsigned lane, emu816_addr_t ea);
+        bool                    compare_code(unsigned lead, unsigned lane, emu816_addr_t ea, uint32_t length);
+        void                    store(const VEC &act, unsigned lead, const emu816_addr_t *ea, const VEC &value, bool byte);
+        bool                    vector(uint8_t opcode, const VEC &act, unsigned lead);
+        void                    scalar(const VEC &act);
+};
+
+#endif
@@ -0,0 +1,655 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo   
+//                                         d88'   `8. o888    .88'     
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'      
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo. 
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88 
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P 
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'  
+//                                                                    
+// A Portable C++ WDC 65C816 Emulator  
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+#ifndef EMU816_OPCODES_H
+#define EMU816_OPCODES_H
+
+#include <stdint.h>
+
+// The 65C816 opcode map as an X-macro. Each entry names the opcode, the
+// operation (op_*), the addressing mode (am_*) used to execute it and how
+// the operation depends on the processor mode:
+//
+//  N   independent of the E/M/X flags
+//  M   operand width follows the accumulator (E or M)
+//  X   operand width follows the index registers (E or X)
+//  P   may change E/M/X, either directly or through a virtual handler
+//
+// and how it affects the flow of control:
+//
+//  S   continues with the following instruction
+//  B   conditional branch
+//  J   unconditional transfer (jumps, calls, returns and software interrupts)
+//  R   may repeat itself or stop the processor
+//
+// The reference switch in emu816::step() is written out longhand; other
+// execution engines expand this list to build their handler tables.
+
+#define EMU816_OPCODES(OP) \
+    OP(0x00, brk , immb, P, J) \
+    OP(0x01, ora , dpix, M, S) \
+    OP(0x02, cop , immb, P, J) \
+    OP(0x03, ora , srel, M, S) \
+    OP(0x04, tsb , dpag, M, S) \
+    OP(0x05, ora , dpag, M, S) \
+    OP(0x06, asl , dpag, M, S) \
+    OP(0x07, ora , dpil, M, S) \
+    OP(0x08, php , impl, N, S) \
+    OP(0x09, ora , immm, M, S) \
+    OP(0x0a, asla, acc , M, S) \
+    OP(0x0b, phd , impl, N, S) \
+    OP(0x0c, tsb , absl, M, S) \
+    OP(0x0d, ora , absl, M, S) \
+    OP(0x0e, asl , absl, M, S) \
+    OP(0x0f, ora , alng, M, S) \
+    \
+    OP(0x10, bpl , rela, N, B) \
+    OP(0x11, ora , dpiy, M, S) \
+    OP(0x12, ora , dpgi, M, S) \
+    OP(0x13, ora , sriy, M, S) \
+    OP(0x14, trb , dpag, M, S) \
+    OP(0x15, ora , dpgx, M, S) \
+    OP(0x16, asl , dpgx, M, S) \
+    OP(0x17, ora , dily, M, S) \
+    OP(0x18, clc , impl, N, S) \
+    OP(0x19, ora , absy, M, S) \
+    OP(0x1a, inca, acc , M, S) \
+    OP(0x1b, tcs , impl, N, S) \
+    OP(0x1c, trb , absl, M, S) \
+    OP(0x1d, ora , absx, M, S) \
+    OP(0x1e, asl , absx, M, S) \
+    OP(0x1f, ora , alnx, M, S) \
+    \
+    OP(0x20, jsr , absl, N, J) \
+    OP(0x21, and , dpix, M, S) \
+    OP(0x22, jsl , alng, N, J) \
+    OP(0x23, and , srel, M, S) \
+    OP(0x24, bit , dpag, M, S) \
+    OP(0x25, and , dpag, M, S) \
+    OP(0x26, rol , dpag, M, S) \
+    OP(0x27, and , dpil, M, S) \
+    OP(0x28, plp , impl, P, S) \
+    OP(0x29, and , immm, M, S) \
+    OP(0x2a, rola, acc , M, S) \
+    OP(0x2b, pld , impl, N, S) \
+    OP(0x2c, bit , absl, M, S) \
+    OP(0x2d, and , absl, M, S) \
+    OP(0x2e, rol , absl, M, S) \
+    OP(0x2f, and , alng, M, S) \
+    \
+    OP(0x30, bmi , rela, N, B) \
+    OP(0x31, and , dpiy, M, S) \
+    OP(0x32, and , dpgi, M, S) \
+    OP(0x33, and , sriy, M, S) \
+    OP(0x34, bit , dpgx, M, S) \
+    OP(0x35, and , dpgx, M, S) \
+    OP(0x36, rol , dpgx, M, S) \
+    OP(0x37, and , dily, M, S) \
+    OP(0x38, sec , impl, N, S) \
+    OP(0x39, and , absy, M, S) \
+    OP(0x3a, deca, acc , M, S) \
+    OP(0x3b, tsc , impl, M, S) \
+    OP(0x3c, bit , absx, M, S) \
+    OP(0x3d, and , absx, M, S) \
+    OP(0x3e, rol , absx, M, S) \
+    OP(0x3f, and , alnx, M, S) \
+    \
+    OP(0x40, rti , impl, P, J) \
+    OP(0x41, eor , dpix, M, S) \
+    OP(0x42, wdm , immb, P, R) \
+    OP(0x43, eor , srel, M, S) \
+    OP(0x44, mvp , immw, N, R) \
+    OP(0x45, eor , dpag, M, S) \
+    OP(0x46, lsr , dpag, M, S) \
+    OP(0x47, eor , dpil, M, S) \
+    OP(0x48, pha , impl, M, S) \
+    OP(0x49, eor , immm, M, S) \
+    OP(0x4a, lsra, impl, M, S) \
+    OP(0x4b, phk , impl, N, S) \
+    OP(0x4c, jmp , absl, N, J) \
+    OP(0x4d, eor , absl, M, S) \
+    OP(0x4e, lsr , absl, M, S) \
+    OP(0x4f, eor , alng, M, S) \
+    \
+    OP(0x50, bvc , rela, N, B) \
+    OP(0x51, eor , dpiy, M, S) \
+    OP(0x52, eor , dpgi, M, S) \
+    OP(0x53, eor , sriy, M, S) \
+    OP(0x54, mvn , immw, N, R) \
+    OP(0x55, eor , dpgx, M, S) \
+    OP(0x56, lsr , dpgx, M, S) \
+    OP(0x57, eor , dpil, M, S) \
+    OP(0x58, cli , impl, N, S) \
+    OP(0x59, eor , absy, M, S) \
+    OP(0x5a, phy , impl, X, S) \
+    OP(0x5b, tcd , impl, N, S) \
+    OP(0x5c, jmp , alng, N, J) \
+    OP(0x5d, eor , absx, M, S) \
+    OP(0x5e, lsr , absx, M, S) \
+    OP(0x5f, eor , alnx, M, S) \
+    \
+    OP(0x60, rts , impl, N, J) \
+    OP(0x61, adc , dpix, M, S) \
+    OP(0x62, per , lrel, N, S) \
+    OP(0x63, adc , srel, M, S) \
+    OP(0x64, stz , dpag, M, S) \
+    OP(0x65, adc , dpag, M, S) \
+    OP(0x66, ror , dpag, M, S) \
+    OP(0x67, adc , dpil, M, S) \
+    OP(0x68, pla , impl, M, S) \
+    OP(0x69, adc , immm, M, S) \
+    OP(0x6a, rora, impl, M, S) \
+    OP(0x6b, rtl , impl, N, J) \
+    OP(0x6c, jmp , absi, N, J) \
+    OP(0x6d, adc , absl, M, S) \
+    OP(0x6e, ror , absl, M, S) \
+    OP(0x6f, adc , alng, M, S) \
+    \
+    OP(0x70, bvs , rela, N, B) \
+    OP(0x71, adc , dpiy, M, S) \
+    OP(0x72, adc , dpgi, M, S) \
+    OP(0x73, adc , sriy, M, S) \
+    OP(0x74, stz , dpgx, M, S) \
+    OP(0x75, adc , dpgx, M, S) \
+    OP(0x76, ror , dpgx, M, S) \
+    OP(0x77, adc , dily, M, S) \
+    OP(0x78, sei , impl, N, S) \
+    OP(0x79, adc , absy, M, S) \
+    OP(0x7a, ply , impl, X, S) \
+    OP(0x7b, tdc , impl, M, S) \
+    OP(0x7c, jmp , abxi, N, J) \
+    OP(0x7d, adc , absx, M, S) \
+    OP(0x7e, ror , absx, M, S) \
+    OP(0x7f, adc , alnx, M, S) \
+    \
+    OP(0x80, bra , rela, N, J) \
+    OP(0x81, sta , dpix, M, S) \
+    OP(0x82, brl , lrel, N, J) \
+    OP(0x83, sta , srel, M, S) \
+    OP(0x84, sty , dpag, X, S) \
+    OP(0x85, sta , dpag, M, S) \
+    OP(0x86, stx , dpag, X, S) \
+    OP(0x87, sta , dpil, M, S) \
+    OP(0x88, dey , impl, X, S) \
+    OP(0x89, biti, immm, M, S) \
+    OP(0x8a, txa , impl, M, S) \
+    OP(0x8b, phb , impl, N, S) \
+    OP(0x8c, sty , absl, X, S) \
+    OP(0x8d, sta , absl, M, S) \
+    OP(0x8e, stx , absl, X, S) \
+    OP(0x8f, sta , alng, M, S) \
+    \
+    OP(0x90, bcc , rela, N, B) \
+    OP(0x91, sta , dpiy, M, S) \
+    OP(0x92, sta , dpgi, M, S) \
+    OP(0x93, sta , sriy, M, S) \
+    OP(0x94, sty , dpgx, X, S) \
+    OP(0x95, sta , dpgx, M, S) \
+    OP(0x96, stx , dpgy, X, S) \
+    OP(0x97, sta , dily, M, S) \
+    OP(0x98, tya , impl, M, S) \
+    OP(0x99, sta , absy, M, S) \
+    OP(0x9a, txs , impl, N, S) \
+    OP(0x9b, txy , impl, X, S) \
+    OP(0x9c, stz , absl, M, S) \
+    OP(0x9d, sta , absx, M, S) \
+    OP(0x9e, stz , absx, M, S) \
+    OP(0x9f, sta , alnx, M, S) \
+    \
+    OP(0xa0, ldy , immx, X, S) \
+    OP(0xa1, lda , dpix, M, S) \
+    OP(0xa2, ldx , immx, X, S) \
+    OP(0xa3, lda , srel, M, S) \
+    OP(0xa4, ldy , dpag, X, S) \
+    OP(0xa5, lda , dpag, M, S) \
+    OP(0xa6, ldx , dpag, X, S) \
+    OP(0xa7, lda , dpil, M, S) \
+    OP(0xa8, tay , impl, X, S) \
+    OP(0xa9, lda , immm, M, S) \
+    OP(0xaa, tax , impl, X, S) \
+    OP(0xab, plb , impl, N, S) \
+    OP(0xac, ldy , absl, X, S) \
+    OP(0xad, lda , absl, M, S) \
+    OP(0xae, ldx , absl, X, S) \
+    OP(0xaf, lda , alng, M, S) \
+    \
+    OP(0xb0, bcs , rela, N, B) \
+    OP(0xb1, lda , dpiy, M, S) \
+    OP(0xb2, lda , dpgi, M, S) \
+    OP(0xb3, lda , sriy, M, S) \
+    OP(0xb4, ldy , dpgx, X, S) \
+    OP(0xb5, lda , dpgx, M, S) \
+    OP(0xb6, ldx , dpgy, X, S) \
+    OP(0xb7, lda , dily, M, S) \
+    OP(0xb8, clv , impl, N, S) \
+    OP(0xb9, lda , absy, M, S) \
+    OP(0xba, tsx , impl, N, S) \
+    OP(0xbb, tyx , impl, X, S) \
+    OP(0xbc, ldy , absx, X, S) \
+    OP(0xbd, lda , absx, M, S) \
+    OP(0xbe, ldx , absy, X, S) \
+    OP(0xbf, lda , alnx, M, S) \
+    \
+    OP(0xc0, cpy , immx, X, S) \
+    OP(0xc1, cmp , dpix, M, S) \
+    OP(0xc2, rep , immb, P, S) \
+    OP(0xc3, cmp , srel, M, S) \
+    OP(0xc4, cpy , dpag, X, S) \
+    OP(0xc5, cmp , dpag, M, S) \
+    OP(0xc6, dec , dpag, M, S) \
+    OP(0xc7, cmp , dpil, M, S) \
+    OP(0xc8, iny , impl, X, S) \
+    OP(0xc9, cmp , immm, M, S) \
+    OP(0xca, dex , impl, X, S) \
+    OP(0xcb, wai , impl, N, R) \
+    OP(0xcc, cpy , absl, X, S) \
+    OP(0xcd, cmp , absl, M, S) \
+    OP(0xce, dec , absl, M, S) \
+    OP(0xcf, cmp , alng, M, S) \
+    \
+    OP(0xd0, bne , rela, N, B) \
+    OP(0xd1, cmp , dpiy, M, S) \
+    OP(0xd2, cmp , dpgi, M, S) \
+    OP(0xd3, cmp , sriy, M, S) \
+    OP(0xd4, pei , dpag, N, S) \
+    OP(0xd5, cmp , dpgx, M, S) \
+    OP(0xd6, dec , dpgx, M, S) \
+    OP(0xd7, cmp , dily, M, S) \
+    OP(0xd8, cld , impl, N, S) \
+    OP(0xd9, cmp , absy, M, S) \
+    OP(0xda, phx , impl, X, S) \
+    OP(0xdb, stp , impl, N, R) \
+    OP(0xdc, jmp , abil, N, J) \
+    OP(0xdd, cmp , absx, M, S) \
+    OP(0xde, dec , absx, M, S) \
+    OP(0xdf, cmp , alnx, M, S) \
+    \
+    OP(0xe0, cpx , immx, X, S) \
+    OP(0xe1, sbc , dpix, M, S) \
+    OP(0xe2, sep , immb, P, S) \
+    OP(0xe3, sbc , srel, M, S) \
+    OP(0xe4, cpx , dpag, X, S) \
+    OP(0xe5, sbc , dpag, M, S) \
+    OP(0xe6, inc , dpag, M, S) \
+    OP(0xe7, sbc , dpil, M, S) \
+    OP(0xe8, inx , impl, X, S) \
+    OP(0xe9, sbc , immm, M, S) \
+    OP(0xea, nop , impl, N, S) \
+    OP(0xeb, xba , impl, N, S) \
+    OP(0xec, cpx , absl, X, S) \
+    OP(0xed, sbc , absl, M, S) \
+    OP(0xee, inc , absl, M, S) \
+    OP(0xef, sbc , alng, M, S) \
+    \
+    OP(0xf0, beq , rela, N, B) \
+    OP(0xf1, sbc , dpiy, M, S) \
+    OP(0xf2, sbc , dpgi, M, S) \
+    OP(0xf3, sbc , sriy, M, S) \
+    OP(0xf4, pea , immw, N, S) \
+    OP(0xf5, sbc , dpgx, M, S) \
+    OP(0xf6, inc , dpgx, M, S) \
+    OP(0xf7, sbc , dily, M, S) \
+    OP(0xf8, sed , impl, N, S) \
+    OP(0xf9, sbc , absy, M, S) \
+    OP(0xfa, plx , impl, X, S) \
+    OP(0xfb, xce , impl, P, S) \
+    OP(0xfc, jsr , abxi, N, J) \
+    OP(0xfd, sbc , absx, M, S) \
+    OP(0xfe, inc , absx, M, S) \
+    OP(0xff, sbc , alnx, M, S)
+
+// The number of operand bytes that follow the opcode for each addressing
+// mode. m and x are non-zero when the accumulator or index registers are
+// eight bits wide.
+#define EMU816_BYTES_absl(m, x)     2
+#define EMU816_BYTES_absx(m, x)     2
+#define EMU816_BYTES_absy(m, x)     2
+#define EMU816_BYTES_absi(m, x)     2
+#define EMU816_BYTES_abxi(m, x)     2
+#define EMU816_BYTES_alng(m, x)     3
+#define EMU816_BYTES_alnx(m, x)     3
+#define EMU816_BYTES_abil(m, x)     2
+#define EMU816_BYTES_dpag(m, x)     1
+#define EMU816_BYTES_dpgx(m, x)     1
+#define EMU816_BYTES_dpgy(m, x)     1
+#define EMU816_BYTES_dpgi(m, x)     1
+#define EMU816_BYTES_dpix(m, x)     1
+#define EMU816_BYTES_dpiy(m, x)     1
+#define EMU816_BYTES_dpil(m, x)     1
+#define EMU816_BYTES_dily(m, x)     1
+#define EMU816_BYTES_impl(m, x)     0
+#define EMU816_BYTES_acc(m, x)      0
+#define EMU816_BYTES_immb(m, x)     1
+#define EMU816_BYTES_immw(m, x)     2
+#define EMU816_BYTES_immm(m, x)     ((m) ? 1 : 2)
+#define EMU816_BYTES_immx(m, x)     ((x) ? 1 : 2)
+#define EMU816_BYTES_lrel(m, x)     2
+#define EMU816_BYTES_rela(m, x)     1
+#define EMU816_BYTES_srel(m, x)     1
+#define EMU816_BYTES_sriy(m, x)     1
+
+// Instruction timing, after the opcode table in the WDC W65C816S datasheet.
+// Each entry holds the fewest cycles the opcode takes and the rules that
+// add to them:
+#define EMU816_TIME_CYCLES          0x001f      // base cycle count
+#define EMU816_TIME_M               0x0020      // +1 with a 16-bit accumulator
+#define EMU816_TIME_M2              0x0040      // +2 with a 16-bit accumulator
+#define EMU816_TIME_X               0x0080      // +1 with 16-bit index registers
+#define EMU816_TIME_DL              0x0100      // +1 if the low byte of D is not zero
+#define EMU816_TIME_IX              0x0200      // +1 with 16-bit index registers or
+                                                // when indexing crosses a page
+#define EMU816_TIME_N               0x0400      // +1 in native mode
+#define EMU816_TIME_BR              0x0800      // +1 if the branch is taken and +1
+                                                // more in emulation mode if it
+                                                // crosses a page
+
+static constexpr uint16_t emu816_timing[256] = {
+    7 | EMU816_TIME_N,                                  // 00 brk  immb
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 01 ora  dpix
+    7 | EMU816_TIME_N,                                  // 02 cop  immb
+    4 | EMU816_TIME_M,                                  // 03 ora  srel
+    5 | EMU816_TIME_M2 | EMU816_TIME_DL,                // 04 tsb  dpag
+    3 | EMU816_TIME_M | EMU816_TIME_DL,                 // 05 ora  dpag
+    5 | EMU816_TIME_M2 | EMU816_TIME_DL,                // 06 asl  dpag
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 07 ora  dpil
+    3,                                                  // 08 php  impl
+    2 | EMU816_TIME_M,                                  // 09 ora  immm
+    2,                                                  // 0a asla acc
+    4,                                                  // 0b phd  impl
+    6 | EMU816_TIME_M2,                                 // 0c tsb  absl
+    4 | EMU816_TIME_M,                                  // 0d ora  absl
+    6 | EMU816_TIME_M2,                                 // 0e asl  absl
+    5 | EMU816_TIME_M,                                  // 0f ora  alng
+    2 | EMU816_TIME_BR,                                 // 10 bpl  rela
+    5 | EMU816_TIME_M | EMU816_TIME_IX | EMU816_TIME_DL,// 11 ora  dpiy
+    5 | EMU816_TIME_M | EMU816_TIME_DL,                 // 12 ora  dpgi
+    7 | EMU816_TIME_M,                                  // 13 ora  sriy
+    5 | EMU816_TIME_M2 | EMU816_TIME_DL,                // 14 trb  dpag
+    4 | EMU816_TIME_M | EMU816_TIME_DL,                 // 15 ora  dpgx
+    6 | EMU816_TIME_M2 | EMU816_TIME_DL,                // 16 asl  dpgx
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 17 ora  dily
+    2,                                                  // 18 clc  impl
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // 19 ora  absy
+    2,                                                  // 1a inca acc
+    2,                                                  // 1b tcs  impl
+    6 | EMU816_TIME_M2,                                 // 1c trb  absl
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // 1d ora  absx
+    7 | EMU816_TIME_M2,                                 // 1e asl  absx
+    5 | EMU816_TIME_M,                                  // 1f ora  alnx
+    6,                                                  // 20 jsr  absl
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 21 and  dpix
+    8,                                                  // 22 jsl  alng
+    4 | EMU816_TIME_M,                                  // 23 and  srel
+    3 | EMU816_TIME_M | EMU816_TIME_DL,                 // 24 bit  dpag
+    3 | EMU816_TIME_M | EMU816_TIME_DL,                 // 25 and  dpag
+    5 | EMU816_TIME_M2 | EMU816_TIME_DL,                // 26 rol  dpag
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 27 and  dpil
+    4,                                                  // 28 plp  impl
+    2 | EMU816_TIME_M,                                  // 29 and  immm
+    2,                                                  // 2a rola acc
+    5,                                                  // 2b pld  impl
+    4 | EMU816_TIME_M,                                  // 2c bit  absl
+    4 | EMU816_TIME_M,                                  // 2d and  absl
+    6 | EMU816_TIME_M2,                                 // 2e rol  absl
+    5 | EMU816_TIME_M,                                  // 2f and  alng
+    2 | EMU816_TIME_BR,                                 // 30 bmi  rela
+    5 | EMU816_TIME_M | EMU816_TIME_IX | EMU816_TIME_DL,// 31 and  dpiy
+    5 | EMU816_TIME_M | EMU816_TIME_DL,                 // 32 and  dpgi
+    7 | EMU816_TIME_M,                                  // 33 and  sriy
+    4 | EMU816_TIME_M | EMU816_TIME_DL,                 // 34 bit  dpgx
+    4 | EMU816_TIME_M | EMU816_TIME_DL,                 // 35 and  dpgx
+    6 | EMU816_TIME_M2 | EMU816_TIME_DL,                // 36 rol  dpgx
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 37 and  dily
+    2,                                                  // 38 sec  impl
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // 39 and  absy
+    2,                                                  // 3a deca acc
+    2,                                                  // 3b tsc  impl
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // 3c bit  absx
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // 3d and  absx
+    7 | EMU816_TIME_M2,                                 // 3e rol  absx
+    5 | EMU816_TIME_M,                                  // 3f and  alnx
+    6 | EMU816_TIME_N,                                  // 40 rti  impl
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 41 eor  dpix
+    2,                                                  // 42 wdm  immb
+    4 | EMU816_TIME_M,                                  // 43 eor  srel
+    7,                                                  // 44 mvp  immw
+    3 | EMU816_TIME_M | EMU816_TIME_DL,                 // 45 eor  dpag
+    5 | EMU816_TIME_M2 | EMU816_TIME_DL,                // 46 lsr  dpag
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 47 eor  dpil
+    3 | EMU816_TIME_M,                                  // 48 pha  impl
+    2 | EMU816_TIME_M,                                  // 49 eor  immm
+    2,                                                  // 4a lsra impl
+    3,                                                  // 4b phk  impl
+    3,                                                  // 4c jmp  absl
+    4 | EMU816_TIME_M,                                  // 4d eor  absl
+    6 | EMU816_TIME_M2,                                 // 4e lsr  absl
+    5 | EMU816_TIME_M,                                  // 4f eor  alng
+    2 | EMU816_TIME_BR,                                 // 50 bvc  rela
+    5 | EMU816_TIME_M | EMU816_TIME_IX | EMU816_TIME_DL,// 51 eor  dpiy
+    5 | EMU816_TIME_M | EMU816_TIME_DL,                 // 52 eor  dpgi
+    7 | EMU816_TIME_M,                                  // 53 eor  sriy
+    7,                                                  // 54 mvn  immw
+    4 | EMU816_TIME_M | EMU816_TIME_DL,                 // 55 eor  dpgx
+    6 | EMU816_TIME_M2 | EMU816_TIME_DL,                // 56 lsr  dpgx
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 57 eor  dpil
+    2,                                                  // 58 cli  impl
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // 59 eor  absy
+    3 | EMU816_TIME_X,                                  // 5a phy  impl
+    2,                                                  // 5b tcd  impl
+    4,                                                  // 5c jmp  alng
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // 5d eor  absx
+    7 | EMU816_TIME_M2,                                 // 5e lsr  absx
+    5 | EMU816_TIME_M,                                  // 5f eor  alnx
+    6,                                                  // 60 rts  impl
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 61 adc  dpix
+    6,                                                  // 62 per  lrel
+    4 | EMU816_TIME_M,                                  // 63 adc  srel
+    3 | EMU816_TIME_M | EMU816_TIME_DL,                 // 64 stz  dpag
+    3 | EMU816_TIME_M | EMU816_TIME_DL,                 // 65 adc  dpag
+    5 | EMU816_TIME_M2 | EMU816_TIME_DL,                // 66 ror  dpag
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 67 adc  dpil
+    4 | EMU816_TIME_M,                                  // 68 pla  impl
+    2 | EMU816_TIME_M,                                  // 69 adc  immm
+    2,                                                  // 6a rora impl
+    6,                                                  // 6b rtl  impl
+    5,                                                  // 6c jmp  absi
+    4 | EMU816_TIME_M,                                  // 6d adc  absl
+    6 | EMU816_TIME_M2,                                 // 6e ror  absl
+    5 | EMU816_TIME_M,                                  // 6f adc  alng
+    2 | EMU816_TIME_BR,                                 // 70 bvs  rela
+    5 | EMU816_TIME_M | EMU816_TIME_IX | EMU816_TIME_DL,// 71 adc  dpiy
+    5 | EMU816_TIME_M | EMU816_TIME_DL,                 // 72 adc  dpgi
+    7 | EMU816_TIME_M,                                  // 73 adc  sriy
+    4 | EMU816_TIME_M | EMU816_TIME_DL,                 // 74 stz  dpgx
+    4 | EMU816_TIME_M | EMU816_TIME_DL,                 // 75 adc  dpgx
+    6 | EMU816_TIME_M2 | EMU816_TIME_DL,                // 76 ror  dpgx
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 77 adc  dily
+    2,                                                  // 78 sei  impl
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // 79 adc  absy
+    4 | EMU816_TIME_X,                                  // 7a ply  impl
+    2,                                                  // 7b tdc  impl
+    6,                                                  // 7c jmp  abxi
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // 7d adc  absx
+    7 | EMU816_TIME_M2,                                 // 7e ror  absx
+    5 | EMU816_TIME_M,                                  // 7f adc  alnx
+    2 | EMU816_TIME_BR,                                 // 80 bra  rela
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 81 sta  dpix
+    4,                                                  // 82 brl  lrel
+    4 | EMU816_TIME_M,                                  // 83 sta  srel
+    3 | EMU816_TIME_X | EMU816_TIME_DL,                 // 84 sty  dpag
+    3 | EMU816_TIME_M | EMU816_TIME_DL,                 // 85 sta  dpag
+    3 | EMU816_TIME_X | EMU816_TIME_DL,                 // 86 stx  dpag
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 87 sta  dpil
+    2,                                                  // 88 dey  impl
+    2 | EMU816_TIME_M,                                  // 89 biti immm
+    2,                                                  // 8a txa  impl
+    3,                                                  // 8b phb  impl
+    4 | EMU816_TIME_X,                                  // 8c sty  absl
+    4 | EMU816_TIME_M,                                  // 8d sta  absl
+    4 | EMU816_TIME_X,                                  // 8e stx  absl
+    5 | EMU816_TIME_M,                                  // 8f sta  alng
+    2 | EMU816_TIME_BR,                                 // 90 bcc  rela
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 91 sta  dpiy
+    5 | EMU816_TIME_M | EMU816_TIME_DL,                 // 92 sta  dpgi
+    7 | EMU816_TIME_M,                                  // 93 sta  sriy
+    4 | EMU816_TIME_X | EMU816_TIME_DL,                 // 94 sty  dpgx
+    4 | EMU816_TIME_M | EMU816_TIME_DL,                 // 95 sta  dpgx
+    4 | EMU816_TIME_X | EMU816_TIME_DL,                 // 96 stx  dpgy
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // 97 sta  dily
+    2,                                                  // 98 tya  impl
+    5 | EMU816_TIME_M,                                  // 99 sta  absy
+    2,                                                  // 9a txs  impl
+    2,                                                  // 9b txy  impl
+    4 | EMU816_TIME_M,                                  // 9c stz  absl
+    5 | EMU816_TIME_M,                                  // 9d sta  absx
+    5 | EMU816_TIME_M,                                  // 9e stz  absx
+    5 | EMU816_TIME_M,                                  // 9f sta  alnx
+    2 | EMU816_TIME_X,                                  // a0 ldy  immx
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // a1 lda  dpix
+    2 | EMU816_TIME_X,                                  // a2 ldx  immx
+    4 | EMU816_TIME_M,                                  // a3 lda  srel
+    3 | EMU816_TIME_X | EMU816_TIME_DL,                 // a4 ldy  dpag
+    3 | EMU816_TIME_M | EMU816_TIME_DL,                 // a5 lda  dpag
+    3 | EMU816_TIME_X | EMU816_TIME_DL,                 // a6 ldx  dpag
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // a7 lda  dpil
+    2,                                                  // a8 tay  impl
+    2 | EMU816_TIME_M,                                  // a9 lda  immm
+    2,                                                  // aa tax  impl
+    4,                                                  // ab plb  impl
+    4 | EMU816_TIME_X,                                  // ac ldy  absl
+    4 | EMU816_TIME_M,                                  // ad lda  absl
+    4 | EMU816_TIME_X,                                  // ae ldx  absl
+    5 | EMU816_TIME_M,                                  // af lda  alng
+    2 | EMU816_TIME_BR,                                 // b0 bcs  rela
+    5 | EMU816_TIME_M | EMU816_TIME_IX | EMU816_TIME_DL,// b1 lda  dpiy
+    5 | EMU816_TIME_M | EMU816_TIME_DL,                 // b2 lda  dpgi
+    7 | EMU816_TIME_M,                                  // b3 lda  sriy
+    4 | EMU816_TIME_X | EMU816_TIME_DL,                 // b4 ldy  dpgx
+    4 | EMU816_TIME_M | EMU816_TIME_DL,                 // b5 lda  dpgx
+    4 | EMU816_TIME_X | EMU816_TIME_DL,                 // b6 ldx  dpgy
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // b7 lda  dily
+    2,                                                  // b8 clv  impl
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // b9 lda  absy
+    2,                                                  // ba tsx  impl
+    2,                                                  // bb tyx  impl
+    4 | EMU816_TIME_X | EMU816_TIME_IX,                 // bc ldy  absx
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // bd lda  absx
+    4 | EMU816_TIME_X | EMU816_TIME_IX,                 // be ldx  absy
+    5 | EMU816_TIME_M,                                  // bf lda  alnx
+    2 | EMU816_TIME_X,                                  // c0 cpy  immx
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // c1 cmp  dpix
+    3,                                                  // c2 rep  immb
+    4 | EMU816_TIME_M,                                  // c3 cmp  srel
+    3 | EMU816_TIME_X | EMU816_TIME_DL,                 // c4 cpy  dpag
+    3 | EMU816_TIME_M | EMU816_TIME_DL,                 // c5 cmp  dpag
+    5 | EMU816_TIME_M2 | EMU816_TIME_DL,                // c6 dec  dpag
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // c7 cmp  dpil
+    2,                                                  // c8 iny  impl
+    2 | EMU816_TIME_M,                                  // c9 cmp  immm
+    2,                                                  // ca dex  impl
+    3,                                                  // cb wai  impl
+    4 | EMU816_TIME_X,                                  // cc cpy  absl
+    4 | EMU816_TIME_M,                                  // cd cmp  absl
+    6 | EMU816_TIME_M2,                                 // ce dec  absl
+    5 | EMU816_TIME_M,                                  // cf cmp  alng
+    2 | EMU816_TIME_BR,                                 // d0 bne  rela
+    5 | EMU816_TIME_M | EMU816_TIME_IX | EMU816_TIME_DL,// d1 cmp  dpiy
+    5 | EMU816_TIME_M | EMU816_TIME_DL,                 // d2 cmp  dpgi
+    7 | EMU816_TIME_M,                                  // d3 cmp  sriy
+    6 | EMU816_TIME_DL,                                 // d4 pei  dpag
+    4 | EMU816_TIME_M | EMU816_TIME_DL,                 // d5 cmp  dpgx
+    6 | EMU816_TIME_M2 | EMU816_TIME_DL,                // d6 dec  dpgx
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // d7 cmp  dily
+    2,                                                  // d8 cld  impl
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // d9 cmp  absy
+    3 | EMU816_TIME_X,                                  // da phx  impl
+    3,                                                  // db stp  impl
+    6,                                                  // dc jmp  abil
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // dd cmp  absx
+    7 | EMU816_TIME_M2,                                 // de dec  absx
+    5 | EMU816_TIME_M,                                  // df cmp  alnx
+    2 | EMU816_TIME_X,                                  // e0 cpx  immx
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // e1 sbc  dpix
+    3,                                                  // e2 sep  immb
+    4 | EMU816_TIME_M,                                  // e3 sbc  srel
+    3 | EMU816_TIME_X | EMU816_TIME_DL,                 // e4 cpx  dpag
+    3 | EMU816_TIME_M | EMU816_TIME_DL,                 // e5 sbc  dpag
+    5 | EMU816_TIME_M2 | EMU816_TIME_DL,                // e6 inc  dpag
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // e7 sbc  dpil
+    2,                                                  // e8 inx  impl
+    2 | EMU816_TIME_M,                                  // e9 sbc  immm
+    2,                                                  // ea nop  impl
+    3,                                                  // eb xba  impl
+    4 | EMU816_TIME_X,                                  // ec cpx  absl
+    4 | EMU816_TIME_M,                                  // ed sbc  absl
+    6 | EMU816_TIME_M2,                                 // ee inc  absl
+    5 | EMU816_TIME_M,                                  // ef sbc  alng
+    2 | EMU816_TIME_BR,                                 // f0 beq  rela
+    5 | EMU816_TIME_M | EMU816_TIME_IX | EMU816_TIME_DL,// f1 sbc  dpiy
+    5 | EMU816_TIME_M | EMU816_TIME_DL,                 // f2 sbc  dpgi
+    7 | EMU816_TIME_M,                                  // f3 sbc  sriy
+    5,                                                  // f4 pea  immw
+    4 | EMU816_TIME_M | EMU816_TIME_DL,                 // f5 sbc  dpgx
+    6 | EMU816_TIME_M2 | EMU816_TIME_DL,                // f6 inc  dpgx
+    6 | EMU816_TIME_M | EMU816_TIME_DL,                 // f7 sbc  dily
+    2,                                                  // f8 sed  impl
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // f9 sbc  absy
+    4 | EMU816_TIME_X,                                  // fa plx  impl
+    2,                                                  // fb xce  impl
+    8,                                                  // fc jsr  abxi
+    4 | EMU816_TIME_M | EMU816_TIME_IX,                 // fd sbc  absx
+    7 | EMU816_TIME_M2,                                 // fe inc  absx
+    5 | EMU816_TIME_M                                   // ff sbc  alnx
+};
+
+// The cycles an opcode takes in a mode, before the penalties that depend on
+// D, the index values or the branch being taken. m8 and x8 are true when the
+// accumulator or index registers are eight bits wide.
+constexpr uint32_t emu816_cycles(uint8_t opcode, bool e, bool m8, bool x8)
+{
+    return ((emu816_timing[opcode] & EMU816_TIME_CYCLES)
+        + ((emu816_timing[opcode] & EMU816_TIME_M) && !m8)
+        + ((emu816_timing[opcode] & EMU816_TIME_M2) && !m8) * 2
+        + ((emu816_timing[opcode] & EMU816_TIME_X) && !x8)
+        + ((emu816_timing[opcode] & EMU816_TIME_IX) && !x8)
+        + ((emu816_timing[opcode] & EMU816_TIME_N) && !e));
+}
+
+// The most cycles an opcode can take in a mode, excluding the repeats of a
+// block move
+constexpr uint32_t emu816_max_cycles(uint8_t opcode, bool e, bool m8, bool x8)
+{
+    return (emu816_cycles(opcode, e, m8, x8)
+        + ((emu816_timing[opcode] & EMU816_TIME_DL) != 0)
+        + ((emu816_timing[opcode] & EMU816_TIME_IX) && x8)
+        + ((emu816_timing[opcode] & EMU816_TIME_BR) ? 1 + e : 0));
+}
+
+// LDY a,X and LDX a,Y take a cycle for 16-bit index registers and another
+// for the indexing, so both flags count. Every engine reads this table, so
+// comparing them cannot catch a mistake here.
+static_assert(emu816_cycles(0xbc, false, false, false) == 6, "LDY a,X with 16-bit X");
+static_assert(emu816_cycles(0xbe, false, false, false) == 6, "LDX a,Y with 16-bit X");
+static_assert(emu816_max_cycles(0xbc, true, true, true) == 5, "LDY a,X crossing a page");
+static_assert(emu816_max_cycles(0xbe, false, true, true) == 5, "LDX a,Y crossing a page");
+
+#endif
+
@@ -0,0 +1,287 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo   
+//                                         d88'   `8. o888    .88'     
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'      
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo. 
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88 
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P 
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'  
+//                                                                    
+// A Portable C++ WDC 65C816 Emulator  
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// A profile of guest code built from the calls, interrupts and returns the
+// processor makes, with symbols read from assembler label files.
+
+#include <emu816_profile.h>
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+
+namespace {
+
+// The routine of the path at the top, outside any call seen
+const uint32_t s_top = 0xFFFFFFFF;
+
+// Parse a number written in one of the common assembler styles: $c123,
+// 0xc123, c123h or decimal, or bare hex if told so
+bool parse_number(std::string text, uint32_t &value, bool hex)
+{
+    int base = hex ? 16 : 10;
+
+    if (text.size() > 1 && text[0] == '$')
+        text.erase(0, 1), base = 16;
+    else if (text.size() > 2 && text[0] == '0' && tolower(text[1]) == 'x')
+        text.erase(0, 2), base = 16;
+    else if (text.size() > 1 && tolower(text[text.size() - 1]) == 'h')
+        text.erase(text.size() - 1), base = 16;
+
+    if (text.empty() || text.size() > 8) return (false);
+    for (size_t n = 0; n < text.size(); ++n)
+        if (!(base == 16 ? isxdigit(text[n]) : isdigit(text[n]))) return (false);
+    value = (uint32_t)strtoul(text.c_str(), NULL, base);
+    return (true);
+}
+
+// The cycles charged to one routine over all the paths it was called on
+struct TOTAL {
+    uint32_t                routine;
+    uint64_t                inclusive;
+    uint64_t                exclusive;
+    uint64_t                calls;
+};
+
+// Order routines by their inclusive cycles, most first
+bool costlier(const TOTAL &l, const TOTAL &r)
+{
+    if (l.inclusive != r.inclusive) return (l.inclusive > r.inclusive);
+    return (l.exclusive > r.exclusive);
+}
+
+// Whether a word assigns a value to a label, as in "name equ $c123"
+bool is_assignment(std::string word)
+{
+    std::transform(word.begin(), word.end(), word.begin(), ::tolower);
+    return (word == "=" || word == ":=" || word == "equ" || word == ".equ"
+            || word == ".set" || word == "set" || word == "gequ");
+}
+
+}
+
+emu816_profile::emu816_profile()
+{
+    clear();
+}
+
+// Read the labels in a symbol file, guessing its format line by line
+size_t emu816_profile::load_symbols(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    char line[512];
+    size_t count = 0;
+
+    if (!file) return (0);
+    while (fgets(line, sizeof(line), file)) {
+        std::vector<std::string> words;
+        uint32_t bank, ea;
+        char *p;
+
+        // Drop comments and split the rest into words, with '=' always
+        // a word of its own
+        if ((p = strchr(line, ';')) != NULL) *p = '\0';
+        for (p = line; *p; ) {
+            if (isspace((unsigned char)*p))
+                ++p;
+            else if (*p == '=')
+                words.push_back("="), ++p;
+            else {
+                char *start = p;
+
+                while (*p && !isspace((unsigned char)*p) && *p != '=') ++p;
+                words.push_back(std::string(start, p - start));
+            }
+        }
+        if (words.size() < 2 || words[0][0] == '[') continue;
+
+        std::string &first = words[0];
+        size_t colon = first.find(':');
+
+        if (first == "al" && words.size() >= 3) {
+            // VICE: "al C:c123 .name" or "al 00C123 .name"
+            std::string value = words[1];
+            std::string label = words[2];
+
+            if (value.size() > 2 && value[1] == ':') value.erase(0, 2);
+            if (label[0] == '.') label.erase(0, 1);
+            if (!parse_number(value, ea, true) || label.empty()) continue;
+            add_symbol(ea, label.c_str());
+        }
+        else if (colon != std::string::npos && colon > 0 && colon + 1 < first.size()
+                 && parse_number(first.substr(0, colon), bank, true)
+                 && parse_number(first.substr(colon + 1), ea, true)) {
+            // WLA-DX and bsnes: "00:c123 name"
+            add_symbol((bank << 16) | (ea & 0xffff), words[1].c_str());
+        }
+        else if (words.size() >= 3 && is_assignment(words[1])) {
+            // Assignments: "name = $c123", "name: equ $c123"
+            std::string label = first;
+
+            if (label[label.size() - 1] == ':') label.erase(label.size() - 1);
+            if (!parse_number(words[2], ea, false) || label.empty()) continue;
+            add_symbol(ea, label.c_str());
+        }
+        else if (words.size() == 2 && parse_number(first, ea, true)) {
+            // Lists: "00c123 name"
+            add_symbol(ea, words[1].c_str());
+        }
+        else
+            continue;
+        ++count;
+    }
+    fclose(file);
+    return (count);
+}
+
+// Name an address, keeping the first name given to each
+void emu816_profile::add_symbol(uint32_t ea, const char *name)
+{
+    m_symbols.insert(std::make_pair(ea & 0xffffff, std::string(name)));
+}
+
+// Forget everything but the symbols
+void emu816_profile::clear()
+{
+    NODE top = { s_top, -1, -1, 0, 0 };
+
+    m_nodes.assign(1, top);
+    m_stack.clear();
+    m_children.clear();
+    m_current = 0;
+    m_last = 0;
+}
+
+// Find or add the path calling a routine from the current one, when it is
+// not the one called last
+int emu816_profile::child(uint32_t routine)
+{
+    uint64_t key = ((uint64_t)m_current << 24) | routine;
+    std::unordered_map<uint64_t, int>::iterator found = m_children.find(key);
+    int index;
+
+    if (found != m_children.end())
+        index = found->second;
+    else {
+        NODE added = { routine, m_current, -1, 0, 0 };
+
+        index = (int)m_nodes.size();
+        m_nodes.push_back(added);
+        m_children[key] = index;
+    }
+    m_nodes[m_current].last_child = index;
+    return (index);
+}
+
+// The clock went back, e.g. on a reset or a snapshot being loaded, so the
+// frames held no longer mean anything. Start again at the top.
+void emu816_profile::unwind(uint64_t cycles)
+{
+    m_stack.clear();
+    m_current = 0;
+    m_last = cycles;
+}
+
+// The label of a routine, or the nearest one before it in the same bank
+// with an offset, or else its address
+std::string emu816_profile::name(uint32_t routine)
+{
+    char text[32];
+
+    if (routine == s_top) return ("[top]");
+
+    std::map<uint32_t, std::string>::iterator after = m_symbols.upper_bound(routine);
+
+    if (after != m_symbols.begin()) {
+        std::map<uint32_t, std::string>::iterator at = after;
+
+        --at;
+        if (at->first == routine) return (at->second);
+        if ((at->first >> 16) == (routine >> 16)) {
+            snprintf(text, sizeof(text), "+$%X", routine - at->first);
+            return (at->second + text);
+        }
+    }
+    snprintf(text, sizeof(text), "$%02X:%04X", routine >> 16, routine & 0xffff);
+    return (text);
+}
+
+// Write the cycles spent in each routine and those it calls (inclusive),
+// in it alone (exclusive) and the times it was called, most costly first.
+// A recursive routine is only counted once on each path.
+bool emu816_profile::write_report(FILE *file)
+{
+    std::vector<uint64_t> subtree(m_nodes.size());
+    std::map<uint32_t, TOTAL> totals;
+    std::vector<TOTAL> sorted;
+    int n;
+
+    // Children always come after their parents
+    for (n = (int)m_nodes.size() - 1; n >= 0; --n) {
+        subtree[n] += m_nodes[n].self;
+        if (n > 0) subtree[m_nodes[n].parent] += subtree[n];
+    }
+    for (n = 0; n < (int)m_nodes.size(); ++n) {
+        const NODE &node = m_nodes[n];
+        TOTAL &total = totals[node.routine];
+        int up;
+
+        total.routine = node.routine;
+        total.exclusive += node.self;
+        total.calls += node.calls;
+        for (up = node.parent; up >= 0 && m_nodes[up].routine != node.routine; )
+            up = m_nodes[up].parent;
+        if (up < 0) total.inclusive += subtree[n];
+    }
+    for (std::map<uint32_t, TOTAL>::iterator t = totals.begin(); t != totals.end(); ++t)
+        sorted.push_back(t->second);
+    std::sort(sorted.begin(), sorted.end(), costlier);
+
+    double all = subtree[0] ? (double)subtree[0] : 1.0;
+
+    fprintf(file, "%14s %7s %14s %7s %10s  %s\n",
+        "inclusive", "%", "exclusive", "%", "calls", "routine");
+    for (size_t s = 0; s < sorted.size(); ++s) {
+        const TOTAL &t = sorted[s];
+
+        fprintf(file, "%14llu %6.2f%% %14llu %6.2f%% %10llu  %s\n",
+            (unsigned long long)t.inclusive, 100.0 * t.inclusive / all,
+            (unsigned long long)t.exclusive, 100.0 * t.exclusive / all,
+            (unsigned long long)t.calls, name(t.routine).c_str());
+    }
+    return (!ferror(file));
+}
+
+// Write a line for each call path that spent cycles in its last routine,
+// naming the routines from the top down: "[top];main;draw 1234"
+bool emu816_profile::write_collapsed(FILE *file)
+{
+    std::vector<std::string> names(m_nodes.size());
+
+    for (size_t n = 0; n < m_nodes.size(); ++n) {
+        const NODE &node = m_nodes[n];
+
+        names[n] = (n == 0) ? name(node.routine)
+                            : names[node.parent] + ";" + name(node.routine);
+        if (node.self)
+            fprintf(file, "%s %llu\n", names[n].c_str(), (unsigned long long)node.self);
+    }
+    return (!ferror(file));
+}
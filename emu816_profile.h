@@ -0,0 +1,112 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo   
+//                                         d88'   `8. o888    .88'     
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'      
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo. 
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88 
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P 
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'  
+//                                                                    
+// A Portable C++ WDC 65C816 Emulator  
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+#ifndef EMU816_PROFILE_H
+#define EMU816_PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A profile of where guest code spends its cycles. The processor tells it
+// of every subroutine call, interrupt and return, and it keeps a shadow of
+// the call stack and a tree of the call paths seen, charging the cycles
+// between one call or return and the next to the routine then running.
+//
+// A return unwinds every frame whose return address it pulled, judged by
+// the stack pointer, so routines that return through an outer frame or
+// jump with a pushed address and RTS are followed. Routines are named from
+// the symbols loaded, or by address.
+class emu816_profile
+{
+    public:
+
+        emu816_profile();
+
+        // Read the labels in an assembler's symbol file: VICE label files
+        // as written by ld65 ("al 00C123 .name"), WLA-DX and bsnes symbol
+        // files ("00:c123 name"), assignments ("name = $c123", "name equ
+        // $c123") and plain "c123 name" lists. Returns the number read.
+        size_t                  load_symbols(const char *path);
+        void                    add_symbol(uint32_t ea, const char *name);
+
+        // Used by the processor. Cycles run before start() is called, as
+        // when the profile is attached, are not charged to anything.
+        void                    start(uint64_t cycles)
+                                    { m_last = cycles; }
+        void                    call(uint32_t routine, uint16_t sp, uint64_t cycles)
+                                    { int last = m_nodes[m_current].last_child;
+                                      charge(cycles);
+                                      m_current = (last >= 0 && m_nodes[last].routine == routine)
+                                                    ? last : child(routine);
+                                      ++m_nodes[m_current].calls;
+                                      m_stack.push_back({ m_current, sp }); }
+        void                    leave(uint16_t sp, uint64_t cycles)
+                                    { charge(cycles);
+                                      while (!m_stack.empty() && m_stack.back().sp < sp)
+                                          m_stack.pop_back();
+                                      m_current = m_stack.empty() ? 0 : m_stack.back().node; }
+        void                    charge(uint64_t cycles)
+                                    { if (cycles < m_last) unwind(cycles);
+                                      m_nodes[m_current].self += cycles - m_last;
+                                      m_last = cycles; }
+
+        // Forget the cycles counted and the call paths seen
+        void                    clear();
+
+        // Write a table of the cycles spent in each routine including and
+        // excluding the routines it calls, or the cycles spent on each call
+        // path in the collapsed stack format read by flamegraph tools.
+        bool                    write_report(FILE *file);
+        bool                    write_collapsed(FILE *file);
+
+    private:
+
+        // A call path, by the routine called and the path it was called on
+        struct NODE {
+            uint32_t                routine;
+            int                     parent;
+            int                     last_child;     // the child called most recently
+            uint64_t                self;
+            uint64_t                calls;
+        };
+
+        struct FRAME {
+            int                     node;
+            uint16_t                sp;             // after pushing the return state
+        };
+
+        std::vector<NODE>       m_nodes;
+        std::vector<FRAME>      m_stack;
+        std::unordered_map<uint64_t, int> m_children;
+        std::map<uint32_t, std::string> m_symbols;
+        int                     m_current;
+        uint64_t                m_last;
+
+        int                     child(uint32_t routine);
+        void                    unwind(uint64_t cycles);
+        std::string             name(uint32_t routine);
+};
+
+#endif
@@ -0,0 +1,395 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo
+//                                         d88'   `8. o888    .88'
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo.
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'
+//
+// A Portable C++ WDC 65C816 Emulator
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// Deterministic record and replay of the input a processor takes from its
+// devices: the values returned by the load functions and the changes to the
+// interrupt inputs.
+//
+// The log starts with a header of little-endian values:
+//
+//   "E8IL", version:1, starting cycle count:8
+//
+// Each entry then starts with a byte holding its kind in the low four bits
+// and the cycles since the previous entry in the high four. A count of 15
+// or more is given as 15, followed by the count as a base 128 varint
+// (least significant group first). The kind is followed by the value read
+// for a load (of 1, 2 or 3 bytes) or the IRQ source (1 byte) for a change
+// to the IRQ line. A rebase entry, giving a new cycle count as a varint,
+// comes before any entry whose cycle count is lower than that of the entry
+// before it, e.g. after reset().
+//
+// Changes to the interrupt inputs made by load and store functions are only
+// seen at the next instruction boundary, and are logged with its cycle
+// count. Those made by event callbacks or by the host between runs are
+// logged with the count at the time.
+
+#include <emu816.h>
+#include <string.h>
+
+namespace {
+
+const uint8_t s_magic[4] = { 'E', '8', 'I', 'L' };
+
+}
+
+// The log being recorded or replayed and, for a replay, its next entry
+struct emu816::INPUT {
+    emu816_sink_fn          sink;
+    emu816_source_fn        source;
+    void *                  context;
+    emu816_event_t          event;
+
+    uint8_t                 buffer[EMU816_RECORD_BUFFER];
+    size_t                  used;
+    size_t                  pos;
+    uint64_t                last;           // cycle count of the last entry
+    std::vector<uint8_t>    deferred;       // kind and source of each change
+
+    uint8_t                 kind;
+    uint64_t                cycle;
+    uint32_t                value;
+
+    static int              size(uint8_t kind)
+                                { return ((kind <= LOG_LOAD24) ? kind
+                                            : (kind <= LOG_RELEASE) ? 1 : 0); }
+
+    void                    put(uint8_t byte)
+                                { buffer[used++] = byte; }
+    void                    put_number(uint64_t number);
+    void                    write(uint8_t kind, uint64_t cycle, uint32_t value);
+    void                    flush();
+
+    int                     get();
+    bool                    get_number(uint64_t &number);
+    bool                    read();
+};
+
+// Append a varint to a recording
+void emu816::INPUT::put_number(uint64_t number)
+{
+    while (number >= 0x80) {
+        put((uint8_t)(number | 0x80));
+        number >>= 7;
+    }
+    put((uint8_t)number);
+}
+
+// Append an entry to a recording, passing the buffer on first if it might
+// not have room
+void emu816::INPUT::write(uint8_t kind, uint64_t cycle, uint32_t value)
+{
+    if (used > EMU816_RECORD_BUFFER - 32) flush();
+
+    if (cycle < last) {
+        put(LOG_REBASE);
+        put_number(cycle);
+        last = cycle;
+    }
+
+    uint64_t delta = cycle - last;
+
+    last = cycle;
+    if (delta < 15)
+        put((uint8_t)(kind | (delta << 4)));
+    else {
+        put((uint8_t)(kind | 0xf0));
+        put_number(delta);
+    }
+    for (int n = 0; n < size(kind); ++n)
+        put((uint8_t)(value >> (8 * n)));
+}
+
+// Pass the buffered part of a recording to the sink
+void emu816::INPUT::flush()
+{
+    if (used) sink(context, buffer, used);
+    used = 0;
+}
+
+// Take the next byte of a replayed log, refilling the buffer from the
+// source when it is empty. Returns -1 at the end of the log.
+int emu816::INPUT::get()
+{
+    if (pos == used) {
+        used = source(context, buffer, EMU816_RECORD_BUFFER);
+        pos = 0;
+        if (!used) return (-1);
+    }
+    return (buffer[pos++]);
+}
+
+// Take a varint from a replayed log
+bool emu816::INPUT::get_number(uint64_t &number)
+{
+    number = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = get();
+
+        if (byte < 0) return (false);
+        number |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return (true);
+    }
+    return (false);
+}
+
+// Decode the next entry of a replayed log. Returns false if the log ends
+// or is malformed.
+bool emu816::INPUT::read()
+{
+    for (;;) {
+        int tag = get();
+        uint64_t delta;
+
+        if (tag < 0) return (false);
+        kind = tag & 0x0f;
+        if (kind == LOG_REBASE) {
+            if (!get_number(last)) return (false);
+            continue;
+        }
+        if (kind < LOG_LOAD8 || kind > LOG_END) return (false);
+
+        delta = tag >> 4;
+        if (delta == 15 && !get_number(delta)) return (false);
+        cycle = last += delta;
+
+        value = 0;
+        for (int n = 0; n < size(kind); ++n) {
+            int byte = get();
+
+            if (byte < 0) return (false);
+            value |= (uint32_t)byte << (8 * n);
+        }
+        return (true);
+    }
+}
+
+// Start logging input to the sink, ending any recording or replay
+void emu816::start_recording(emu816_sink_fn fn, void *context)
+{
+    end_input();
+
+    m_input = new INPUT;
+    m_input->sink = fn;
+    m_input->context = context;
+    m_input->used = 0;
+    m_input->last = m_cycles;
+    m_inputs = INPUT_RECORD;
+
+    for (uint32_t n = 0; n < sizeof(s_magic); ++n)
+        m_input->put(s_magic[n]);
+    m_input->put(EMU816_RECORD_VERSION);
+    for (int n = 0; n < 8; ++n)
+        m_input->put((uint8_t)(m_cycles >> (8 * n)));
+}
+
+// Pass everything recorded so far to the sink
+void emu816::flush_recording()
+{
+    if (m_inputs == INPUT_RECORD) m_input->flush();
+}
+
+// End the log and pass the rest of it to the sink
+void emu816::stop_recording()
+{
+    if (m_inputs == INPUT_RECORD) end_input();
+}
+
+// Start replaying a log read from the source, ending any recording or
+// replay. Returns false if the log is not valid or was recorded from a
+// different cycle count, or no event is free.
+bool emu816::start_replay(emu816_source_fn fn, void *context)
+{
+    INPUT *input = new INPUT;
+    uint8_t header[sizeof(s_magic) + 9];
+    uint64_t start = 0;
+
+    end_input();
+
+    input->source = fn;
+    input->context = context;
+    input->used = 0;
+    input->pos = 0;
+    for (uint32_t n = 0; n < sizeof(header); ++n) {
+        int byte = input->get();
+
+        header[n] = (byte < 0) ? 0 : (uint8_t)byte;
+    }
+    for (int n = 0; n < 8; ++n)
+        start |= (uint64_t)header[sizeof(s_magic) + 1 + n] << (8 * n);
+    input->last = start;
+
+    if (memcmp(header, s_magic, sizeof(s_magic)) || header[sizeof(s_magic)] != EMU816_RECORD_VERSION
+            || start != m_cycles || !input->read()) {
+        delete input;
+        return (false);
+    }
+
+    input->event = add_event(replay_event, this);
+    if (input->event == EMU816_NO_EVENT) {
+        delete input;
+        return (false);
+    }
+
+    m_input = input;
+    m_inputs = INPUT_REPLAY;
+    m_diverged = false;
+    arm_replay();
+    return (true);
+}
+
+// Abandon a replay and use the load functions again
+void emu816::stop_replay()
+{
+    if (m_inputs == INPUT_REPLAY) end_input();
+}
+
+// End the current recording or replay
+void emu816::end_input()
+{
+    if (m_inputs == INPUT_RECORD) {
+        input_boundary();
+        m_input->write(LOG_END, m_cycles, 0);
+        m_input->flush();
+    }
+    else if (m_inputs == INPUT_REPLAY)
+        remove_event(m_input->event);
+
+    delete m_input;
+    m_input = NULL;
+    m_inputs = INPUT_NONE;
+}
+
+// Pass a load from memory behind the load functions on to them and log
+// the value, or answer it from the replayed log. Where an access falls
+// within an instruction depends on the engine, so a replayed load need only
+// be of the same size and within an instruction of the recorded one.
+uint32_t emu816::input(emu816_addr_t ea, int size)
+{
+    if (m_inputs == INPUT_RECORD) {
+        uint32_t value = (size == 1) ? load8(ea) : (size == 2) ? load16(ea) : load24(ea);
+
+        m_input->write(size, m_cycles, value);
+        return (value);
+    }
+
+    // Changes logged before the load, e.g. by the host, come first
+    replay_due();
+    if (m_inputs == INPUT_REPLAY) {
+        INPUT &in = *m_input;
+
+        if (in.kind == size && in.cycle <= m_cycles + EMU816_MAX_CYCLES
+                && m_cycles <= in.cycle + EMU816_MAX_CYCLES) {
+            uint32_t value = in.value;
+
+            if (in.read())
+                arm_replay();
+            else
+                finish_replay(false);
+            return (value);
+        }
+        finish_replay(true);
+    }
+    return ((size == 1) ? load8(ea) : (size == 2) ? load16(ea) : load24(ea));
+}
+
+// Log a change to the interrupt inputs. Returns false while replaying,
+// when only the log may change them.
+bool emu816::input_irq(uint8_t kind, uint32_t source)
+{
+    if (m_inputs == INPUT_REPLAY) return (false);
+
+    // Made by a load or store function, so logged once the engine has
+    // stopped at the end of the instruction
+    if (m_in_engine) {
+        m_input->deferred.push_back(kind);
+        m_input->deferred.push_back((uint8_t)(source & 31));
+        lower_horizon(0);
+    }
+    else
+        m_input->write(kind, m_cycles, source & 31);
+    return (true);
+}
+
+// Log the changes to the interrupt inputs made while the engine ran, at
+// the boundary where it stopped
+void emu816::input_boundary()
+{
+    std::vector<uint8_t> &deferred = m_input->deferred;
+
+    for (size_t n = 0; n < deferred.size(); n += 2)
+        m_input->write(deferred[n], m_cycles, deferred[n + 1]);
+    deferred.clear();
+}
+
+// End a replay at the end of its log, or where the program no longer
+// matches it, and stop at the end of the instruction
+void emu816::finish_replay(bool diverged)
+{
+    end_input();
+    m_diverged = diverged;
+    halt(EMU816_STOP_REPLAY);
+}
+
+// Make the changes to the interrupt inputs that are due from the replayed
+// log, and finish at its end or if the next load has not been made in time
+void emu816::replay_due()
+{
+    while (m_inputs == INPUT_REPLAY) {
+        INPUT &in = *m_input;
+
+        if (in.kind <= LOG_LOAD24) {
+            if (m_cycles > in.cycle + EMU816_MAX_CYCLES) finish_replay(true);
+            break;
+        }
+        if (in.cycle > m_cycles) break;
+
+        switch (in.kind) {
+        case LOG_ASSERT:    m_irq |= 1u << (in.value & 31);     break;
+        case LOG_RELEASE:   m_irq &= ~(1u << (in.value & 31));  break;
+        case LOG_NMI:       m_signals |= INT_NMI;               break;
+        case LOG_ABORT:     m_signals |= INT_ABORT;             break;
+        default:
+            finish_replay(false);
+            return;
+        }
+        update_interrupts();
+        if (!in.read()) {
+            finish_replay(false);
+            return;
+        }
+    }
+    if (m_inputs == INPUT_REPLAY) arm_replay();
+}
+
+// Schedule the replay event for the next change to the interrupt inputs
+// or the end of the log, or for when the next load is overdue
+void emu816::arm_replay()
+{
+    if (m_input->kind > LOG_LOAD24)
+        schedule(m_input->event, m_input->cycle);
+    else
+        schedule(m_input->event, m_input->cycle + EMU816_MAX_CYCLES + 1);
+}
+
+void emu816::replay_event(void *context, uint64_t)
+{
+    ((emu816 *)context)->replay_due();
+}
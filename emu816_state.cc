@@ -0,0 +1,356 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo
+//                                         d88'   `8. o888    .88'
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo.
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'
+//
+// A Portable C++ WDC 65C816 Emulator
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// Snapshots, copy-on-write forks and baselines of the processor state and
+// writable mapped memory.
+//
+// A snapshot holds little-endian values laid out as follows:
+//
+//   "E816", version:2, page bits:1, events:1
+//   a, x, y, sp, dp, pc:2 each, pbr, dbr, e, p:1 each, cycles:8
+//   stopped, stop reason, idle, NMI/ABORT signals:1 each, IRQ sources:4
+//   scheduled:1, then the heap of events in order, event:1, deadline:8
+//   runs:4, then for each run of writable pages, first:4, count:4, data
+//   device state length:4, device state
+//
+// Only the schedule of events is kept. The callbacks are registered by the
+// program and must be the same when a snapshot is loaded.
+
+#include <emu816.h>
+#include <string.h>
+
+namespace {
+
+const uint8_t s_magic[4] = { 'E', '8', '1', '6' };
+
+// Append a little-endian value of the given number of bytes
+void put(std::vector<uint8_t> &state, uint64_t value, int bytes)
+{
+    for (int n = 0; n < bytes; ++n)
+        state.push_back((uint8_t)(value >> (8 * n)));
+}
+
+// Takes values from a snapshot in order. Once it runs past the end every
+// value reads as zero and ok is cleared.
+struct READER {
+    const uint8_t *         data;
+    size_t                  size;
+    size_t                  pos;
+    bool                    ok;
+
+    const uint8_t *         take(size_t bytes)
+                                { if (bytes > size - pos) { ok = false; pos = size; return (NULL); }
+                                  pos += bytes; return (data + pos - bytes); }
+    uint64_t                get(int bytes)
+                                { const uint8_t *at = take(bytes);
+                                  uint64_t value = 0;
+                                  for (int n = 0; at && n < bytes; ++n)
+                                      value |= (uint64_t)at[n] << (8 * n);
+                                  return (value); }
+};
+
+}
+
+// Capture the registers, interrupt inputs and event schedule
+void emu816::get_core(CORE &core)
+{
+    core.a = a.w;
+    core.x = x.w;
+    core.y = y.w;
+    core.sp = sp.w;
+    core.dp = dp.w;
+    core.pc = pc;
+    core.pbr = pbr;
+    core.dbr = dbr;
+    core.e = e;
+    core.p = get_p();
+    core.cycles = m_cycles;
+    core.stopped = m_stopped;
+    core.stop_reason = m_stop_reason;
+    core.idle = m_idle;
+    core.signals = m_signals;
+    core.irq = m_irq;
+    core.scheduled = m_scheduled;
+    for (int n = 0; n < m_scheduled; ++n) {
+        core.heap[n] = m_heap[n];
+        core.deadline[n] = m_events[m_heap[n]].deadline;
+    }
+}
+
+// Return true if every event scheduled in a captured state is registered
+bool emu816::fits(const CORE &core)
+{
+    for (int n = 0; n < core.scheduled; ++n)
+        if (core.heap[n] >= EMU816_EVENTS || !m_events[core.heap[n]].fn) return (false);
+    return (core.scheduled <= EMU816_EVENTS && core.stop_reason <= EMU816_STOP_REPLAY
+                && core.idle <= EMU816_STOP_REPLAY);
+}
+
+// Replace the registers, interrupt inputs and event schedule
+void emu816::set_core(const CORE &core)
+{
+    a.w = core.a;
+    x.w = core.x;
+    y.w = core.y;
+    sp.w = core.sp;
+    dp.w = core.dp;
+    pc = core.pc;
+    pbr = core.pbr;
+    dbr = core.dbr;
+    e = core.e;
+    m_cycles = core.cycles;
+    m_stopped = core.stopped;
+    m_stop_reason = core.stop_reason;
+    m_idle = core.idle;
+    m_signals = core.signals;
+    m_irq = core.irq;
+    set_p(core.p);
+
+    for (int n = 0; n < EMU816_EVENTS; ++n)
+        m_events[n].heap = -1;
+    for (m_scheduled = 0; m_scheduled < core.scheduled; ++m_scheduled) {
+        m_events[core.heap[m_scheduled]].deadline = core.deadline[m_scheduled];
+        place(m_scheduled, core.heap[m_scheduled]);
+    }
+}
+
+// Replace the contents of state with a snapshot of the processor
+void emu816::save_state(std::vector<uint8_t> &state)
+{
+    CORE core;
+    uint32_t runs = 0;
+    uint32_t pages = 0;
+
+    get_core(core);
+    for (uint32_t pg = 0; pg < EMU816_PAGES; ++pg) {
+        if (!writable(pg)) continue;
+        if (pg == 0 || !writable(pg - 1)) ++runs;
+        ++pages;
+    }
+
+    state.clear();
+    state.reserve(64 + 9 * core.scheduled + 8 * runs + pages * EMU816_PAGE_SIZE);
+    for (uint32_t n = 0; n < sizeof(s_magic); ++n)
+        state.push_back(s_magic[n]);
+    put(state, EMU816_STATE_VERSION, 2);
+    put(state, EMU816_PAGE_BITS, 1);
+    put(state, EMU816_EVENTS, 1);
+
+    put(state, core.a, 2);
+    put(state, core.x, 2);
+    put(state, core.y, 2);
+    put(state, core.sp, 2);
+    put(state, core.dp, 2);
+    put(state, core.pc, 2);
+    put(state, core.pbr, 1);
+    put(state, core.dbr, 1);
+    put(state, core.e, 1);
+    put(state, core.p, 1);
+    put(state, core.cycles, 8);
+    put(state, core.stopped, 1);
+    put(state, core.stop_reason, 1);
+    put(state, core.idle, 1);
+    put(state, core.signals, 1);
+    put(state, core.irq, 4);
+
+    put(state, core.scheduled, 1);
+    for (int n = 0; n < core.scheduled; ++n) {
+        put(state, core.heap[n], 1);
+        put(state, core.deadline[n], 8);
+    }
+
+    put(state, runs, 4);
+    for (uint32_t pg = 0; pg < EMU816_PAGES; ++pg) {
+        uint32_t count = 0;
+
+        if (!writable(pg) || (pg > 0 && writable(pg - 1))) continue;
+        while (pg + count < EMU816_PAGES && writable(pg + count)) ++count;
+        put(state, pg, 4);
+        put(state, count, 4);
+        for (uint32_t n = 0; n < count; ++n) {
+            size_t at = state.size();
+
+            state.resize(at + EMU816_PAGE_SIZE);
+            memcpy(&state[at], writable(pg + n), EMU816_PAGE_SIZE);
+        }
+    }
+
+    size_t length = state.size();
+
+    put(state, 0, 4);
+    save_devices(state);
+    for (int n = 0; n < 4; ++n)
+        state[length + n] = (uint8_t)((state.size() - length - 4) >> (8 * n));
+}
+
+// Restore the processor from a snapshot. Returns false, leaving the
+// processor unchanged, if the snapshot is damaged, is from another version
+// or does not fit this processor's events and memory map.
+bool emu816::load_state(const uint8_t *state, size_t size)
+{
+    READER in = { state, size, 0, true };
+    const uint8_t *magic = in.take(sizeof(s_magic));
+    CORE core;
+
+    if (!magic || memcmp(magic, s_magic, sizeof(s_magic))
+            || in.get(2) != EMU816_STATE_VERSION || in.get(1) != EMU816_PAGE_BITS
+            || in.get(1) > EMU816_EVENTS)
+        return (false);
+
+    core.a = in.get(2);
+    core.x = in.get(2);
+    core.y = in.get(2);
+    core.sp = in.get(2);
+    core.dp = in.get(2);
+    core.pc = in.get(2);
+    core.pbr = in.get(1);
+    core.dbr = in.get(1);
+    core.e = in.get(1);
+    core.p = in.get(1);
+    core.cycles = in.get(8);
+    core.stopped = in.get(1);
+    core.stop_reason = (emu816_stop_t)in.get(1);
+    core.idle = (emu816_stop_t)in.get(1);
+    core.signals = in.get(1);
+    core.irq = in.get(4);
+
+    core.scheduled = in.get(1);
+    if (core.scheduled > EMU816_EVENTS) return (false);
+    for (int n = 0; n < core.scheduled; ++n) {
+        core.heap[n] = in.get(1);
+        core.deadline[n] = in.get(8);
+    }
+    if (!fits(core)) return (false);
+
+    // Every page saved must be mapped writable
+    uint32_t runs = in.get(4);
+    size_t memory = in.pos;
+
+    for (uint32_t run = 0; run < runs && in.ok; ++run) {
+        uint32_t first = in.get(4);
+        uint32_t count = in.get(4);
+
+        if (first >= EMU816_PAGES || count > EMU816_PAGES - first) return (false);
+        for (uint32_t n = 0; n < count; ++n)
+            if (!writable(first + n)) return (false);
+        in.take((size_t)count * EMU816_PAGE_SIZE);
+    }
+
+    uint32_t length = in.get(4);
+    const uint8_t *devices = in.take(length);
+
+    if (!in.ok || in.pos != size || !load_devices(devices, length))
+        return (false);
+
+    // The snapshot is good, so replace the processor state with it
+    set_core(core);
+    in.pos = memory;
+    for (uint32_t run = 0; run < runs; ++run) {
+        uint32_t first = in.get(4);
+        uint32_t count = in.get(4);
+
+        for (uint32_t pg = first; pg < first + count; ++pg) {
+            if (m_watch[pg]) written(pg);
+            memcpy(m_write[pg] ? m_write[pg] : copy_page(pg), in.take(EMU816_PAGE_SIZE), EMU816_PAGE_SIZE);
+        }
+    }
+    return (true);
+}
+
+// Become a copy-on-write fork of another processor
+bool emu816::fork_from(emu816 &parent)
+{
+    std::vector<uint8_t> devices;
+    CORE core;
+
+    parent.get_core(core);
+    if (!fits(core)) return (false);
+    parent.save_devices(devices);
+    if (!load_devices(devices.data(), devices.size())) return (false);
+    set_core(core);
+
+    // Writable pages are shared until written and the rest are mapped
+    // exactly as in the parent. Earlier copies are reused and any
+    // baseline is dropped.
+    for (uint32_t pg = 0; pg < EMU816_PAGES; ++pg) {
+        m_shared[pg] = parent.writable(pg);
+        m_read[pg] = parent.m_read[pg];
+        m_write[pg] = m_shared[pg] ? NULL : parent.m_write[pg];
+    }
+    m_copies_used = 0;
+    drop_baseline();
+    flush_blocks();
+    return (true);
+}
+
+// Take the current state as the baseline and start tracking the pages
+// written from now on
+void emu816::set_baseline()
+{
+    drop_baseline();
+    get_core(m_baseline);
+    save_devices(m_baseline_devices);
+    for (uint32_t pg = 0; pg < EMU816_PAGES; ++pg)
+        if (writable(pg)) m_watch[pg] |= WATCH_BASELINE;
+    m_has_baseline = true;
+}
+
+// Return to the baseline by restoring the pages written since it was set
+// or last returned to. Returns false if there is no baseline or the devices
+// reject their state.
+bool emu816::reset_to_baseline()
+{
+    if (!m_has_baseline
+            || !load_devices(m_baseline_devices.data(), m_baseline_devices.size()))
+        return (false);
+
+    for (size_t n = 0; n < m_dirty.size(); ++n) {
+        uint32_t pg = m_dirty[n];
+
+        if (m_watch[pg] & WATCH_CODE) invalidate_page(pg);
+        memcpy(m_write[pg], m_originals[n], EMU816_PAGE_SIZE);
+        m_watch[pg] |= WATCH_BASELINE;
+    }
+    m_dirty.clear();
+    set_core(m_baseline);
+    return (true);
+}
+
+// Stop tracking written pages
+void emu816::drop_baseline()
+{
+    for (uint32_t pg = 0; pg < EMU816_PAGES; ++pg)
+        m_watch[pg] &= ~WATCH_BASELINE;
+    m_dirty.clear();
+    m_baseline_devices.clear();
+    m_has_baseline = false;
+}
+
+// Keep the baseline contents of a page about to be written for the first
+// time since the baseline was set or returned to
+void emu816::keep_baseline(uint32_t page)
+{
+    if (m_dirty.size() == m_originals.size())
+        m_originals.push_back(new uint8_t[EMU816_PAGE_SIZE]);
+    memcpy(m_originals[m_dirty.size()], writable(page), EMU816_PAGE_SIZE);
+    m_dirty.push_back(page);
+    m_watch[page] &= ~WATCH_BASELINE;
+}
@@ -0,0 +1,149 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo   
+//                                         d88'   `8. o888    .88'     
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'      
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo. 
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88 
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P 
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'  
+//                                                                    
+// A Portable C++ WDC 65C816 Emulator  
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// A ring buffer of binary instruction trace records, which can be drained
+// to a file by a background thread.
+
+#include <emu816_trace.h>
+#include <chrono>
+#include <string.h>
+
+namespace {
+
+const uint8_t s_magic[4] = { 'E', '8', 'T', 'R' };
+
+// Records moved to a file at a time by the drain thread
+const size_t s_chunk = 4096;
+
+}
+
+// Create a ring holding at least the given number of records
+emu816_trace::emu816_trace(size_t records, bool overwrite)
+: m_mask(1)
+, m_overwrite(overwrite)
+, m_head(0)
+, m_tail_seen(0)
+, m_dropped(0)
+, m_tail(0)
+, m_draining(false)
+, m_file(NULL)
+{
+    while (m_mask + 1 < records) m_mask = (m_mask << 1) | 1;
+    m_records = new emu816_trace_t[m_mask + 1];
+}
+
+emu816_trace::~emu816_trace()
+{
+    stop_drain();
+    delete [] m_records;
+}
+
+// Called by the processor when the ring is full. An overwriting ring lets
+// go of its oldest record, any other drops the new one.
+bool emu816_trace::make_room()
+{
+    if (m_overwrite) {
+        m_tail_seen = m_head.load(std::memory_order_relaxed) - m_mask;
+        m_tail.store(m_tail_seen, std::memory_order_relaxed);
+        return (true);
+    }
+    m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return (false);
+}
+
+size_t emu816_trace::read(emu816_trace_t *records, size_t count)
+{
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    uint64_t head = m_head.load(std::memory_order_acquire);
+
+    if (count > head - tail) count = (size_t)(head - tail);
+    for (size_t n = 0; n < count; ++n)
+        records[n] = m_records[(tail + n) & m_mask];
+    m_tail.store(tail + count, std::memory_order_release);
+    return (count);
+}
+
+bool emu816_trace::write_header(FILE *file)
+{
+    uint8_t header[sizeof(s_magic) + 2];
+
+    memcpy(header, s_magic, sizeof(s_magic));
+    header[sizeof(s_magic)] = EMU816_TRACE_VERSION;
+    header[sizeof(s_magic) + 1] = sizeof(emu816_trace_t);
+    return (fwrite(header, sizeof(header), 1, file) == 1);
+}
+
+// Move the records held to a file. Returns false if it could not be
+// written.
+bool emu816_trace::write_records(FILE *file)
+{
+    emu816_trace_t chunk[256];
+    size_t count;
+
+    while ((count = read(chunk, sizeof(chunk) / sizeof(chunk[0]))) != 0)
+        if (fwrite(chunk, sizeof(chunk[0]), count, file) != count) return (false);
+    return (true);
+}
+
+bool emu816_trace::dump(FILE *file)
+{
+    return (write_header(file) && write_records(file) && fflush(file) == 0);
+}
+
+// Start a thread writing a dump to a file as records arrive. Returns false
+// if the ring overwrites, a drain is already running or the file cannot be
+// written.
+bool emu816_trace::start_drain(FILE *file)
+{
+    if (m_overwrite || m_draining.load() || !write_header(file)) return (false);
+
+    m_file = file;
+    m_draining.store(true);
+    m_drain = std::thread(&emu816_trace::drain, this);
+    return (true);
+}
+
+// Stop the drain thread once it has written every record committed so far
+void emu816_trace::stop_drain()
+{
+    if (!m_draining.load()) return;
+
+    m_draining.store(false);
+    m_drain.join();
+    write_records(m_file);
+    fflush(m_file);
+    m_file = NULL;
+}
+
+void emu816_trace::drain()
+{
+    emu816_trace_t *chunk = new emu816_trace_t[s_chunk];
+
+    while (m_draining.load(std::memory_order_relaxed)) {
+        size_t count = read(chunk, s_chunk);
+
+        if (count)
+            fwrite(chunk, sizeof(chunk[0]), count, m_file);
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    delete [] chunk;
+}
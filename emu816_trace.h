@@ -0,0 +1,116 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo   
+//                                         d88'   `8. o888    .88'     
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'      
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo. 
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88 
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P 
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'  
+//                                                                    
+// A Portable C++ WDC 65C816 Emulator  
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+#ifndef EMU816_TRACE_H
+#define EMU816_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+// Records held by a trace buffer unless given otherwise (a power of two)
+#define EMU816_TRACE_RECORDS    (1 << 16)
+
+// Version of the dump format written by emu816_trace
+#define EMU816_TRACE_VERSION    1
+
+// One executed instruction, with the registers as they were before it. The
+// operand bytes follow the opcode in memory, where it is mapped, and their
+// number depends on the opcode and the E, M and X flags. The effective
+// address is that of the last operand load or store the instruction made,
+// or EMU816_INVALID_PC if none.
+typedef struct {
+    uint64_t                cycles;
+    uint32_t                pc;             // bank and address of the opcode
+    uint32_t                ea;
+    uint16_t                a, x, y, sp, dp;
+    uint8_t                 dbr;
+    uint8_t                 p;
+    uint8_t                 e;
+    uint8_t                 opcode;
+    uint8_t                 operand[3];
+} emu816_trace_t;
+
+// A lock-free ring of trace records filled by one processor and emptied
+// by one other thread, such as the drain thread. When the ring is full new
+// records are dropped and counted, unless it was created to overwrite the
+// oldest instead. An overwriting ring may only be read while the processor
+// is not running, e.g. to look at the instructions leading up to a crash.
+//
+// A dump is a header of "E8TR", version:1, record size:1, followed by the
+// records in host byte order.
+class emu816_trace
+{
+    public:
+
+        emu816_trace(size_t records=EMU816_TRACE_RECORDS, bool overwrite=false);
+        ~emu816_trace();
+
+        // Used by the processor. reserve() returns NULL if the record is
+        // dropped, and a reserved record is only seen once committed.
+        emu816_trace_t *        reserve()
+                                    { uint64_t head = m_head.load(std::memory_order_relaxed);
+                                      if (head - m_tail_seen > m_mask) {
+                                          m_tail_seen = m_tail.load(std::memory_order_acquire);
+                                          if (head - m_tail_seen > m_mask && !make_room()) return (NULL);
+                                      }
+                                      return (&m_records[head & m_mask]); }
+        void                    commit()
+                                    { m_head.store(m_head.load(std::memory_order_relaxed) + 1,
+                                                   std::memory_order_release); }
+
+        // Take up to count of the oldest records, returning the number taken
+        size_t                  read(emu816_trace_t *records, size_t count);
+        uint64_t                dropped() { return (m_dropped.load(std::memory_order_relaxed)); }
+
+        // Write a dump of the records held, or have a thread write them to a
+        // file as they arrive until stop_drain(). Neither may be used on an
+        // overwriting ring while the processor is running.
+        bool                    dump(FILE *file);
+        bool                    start_drain(FILE *file);
+        void                    stop_drain();
+
+    private:
+
+        emu816_trace_t *        m_records;
+        uint64_t                m_mask;
+        bool                    m_overwrite;
+
+        // Written by the processor only, and its last sight of m_tail
+        alignas(64) std::atomic<uint64_t> m_head;
+        uint64_t                m_tail_seen;
+        std::atomic<uint64_t>   m_dropped;
+
+        // Written by the reader only
+        alignas(64) std::atomic<uint64_t> m_tail;
+
+        std::thread             m_drain;
+        std::atomic<bool>       m_draining;
+        FILE *                  m_file;
+
+        bool                    make_room();
+        bool                    write_header(FILE *file);
+        bool                    write_records(FILE *file);
+        void                    drain();
+};
+
+#endif
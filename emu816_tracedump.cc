@@ -0,0 +1,167 @@
+//==============================================================================
+//                                          .ooooo.     .o      .ooo   
+//                                         d88'   `8. o888    .88'     
+//  .ooooo.  ooo. .oo.  .oo.   oooo  oooo  Y88..  .8'  888   d88'      
+// d88' `88b `888P"Y88bP"Y88b  `888  `888   `88888b.   888  d888P"Ybo. 
+// 888ooo888  888   888   888   888   888  .8'  ``88b  888  Y88[   ]88 
+// 888    .o  888   888   888   888   888  `8.   .88P  888  `Y88   88P 
+// `Y8bod8P' o888o o888o o888o  `V88V"V8P'  `boood8'  o888o  `88bod8'  
+//                                                                    
+// A Portable C++ WDC 65C816 Emulator  
+//------------------------------------------------------------------------------
+// Copyright (C),2016 Andrew John Jacobs
+// All rights reserved.
+//
+// This work is made available under the terms of the Creative Commons
+// Attribution-NonCommercial-ShareAlike 4.0 International license. Open the
+// following URL to see the details.
+//
+// http://creativecommons.org/licenses/by-nc-sa/4.0/
+//------------------------------------------------------------------------------
+
+// Turns an instruction trace dump into a listing, one line per instruction:
+//
+//   emu816_tracedump [dump]
+//
+// reading the dump from standard input if no file is named.
+
+#include <emu816.h>
+#include <emu816_opcodes.h>
+#include <emu816_trace.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+// Mnemonic and addressing mode of each opcode
+#define EMU816_NAME(code, op, am, w, f)     #op,
+#define EMU816_MODE(code, op, am, w, f)     #am,
+
+const char * const s_names[256] = { EMU816_OPCODES(EMU816_NAME) };
+const char * const s_modes[256] = { EMU816_OPCODES(EMU816_MODE) };
+
+#undef EMU816_NAME
+#undef EMU816_MODE
+
+// The number of operand bytes for each addressing mode
+#define EMU816_LENGTH(mode) \
+    if (!strcmp(am, #mode)) return (EMU816_BYTES_##mode(m, x));
+
+int length(const char *am, bool m, bool x)
+{
+    EMU816_LENGTH(absl) EMU816_LENGTH(absx) EMU816_LENGTH(absy) EMU816_LENGTH(absi)
+    EMU816_LENGTH(abxi) EMU816_LENGTH(alng) EMU816_LENGTH(alnx) EMU816_LENGTH(abil)
+    EMU816_LENGTH(dpag) EMU816_LENGTH(dpgx) EMU816_LENGTH(dpgy) EMU816_LENGTH(dpgi)
+    EMU816_LENGTH(dpix) EMU816_LENGTH(dpiy) EMU816_LENGTH(dpil) EMU816_LENGTH(dily)
+    EMU816_LENGTH(impl) EMU816_LENGTH(acc) EMU816_LENGTH(immb) EMU816_LENGTH(immw)
+    EMU816_LENGTH(immm) EMU816_LENGTH(immx) EMU816_LENGTH(lrel) EMU816_LENGTH(rela)
+    EMU816_LENGTH(srel) EMU816_LENGTH(sriy)
+    return (0);
+}
+
+#undef EMU816_LENGTH
+
+// Format the mnemonic and operand of a traced instruction
+void disassemble(const emu816_trace_t &r, char *text, size_t size)
+{
+    const char *op = s_names[r.opcode];
+    const char *am = s_modes[r.opcode];
+    bool m = r.e || (r.p & 0x20);
+    bool x = r.e || (r.p & 0x10);
+    int bytes = length(am, m, x);
+    uint32_t value = 0;
+    char name[8];
+    char operand[24] = "";
+
+    for (int n = 0; n < bytes; ++n)
+        value |= (uint32_t)r.operand[n] << (8 * n);
+
+    // Accumulator forms are named apart from the memory forms
+    size_t len = strlen(op);
+
+    strcpy(name, op);
+    if (!strcmp(op, "asla") || !strcmp(op, "lsra") || !strcmp(op, "rola") || !strcmp(op, "rora")
+            || !strcmp(op, "inca") || !strcmp(op, "deca") || !strcmp(op, "biti")) {
+        name[len - 1] = '\0';
+        if (strcmp(op, "biti")) am = "acc";
+    }
+    for (char *c = name; *c; ++c)
+        *c = (char)(*c - 'a' + 'A');
+
+    uint16_t next = (uint16_t)(r.pc + 1 + bytes);
+
+    if (!strcmp(am, "absl")) snprintf(operand, sizeof(operand), "$%04X", value);
+    else if (!strcmp(am, "absx")) snprintf(operand, sizeof(operand), "$%04X,X", value);
+    else if (!strcmp(am, "absy")) snprintf(operand, sizeof(operand), "$%04X,Y", value);
+    else if (!strcmp(am, "absi")) snprintf(operand, sizeof(operand), "($%04X)", value);
+    else if (!strcmp(am, "abxi")) snprintf(operand, sizeof(operand), "($%04X,X)", value);
+    else if (!strcmp(am, "alng")) snprintf(operand, sizeof(operand), "$%06X", value);
+    else if (!strcmp(am, "alnx")) snprintf(operand, sizeof(operand), "$%06X,X", value);
+    else if (!strcmp(am, "abil")) snprintf(operand, sizeof(operand), "[$%04X]", value);
+    else if (!strcmp(am, "dpag")) snprintf(operand, sizeof(operand), r.opcode == 0xd4 ? "($%02X)" : "$%02X", value);
+    else if (!strcmp(am, "dpgx")) snprintf(operand, sizeof(operand), "$%02X,X", value);
+    else if (!strcmp(am, "dpgy")) snprintf(operand, sizeof(operand), "$%02X,Y", value);
+    else if (!strcmp(am, "dpgi")) snprintf(operand, sizeof(operand), "($%02X)", value);
+    else if (!strcmp(am, "dpix")) snprintf(operand, sizeof(operand), "($%02X,X)", value);
+    else if (!strcmp(am, "dpiy")) snprintf(operand, sizeof(operand), "($%02X),Y", value);
+    else if (!strcmp(am, "dpil")) snprintf(operand, sizeof(operand), "[$%02X]", value);
+    else if (!strcmp(am, "dily")) snprintf(operand, sizeof(operand), "[$%02X],Y", value);
+    else if (!strcmp(am, "acc")) snprintf(operand, sizeof(operand), "A");
+    else if (!strcmp(am, "immb") || !strcmp(am, "immm") || !strcmp(am, "immx"))
+        snprintf(operand, sizeof(operand), bytes == 1 ? "#$%02X" : "#$%04X", value);
+    else if (!strcmp(am, "immw")) {
+        if (r.opcode == 0x44 || r.opcode == 0x54)
+            snprintf(operand, sizeof(operand), "$%02X,$%02X", value >> 8, value & 0xff);
+        else
+            snprintf(operand, sizeof(operand), "$%04X", value);
+    }
+    else if (!strcmp(am, "rela"))
+        snprintf(operand, sizeof(operand), "$%04X", (uint16_t)(next + (int8_t)value));
+    else if (!strcmp(am, "lrel"))
+        snprintf(operand, sizeof(operand), "$%04X", (uint16_t)(next + (int16_t)value));
+    else if (!strcmp(am, "srel")) snprintf(operand, sizeof(operand), "$%02X,S", value);
+    else if (!strcmp(am, "sriy")) snprintf(operand, sizeof(operand), "($%02X,S),Y", value);
+
+    char hex[12] = "";
+
+    for (int n = 0; n < bytes; ++n)
+        snprintf(hex + 3 * n, sizeof(hex) - 3 * n, " %02X", r.operand[n]);
+    snprintf(text, size, "%02X%-9s %s %s", r.opcode, hex, name, operand);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    FILE *file = (argc > 1) ? fopen(argv[1], "rb") : stdin;
+    uint8_t header[6];
+    emu816_trace_t r;
+
+    if (!file) {
+        perror(argv[1]);
+        return (1);
+    }
+    if (fread(header, sizeof(header), 1, file) != 1 || memcmp(header, "E8TR", 4)
+            || header[4] != EMU816_TRACE_VERSION || header[5] != sizeof(emu816_trace_t)) {
+        fprintf(stderr, "not a trace dump of this version and host\n");
+        return (1);
+    }
+
+    while (fread(&r, sizeof(r), 1, file) == 1) {
+        char text[48];
+        char flags[9];
+
+        disassemble(r, text, sizeof(text));
+        for (int n = 0; n < 8; ++n)
+            flags[n] = (r.p & (0x80 >> n)) ? "NVMXDIZC"[n] : '.';
+        flags[8] = '\0';
+        printf("%02X:%04X  %-30s A=%04X X=%04X Y=%04X S=%04X D=%04X B=%02X P=%s%s",
+            r.pc >> 16, r.pc & 0xffff, text, r.a, r.x, r.y, r.sp, r.dp, r.dbr, flags, r.e ? " E" : "  ");
+        if (r.ea != EMU816_INVALID_PC)
+            printf(" EA=%06X", r.ea);
+        else
+            printf("          ");
+        printf(" CYC=%llu\n", (unsigned long long)r.cycles);
+    }
+    return (0);
+}